@@ -0,0 +1,119 @@
+#include "background_eigenvalue.h"
+
+#include <string>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+BackgroundEigenvalue::BackgroundEigenvalue(const PowerIteration::Settings &settings)
+    : _settings(settings)
+{
+    _thread = std::thread([this]() { _work(); });
+    return;
+}
+
+BackgroundEigenvalue::~BackgroundEigenvalue()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _quit = true;
+        if (_iteration) {
+            _iteration->stop();
+        }
+    }
+    _wake.notify_one();
+    _thread.join();
+}
+
+PowerIteration::Settings BackgroundEigenvalue::small_batches()
+{
+    PowerIteration::Settings settings;
+    settings.n_particles    = 2000;
+    settings.min_inactive   = 5;
+    settings.max_inactive   = 50;
+    settings.entropy_window = 5;
+    // Keep refining until the geometry changes
+    settings.n_active = 1000000;
+    return settings;
+}
+
+void BackgroundEigenvalue::follow(const State &state)
+{
+    // What is on screen, including edits the transport hasn't picked up yet
+    auto mesh            = state.displayed_mesh();
+    BoundaryCondition bc = state.boundary_condition();
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (mesh == _mesh && bc == _bc) {
+            return;
+        }
+        _materials = state.materials();
+        _mesh      = std::move(mesh);
+        _bc        = bc;
+        _pending   = true;
+        _estimate  = Estimate();
+        if (_iteration) {
+            _iteration->stop();
+        }
+    }
+    _wake.notify_one();
+}
+
+BackgroundEigenvalue::Estimate BackgroundEigenvalue::estimate() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _estimate;
+}
+
+void BackgroundEigenvalue::_work()
+{
+#ifdef __linux__
+    // Threads have a niceness of their own on Linux
+    setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19);
+#endif
+
+    while (true) {
+        std::shared_ptr<PowerIteration> iteration;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wake.wait(lock, [this]() { return _quit || _pending; });
+            if (_quit) {
+                return;
+            }
+            // A copy of the geometry, so that the counters the transport keeps on
+            // the mesh aren't shared with the foreground
+            std::shared_ptr<const Mesh> mesh = _mesh->clone();
+            iteration  = std::make_shared<PowerIteration>(_materials, std::move(mesh),
+                                                          _bc, _settings);
+            _iteration = iteration;
+            _pending   = false;
+        }
+
+        auto publish = [&](size_t, const PowerIteration::Generation &generation) {
+            if (!generation.active) {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_iteration != iteration) {
+                return;
+            }
+            const RunningStat &k = iteration->k();
+            _estimate.k          = k.mean();
+            _estimate.std_error  = k.count() > 1 ? k.std_error() : 0.0;
+            _estimate.n_active   = k.count();
+        };
+
+        try {
+            // On this thread alone, so as not to compete with the foreground's pool
+            iteration->run(nullptr, publish);
+        } catch (const std::string &) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_iteration == iteration) {
+                _estimate.failed = true;
+            }
+        }
+    }
+}
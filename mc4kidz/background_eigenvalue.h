@@ -0,0 +1,64 @@
+#pragma once
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "eigenvalue.h"
+#include "materials.h"
+#include "mesh.h"
+#include "state.h"
+
+// Keeps an estimate of k-effective of the geometry a State is showing, worked out
+// on a thread of its own.
+//
+// The thread runs power iteration on a private copy of the geometry, in small
+// generations, and publishes k with its standard error after every active one.
+// It runs at the lowest priority the system allows, so that it only takes time
+// the foreground leaves over, and it touches nothing the foreground uses. When
+// the geometry or the boundary condition changes, the run in progress is told to
+// stop at its next tic and the thread starts over on the new one.
+class BackgroundEigenvalue {
+public:
+    struct Estimate {
+        double k         = 0.0;
+        double std_error = 0.0;
+        // Active generations k is averaged over; zero while the source settles
+        size_t n_active = 0;
+        // Set if the geometry can't sustain a fission source at all
+        bool failed = false;
+    };
+
+    BackgroundEigenvalue(const PowerIteration::Settings &settings = small_batches());
+    ~BackgroundEigenvalue();
+
+    BackgroundEigenvalue(const BackgroundEigenvalue &) = delete;
+    BackgroundEigenvalue &operator=(const BackgroundEigenvalue &) = delete;
+
+    // Settings for a quick readout: small generations and a short settling
+    static PowerIteration::Settings small_batches();
+
+    // Start over on the geometry the state is showing, unless that is what the
+    // estimate is already for. Cheap enough to call every frame.
+    void follow(const State &state);
+
+    Estimate estimate() const;
+
+private:
+    void _work();
+
+    PowerIteration::Settings _settings;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _wake;
+    bool _quit = false;
+    // The geometry being estimated, and whether the thread has yet to pick it up
+    std::shared_ptr<const MaterialLibrary> _materials;
+    std::shared_ptr<const Mesh> _mesh;
+    BoundaryCondition _bc = BoundaryCondition::VACUUM;
+    bool _pending         = false;
+    std::shared_ptr<PowerIteration> _iteration;
+    Estimate _estimate;
+
+    std::thread _thread;
+};
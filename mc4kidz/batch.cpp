@@ -0,0 +1,666 @@
+// Headless batch runner. Runs a playbook for a fixed number of tics as fast as
+// possible and reports throughput and the final state of the simulation.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "ensemble.h"
+#ifdef MC4KIDZ_DOMAIN_DECOMPOSITION
+#include "domain_decomposition.h"
+#endif
+#include "eigenvalue.h"
+#include "materials.h"
+#include "optimizer.h"
+#include "playbook.h"
+#include "running_stats.h"
+#include "source.h"
+#include "state.h"
+#include "sweep.h"
+#include "tally.h"
+#include "thread_pool.h"
+#include "weight_windows.h"
+
+static void usage()
+{
+    std::cout << "usage: mc4kidz_batch [options] [playbook]\n"
+                 "  -n, --tics N      number of tics to run (default 1000)\n"
+                 "  -s, --seed S      random number seed (default 0)\n"
+                 "  -t, --threads T   worker threads; 0 for one per core, 1 to\n"
+                 "                    run on the main thread only (default 0)\n"
+                 "  -m, --replicas M  run M independently seeded replicas and\n"
+                 "                    report means and 95% confidence intervals\n"
+                 "  -g, --sweep GRID  run every variant in a parameter grid file,\n"
+                 "                    using the playbook as the base of each\n"
+                 "  -y, --symmetry S  only simulate a sector of the lattice; S is\n"
+                 "                    quarter or eighth\n"
+#ifdef MC4KIDZ_DOMAIN_DECOMPOSITION
+                 "  -d, --domains XxY split the domain into X by Y subdomains,\n"
+                 "                    each run by its own process\n"
+#endif
+                 "  -l, --limit N     comb the population back to N particles\n"
+                 "                    after every tic, keeping its weight\n"
+                 "  -u, --roulette N  hold the population near N particles by\n"
+                 "                    Russian roulette and splitting instead\n"
+                 "  -a, --implicit    survival biasing: particles are never\n"
+                 "                    captured, but lose weight instead\n"
+                 "  -w, --windows N   survival biasing with weight windows set\n"
+                 "                    from the flux over a pre-run of N tics\n"
+                 "  -i, --inject N    add N particles before the first tic, spread\n"
+                 "                    evenly over the lattice\n"
+                 "  -f, --sites FILE  draw the injected particles from a file of\n"
+                 "                    source sites instead\n"
+                 "  -q, --quasi       sample the injected particles from scrambled\n"
+                 "                    Halton points; with -m, each replica gets\n"
+                 "                    its own scrambling\n"
+                 "  -o, --optimize S  search for the loading pattern with the\n"
+                 "                    highest k in S steps, starting from the\n"
+                 "                    lattice the playbook sets up\n"
+                 "  -k, --target K    look for the pattern with k closest to K\n"
+                 "  -e, --eigenvalue A estimate k by power iteration, averaging\n"
+                 "                    over A generations once the fission\n"
+                 "                    source has settled\n"
+                 "  -b, --generation N particles in each generation (default\n"
+                 "                    10000)\n"
+                 "  -r, --pins E      tally pin powers over the active\n"
+                 "                    generations, stopping early once they are\n"
+                 "                    known to a relative error of E (0 to run\n"
+                 "                    them all)\n"
+                 "  -x, --cmfd N      experimental: accelerate the inactive\n"
+                 "                    generations with CMFD on an N by N coarse\n"
+                 "                    mesh\n"
+                 "  -p, --flights     report how far particles fly and how many\n"
+                 "                    surfaces they cross, by material and group\n"
+                 "  -c, --compile OUT write the playbook in compiled form to OUT,\n"
+                 "                    then exit without running it\n"
+                 ;
+}
+
+struct Options {
+    size_t n_tics        = 1000;
+    unsigned int seed    = 0;
+    unsigned int threads = 0;
+    size_t replicas      = 0;
+    std::string sweep;
+    Symmetry symmetry      = Symmetry::NONE;
+    unsigned int domains_x = 0;
+    unsigned int domains_y = 0;
+    size_t optimize        = 0;
+    std::optional<double> target_k;
+    size_t eigenvalue = 0;
+    size_t generation = 10000;
+    std::optional<double> pin_error;
+    size_t cmfd               = 0;
+    PopulationControl control = PopulationControl::NONE;
+    size_t control_target     = 0;
+    bool implicit             = false;
+    size_t windows            = 0;
+    size_t inject             = 0;
+    std::string sites;
+    bool quasi_random = false;
+    bool flights      = false;
+    std::string compile;
+    std::string playbook;
+};
+
+static Options parse_args(int argc, char *argv[])
+{
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value  = i + 1 < argc;
+        if ((arg == "-n" || arg == "--tics") && has_value) {
+            options.n_tics = std::strtoull(argv[++i], nullptr, 10);
+        } else if ((arg == "-s" || arg == "--seed") && has_value) {
+            options.seed = std::strtoul(argv[++i], nullptr, 10);
+        } else if ((arg == "-t" || arg == "--threads") && has_value) {
+            options.threads = std::strtoul(argv[++i], nullptr, 10);
+        } else if ((arg == "-m" || arg == "--replicas") && has_value) {
+            options.replicas = std::strtoull(argv[++i], nullptr, 10);
+        } else if ((arg == "-g" || arg == "--sweep") && has_value) {
+            options.sweep = argv[++i];
+        } else if ((arg == "-y" || arg == "--symmetry") && has_value) {
+            std::string symmetry = argv[++i];
+            if (symmetry == "quarter") {
+                options.symmetry = Symmetry::QUARTER;
+            } else if (symmetry == "eighth") {
+                options.symmetry = Symmetry::EIGHTH;
+            } else if (symmetry != "none") {
+                std::cerr << "Unknown symmetry: " << symmetry << "\n";
+                std::exit(1);
+            }
+        } else if ((arg == "-d" || arg == "--domains") && has_value) {
+            char *end         = nullptr;
+            options.domains_x = std::strtoul(argv[++i], &end, 10);
+            options.domains_y = *end == 'x' ? std::strtoul(end + 1, nullptr, 10) : 0;
+        } else if ((arg == "-o" || arg == "--optimize") && has_value) {
+            options.optimize = std::strtoull(argv[++i], nullptr, 10);
+        } else if ((arg == "-k" || arg == "--target") && has_value) {
+            options.target_k = std::strtod(argv[++i], nullptr);
+        } else if ((arg == "-e" || arg == "--eigenvalue") && has_value) {
+            options.eigenvalue = std::strtoull(argv[++i], nullptr, 10);
+        } else if ((arg == "-b" || arg == "--generation") && has_value) {
+            options.generation = std::strtoull(argv[++i], nullptr, 10);
+        } else if ((arg == "-r" || arg == "--pins") && has_value) {
+            options.pin_error = std::strtod(argv[++i], nullptr);
+        } else if ((arg == "-x" || arg == "--cmfd") && has_value) {
+            options.cmfd = std::strtoull(argv[++i], nullptr, 10);
+        } else if ((arg == "-l" || arg == "--limit") && has_value) {
+            options.control        = PopulationControl::COMB;
+            options.control_target = std::strtoull(argv[++i], nullptr, 10);
+        } else if ((arg == "-u" || arg == "--roulette") && has_value) {
+            options.control        = PopulationControl::ROULETTE;
+            options.control_target = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "-a" || arg == "--implicit") {
+            options.implicit = true;
+        } else if ((arg == "-w" || arg == "--windows") && has_value) {
+            options.windows = std::strtoull(argv[++i], nullptr, 10);
+        } else if ((arg == "-i" || arg == "--inject") && has_value) {
+            options.inject = std::strtoull(argv[++i], nullptr, 10);
+        } else if ((arg == "-f" || arg == "--sites") && has_value) {
+            options.sites = argv[++i];
+        } else if (arg == "-q" || arg == "--quasi") {
+            options.quasi_random = true;
+        } else if (arg == "-p" || arg == "--flights") {
+            options.flights = true;
+        } else if ((arg == "-c" || arg == "--compile") && has_value) {
+            options.compile = argv[++i];
+        } else if (arg == "-h" || arg == "--help") {
+            usage();
+            std::exit(0);
+        } else if (arg[0] == '-') {
+            std::cerr << "Unknown option: " << arg << "\n";
+            usage();
+            std::exit(1);
+        } else {
+            options.playbook = arg;
+        }
+    }
+    return options;
+}
+
+// Counters are sums of weights, but whole numbers are plenty for a report
+static void print_counts(const std::vector<double> &counts)
+{
+    std::cout << "  scatter:    " << std::llround(counts[0]) << "\n";
+    std::cout << "  capture:    " << std::llround(counts[1]) << "\n";
+    std::cout << "  fission:    " << std::llround(counts[2]) << "\n";
+    std::cout << "  leak:       " << std::llround(counts[3]) << "\n";
+}
+
+// Flights through the final geometry, since it was last edited, one line per
+// material and group
+static void print_flights(const State &state)
+{
+    const MaterialLibrary &materials = *state.materials();
+    std::cout << "Flights by material and group, median and 99th percentile:\n";
+    std::cout << "  material      group    flights    length (cm)        "
+                 "crossings\n";
+    for (const auto &[key, entry] : state.mesh_snapshot()->flight_stats().merged()) {
+        const auto &[id, group] = key;
+        std::string name =
+            id == FlightStats::NO_LIBRARY ? "?" : materials.get_by_id(id).name;
+        const FlightStats::Distribution &length    = entry.length;
+        const FlightStats::Distribution &crossings = entry.crossings;
+        std::cout << "  " << std::left << std::setw(14) << name << std::right
+                  << std::setw(5) << group << std::setw(11) << length.stat.count()
+                  << std::fixed << std::setprecision(3) << std::setw(9)
+                  << length.sketch.quantile(0.5) << std::setw(9)
+                  << length.sketch.quantile(0.99) << std::setprecision(0)
+                  << std::setw(8) << crossings.sketch.quantile(0.5) << std::setw(8)
+                  << crossings.sketch.quantile(0.99) << std::defaultfloat
+                  << std::setprecision(6) << "\n";
+    }
+}
+
+static std::unique_ptr<Playbook> make_playbook(const Options &options)
+{
+    if (options.playbook.empty()) {
+        return std::make_unique<Playbook>();
+    }
+    return std::make_unique<Playbook>(options.playbook);
+}
+
+// Set up a state for a single run of the playbook. Particles are injected
+// separately, so that the time it takes can be reported.
+static void set_up(State &state, const Options &options,
+                   std::shared_ptr<ThreadPool> pool)
+{
+    state.set_seed(options.seed);
+    state.set_thread_pool(std::move(pool));
+    state.set_population_control(options.control, options.control_target);
+    state.set_implicit_capture(options.implicit || options.windows > 0);
+    state.set_quasi_random(options.quasi_random);
+    state.set_playbook(make_playbook(options));
+    if (!state.set_symmetry(options.symmetry)) {
+        throw std::string("The lattice does not have the requested symmetry");
+    }
+}
+
+static Source make_source(const Options &options, const Mesh &mesh)
+{
+    if (options.sites.empty()) {
+        return Source::box(
+            Rect{Vec2{0.0f, 0.0f}, Vec2{mesh.get_width(), mesh.get_height()}});
+    }
+    return Source::from_file(options.sites);
+}
+
+// Weight windows from the flux of a survival biased pre-run of the same setup,
+// tallied with one cell per pin
+static std::shared_ptr<const WeightWindows>
+make_weight_windows(const Options &options, std::shared_ptr<ThreadPool> pool)
+{
+    State pre;
+    set_up(pre, options, std::move(pool));
+    auto mesh = pre.mesh_snapshot();
+    auto tally =
+        std::make_shared<MeshTally>(Rect{Vec2{0.0f, 0.0f},
+                                         Vec2{mesh->get_width(), mesh->get_height()}},
+                                    17, 17, Source::N_GROUPS);
+    pre.set_tally(tally);
+    if (options.inject > 0) {
+        pre.add_particles(make_source(options, *mesh), options.inject);
+    }
+    pre.advance(static_cast<unsigned int>(options.windows));
+    tally->end_batch(1.0, *mesh);
+    return std::make_shared<const WeightWindows>(WeightWindows::from_flux(*tally));
+}
+
+static void print_stat(const std::string &label, const RunningStat &stat)
+{
+    std::cout << "  " << label << stat.mean() << " +/- " << stat.ci95() << "\n";
+}
+
+static int run_ensemble(const Options &options)
+{
+    auto materials = std::make_shared<const MaterialLibrary>(C5G7());
+    auto mesh      = State::make_lattice(*materials);
+
+    std::unique_ptr<Ensemble> ensemble;
+    try {
+        ensemble = std::make_unique<Ensemble>(
+            options.replicas, materials, mesh,
+            [&options]() { return make_playbook(options); }, options.seed);
+        for (size_t i = 0; i < ensemble->size(); ++i) {
+            State &replica = ensemble->replica(i);
+            replica.set_quasi_random(options.quasi_random);
+            if (options.inject > 0) {
+                replica.add_particles(make_source(options, *mesh), options.inject);
+            }
+        }
+    } catch (const std::string &msg) {
+        std::cerr << msg << "\n";
+        return 1;
+    }
+
+    ThreadPool pool(options.threads);
+    auto start = std::chrono::steady_clock::now();
+    ensemble->run(options.n_tics, pool);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    double seconds = elapsed.count();
+    std::cout << "Ran " << options.replicas << " replicas of " << options.n_tics
+              << " tics in " << seconds << " s\n";
+    std::cout << "  replica tics/s: " << options.replicas * options.n_tics / seconds
+              << "\n";
+
+    const auto &population = ensemble->population_history();
+    std::cout << "Population (mean +/- 95% CI):\n";
+    size_t stride = std::max<size_t>(1, population.size() / 10);
+    for (size_t t = stride - 1; t < population.size(); t += stride) {
+        print_stat("tic " + std::to_string(t + 1) + ": ", population[t]);
+    }
+
+    const auto &counts = ensemble->interaction_counts();
+    std::cout << "Final counters (mean +/- 95% CI):\n";
+    print_stat("scatter: ", counts[0]);
+    print_stat("capture: ", counts[1]);
+    print_stat("fission: ", counts[2]);
+    print_stat("leak:    ", counts[3]);
+
+    const auto &spectrum = ensemble->spectrum();
+    std::cout << "Final spectrum (mean +/- 95% CI):\n";
+    for (size_t g = 0; g < spectrum.size(); ++g) {
+        print_stat("group " + std::to_string(g) + ": ", spectrum[g]);
+    }
+
+    return 0;
+}
+
+static int run_sweep(const Options &options)
+{
+    std::unique_ptr<Sweep> sweep;
+    try {
+        sweep = std::make_unique<Sweep>(options.sweep, make_playbook(options));
+    } catch (const std::string &msg) {
+        std::cerr << msg << "\n";
+        return 1;
+    }
+
+    std::cout << "Running " << sweep->size() << " variants of " << options.n_tics
+              << " tics\n";
+
+    // One row per variant, in the order they finish
+    std::cout << "variant";
+    for (const auto &axis : sweep->axes()) {
+        std::cout << "\t" << axis.name;
+    }
+    std::cout << "\tpopulation\tscatter\tcapture\tfission\tleak\n";
+
+    ThreadPool pool(options.threads);
+    sweep->run(options.n_tics, options.seed, pool, [](const Sweep::Result &result) {
+        std::cout << result.variant;
+        for (const auto &label : result.labels) {
+            std::cout << "\t" << label;
+        }
+        std::cout << "\t" << result.population;
+        for (auto count : result.interaction_counts) {
+            std::cout << "\t" << std::llround(count);
+        }
+        std::cout << std::endl;
+    });
+
+    return 0;
+}
+
+static int run_optimize(const Options &options)
+{
+    Optimizer::Settings settings;
+    settings.n_steps  = options.optimize;
+    settings.seed     = options.seed;
+    settings.target_k = options.target_k;
+
+    std::unique_ptr<Optimizer> optimizer;
+    try {
+        optimizer = std::make_unique<Optimizer>(make_playbook(options), settings);
+    } catch (const std::string &msg) {
+        std::cerr << msg << "\n";
+        return 1;
+    }
+
+    std::cout << "step\tcurrent k\tbest k\n";
+    std::shared_ptr<ThreadPool> pool;
+    if (options.threads != 1) {
+        pool = std::make_shared<ThreadPool>(options.threads);
+    }
+    auto start = std::chrono::steady_clock::now();
+    try {
+        optimizer->run(pool, [](size_t step, const Optimizer::Candidate &current,
+                                const Optimizer::Candidate &best) {
+            std::cout << step << "\t" << current.k << "\t" << best.k << std::endl;
+        });
+    } catch (const std::string &msg) {
+        std::cerr << msg << "\n";
+        return 1;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    double seconds = elapsed.count();
+    std::cout << "Scored " << optimizer->n_evaluations() << " patterns in " << seconds
+              << " s\n";
+    std::cout << "  patterns/s: " << optimizer->n_evaluations() / seconds << "\n";
+
+    // As playbook commands, ready to paste into a playbook
+    std::cout << "Best patterns:\n";
+    for (const auto &candidate : optimizer->best()) {
+        std::cout << "# k = " << candidate.k << "\n";
+        std::cout << "0 " << Optimizer::to_command(candidate.pattern) << "\n";
+    }
+
+    return 0;
+}
+
+static int run_eigenvalue(const Options &options)
+{
+    PowerIteration::Settings settings;
+    settings.n_active    = options.eigenvalue;
+    settings.n_particles = options.generation;
+    settings.seed        = options.seed;
+    if (options.pin_error) {
+        settings.tally        = true;
+        settings.target_error = options.pin_error.value();
+    }
+    if (options.cmfd > 0) {
+        settings.cmfd    = true;
+        settings.cmfd_nx = options.cmfd;
+        settings.cmfd_ny = options.cmfd;
+    }
+
+    std::shared_ptr<ThreadPool> pool;
+    if (options.threads != 1) {
+        pool = std::make_shared<ThreadPool>(options.threads);
+    }
+
+    std::cout << "generation\tk\tentropy\tactive" << (settings.cmfd ? "\tcmfd k" : "")
+              << "\n";
+    auto start = std::chrono::steady_clock::now();
+    std::unique_ptr<PowerIteration> iteration;
+    try {
+        iteration = std::make_unique<PowerIteration>(make_playbook(options), settings);
+        iteration->run(pool, [](size_t i, const PowerIteration::Generation &gen) {
+            std::cout << i << "\t" << gen.k << "\t" << gen.entropy << "\t"
+                      << (gen.active ? "yes" : "no");
+            if (gen.cmfd_k > 0.0) {
+                std::cout << "\t" << gen.cmfd_k;
+            }
+            std::cout << std::endl;
+        });
+    } catch (const std::string &msg) {
+        std::cerr << msg << "\n";
+        return 1;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    const RunningStat &k = iteration->k();
+    std::cout << "Ran " << iteration->generations().size() << " generations in "
+              << elapsed.count() << " s\n";
+    std::cout << "  inactive: " << iteration->n_inactive() << "\n";
+    std::cout << "  k-eff:    " << k.mean() << " +/- " << k.ci95() << "\n";
+
+    auto tally = iteration->tally();
+    if (tally) {
+        // Relative to the mean over the pins with any fission at all, top row first
+        using Score   = MeshTally::Score;
+        double total  = 0.0;
+        size_t n_fuel = 0;
+        for (size_t iy = 0; iy < tally->ny(); ++iy) {
+            for (size_t ix = 0; ix < tally->nx(); ++ix) {
+                double rate = tally->bin(ix, iy, Score::FISSION).mean();
+                total += rate;
+                n_fuel += rate > 0.0;
+            }
+        }
+        double mean = n_fuel > 0 ? total / n_fuel : 1.0;
+
+        double error = tally->max_relative_error(iteration->target_cells(),
+                                                 Score::FISSION);
+        std::cout << "Pin powers (max relative error in fuel " << error << "):\n";
+        std::cout << std::fixed << std::setprecision(3);
+        for (size_t row = 0; row < tally->ny(); ++row) {
+            size_t iy = tally->ny() - 1 - row;
+            std::cout << " ";
+            for (size_t ix = 0; ix < tally->nx(); ++ix) {
+                std::cout << " " << tally->bin(ix, iy, Score::FISSION).mean() / mean;
+            }
+            std::cout << "\n";
+        }
+    }
+
+    return 0;
+}
+
+static int run_compile(const Options &options)
+{
+    try {
+        auto start    = std::chrono::steady_clock::now();
+        auto playbook = make_playbook(options);
+        auto loaded   = std::chrono::steady_clock::now();
+        playbook->save(options.compile);
+        auto saved = std::chrono::steady_clock::now();
+
+        std::chrono::duration<double, std::milli> load_time = loaded - start;
+        std::chrono::duration<double, std::milli> save_time = saved - loaded;
+        std::cout << "Compiled " << playbook->size() << " commands to "
+                  << options.compile << "\n";
+        std::cout << "  load: " << load_time.count() << " ms\n";
+        std::cout << "  save: " << save_time.count() << " ms\n";
+    } catch (const std::string &msg) {
+        std::cerr << msg << "\n";
+        return 1;
+    }
+
+    return 0;
+}
+
+#ifdef MC4KIDZ_DOMAIN_DECOMPOSITION
+static int run_domains(const Options &options)
+{
+    auto materials = std::make_shared<const MaterialLibrary>(C5G7());
+    auto mesh      = State::make_lattice(*materials);
+
+    try {
+        std::shared_ptr<const Playbook> playbook = make_playbook(options);
+        DomainDecomposition domains(options.domains_x, options.domains_y, materials,
+                                    mesh, playbook);
+
+        auto start = std::chrono::steady_clock::now();
+        domains.run(options.n_tics, options.seed, std::max(1u, options.threads));
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+        double seconds = elapsed.count();
+        std::cout << "Ran " << options.n_tics << " tics over "
+                  << domains.n_subdomains() << " subdomains in " << seconds << " s\n";
+        std::cout << "  tics/s:       " << options.n_tics / seconds << "\n";
+        std::cout << "  migrations:   " << domains.n_migrations() << "\n";
+
+        const auto &population = domains.population_history();
+        std::cout << "Population:\n";
+        size_t stride = std::max<size_t>(1, population.size() / 10);
+        for (size_t t = stride - 1; t < population.size(); t += stride) {
+            std::cout << "  tic " << t + 1 << ": " << population[t] << "\n";
+        }
+
+        std::cout << "Final state:\n";
+        print_counts(domains.interaction_counts());
+    } catch (const std::string &msg) {
+        std::cerr << msg << "\n";
+        return 1;
+    }
+
+    return 0;
+}
+#endif
+
+int main(int argc, char *argv[])
+{
+    Options options = parse_args(argc, argv);
+
+    if (!options.compile.empty()) {
+        return run_compile(options);
+    }
+
+#ifdef MC4KIDZ_DOMAIN_DECOMPOSITION
+    if (options.domains_x > 0 || options.domains_y > 0) {
+        return run_domains(options);
+    }
+#endif
+
+    if (!options.sweep.empty()) {
+        return run_sweep(options);
+    }
+
+    if (options.optimize > 0) {
+        return run_optimize(options);
+    }
+
+    if (options.eigenvalue > 0) {
+        return run_eigenvalue(options);
+    }
+
+    if (options.replicas > 0) {
+        return run_ensemble(options);
+    }
+
+    std::shared_ptr<ThreadPool> pool;
+    if (options.threads != 1) {
+        pool = std::make_shared<ThreadPool>(options.threads);
+    }
+
+    State state;
+    try {
+        set_up(state, options, pool);
+        if (options.windows > 0) {
+            auto start = std::chrono::steady_clock::now();
+            state.set_weight_windows(make_weight_windows(options, pool));
+            std::chrono::duration<double> elapsed =
+                std::chrono::steady_clock::now() - start;
+            std::cout << "Set weight windows from " << options.windows
+                      << " tics in " << elapsed.count() << " s\n";
+        }
+        if (options.inject > 0) {
+            Source source = make_source(options, *state.mesh_snapshot());
+
+            auto start = std::chrono::steady_clock::now();
+            state.add_particles(source, options.inject);
+            std::chrono::duration<double, std::milli> elapsed =
+                std::chrono::steady_clock::now() - start;
+            std::cout << "Injected " << options.inject << " particles in "
+                      << elapsed.count() << " ms\n";
+        }
+    } catch (const std::string &msg) {
+        std::cerr << msg << "\n";
+        return 1;
+    }
+
+    // Number of particles advanced and collisions processed
+    double particle_tics = 0.0;
+    double collisions    = 0.0;
+    auto counts          = state.statistics().interactions;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < options.n_tics; ++i) {
+        particle_tics += state.population();
+        state.advance(1);
+
+        // The playbook may reset the counters along the way
+        auto previous = counts;
+        counts        = state.statistics().interactions;
+        for (size_t j = 0; j < 3; ++j) {
+            collisions += counts[j] >= previous[j] ? counts[j] - previous[j] : counts[j];
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    double seconds = elapsed.count();
+    std::cout << "Ran " << options.n_tics << " tics in " << seconds << " s\n";
+    std::cout << "  tics/s:       " << options.n_tics / seconds << "\n";
+    std::cout << "  particles/s:  " << particle_tics / seconds << "\n";
+    std::cout << "  collisions/s: " << collisions / seconds << "\n";
+    std::cout << "Final state:\n";
+    std::cout << "  time step:  " << state.time_step() << "\n";
+    std::cout << "  population: " << state.population() << "\n";
+    if (state.population_control() != PopulationControl::NONE ||
+        state.implicit_capture()) {
+        std::cout << "  weight:     " << std::llround(state.total_weight()) << "\n";
+    }
+    print_counts(state.get_interaction_counts());
+    const auto &born       = state.generation_born();
+    const auto &population = state.generation_population();
+    for (size_t gen = 0; gen < born.size(); ++gen) {
+        std::cout << "  generation " << state.first_generation() + gen << ": "
+                  << born[gen] << " (" << population[gen] << ")\n";
+    }
+    if (options.flights) {
+        print_flights(state);
+    }
+
+    return 0;
+}
@@ -0,0 +1,267 @@
+#include "cmfd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <string>
+
+#include "source.h"
+
+Cmfd::Cmfd(Rect bounds, size_t nx, size_t ny, size_t window)
+    : _bounds(bounds),
+      _nx(nx),
+      _ny(ny),
+      _cell_w((bounds.hi.x - bounds.lo.x) / nx),
+      _cell_h((bounds.hi.y - bounds.lo.y) / ny),
+      _window(window)
+{
+    if (window == 0) {
+        throw std::string("CMFD needs at least one generation to tally over");
+    }
+    _tally = std::make_shared<MeshTally>(bounds, nx, ny, Source::N_GROUPS);
+    _started.assign(_nx * _ny, 0.0);
+    return;
+}
+
+void Cmfd::start_generation(const std::vector<Particle> &particles)
+{
+    std::fill(_started.begin(), _started.end(), 0.0);
+    for (const auto &p : particles) {
+        _started[_cell_of(p.location)] += p.weight;
+    }
+}
+
+double Cmfd::end_generation(const std::vector<FissionSite> &sites, const Mesh &mesh)
+{
+    if (mesh.multiplicity() > 1) {
+        throw std::string("CMFD needs the whole lattice, not a sector of it");
+    }
+
+    using Score = MeshTally::Score;
+    _tally->end_batch(1.0, mesh);
+
+    size_t n_cells = _nx * _ny;
+    Tallies tallies;
+    tallies.flux.resize(n_cells);
+    tallies.total.resize(n_cells);
+    tallies.absorption.resize(n_cells);
+    tallies.current_x.resize(n_cells);
+    tallies.current_y.resize(n_cells);
+    tallies.source = _started;
+    tallies.production.assign(n_cells, 0.0);
+    for (size_t iy = 0; iy < _ny; ++iy) {
+        for (size_t ix = 0; ix < _nx; ++ix) {
+            size_t i              = iy * _nx + ix;
+            tallies.flux[i]       = _tally->bin(ix, iy, Score::FLUX).mean();
+            tallies.total[i]      = _tally->bin(ix, iy, Score::TOTAL).mean();
+            tallies.absorption[i] = _tally->bin(ix, iy, Score::ABSORPTION).mean();
+            tallies.current_x[i]  = _tally->bin(ix, iy, Score::CURRENT_X).mean();
+            tallies.current_y[i]  = _tally->bin(ix, iy, Score::CURRENT_Y).mean();
+        }
+    }
+    _tally->reset();
+    for (const auto &site : sites) {
+        tallies.production[_cell_of(site.location)] += site.weight;
+    }
+
+    _generations.push_back(std::move(tallies));
+    if (_generations.size() > _window) {
+        _generations.pop_front();
+    }
+
+    Tallies sum = _generations.front();
+    for (size_t g = 1; g < _generations.size(); ++g) {
+        const Tallies &t = _generations[g];
+        for (size_t i = 0; i < n_cells; ++i) {
+            sum.flux[i] += t.flux[i];
+            sum.total[i] += t.total[i];
+            sum.absorption[i] += t.absorption[i];
+            sum.current_x[i] += t.current_x[i];
+            sum.current_y[i] += t.current_y[i];
+            sum.source[i] += t.source[i];
+            sum.production[i] += t.production[i];
+        }
+    }
+    return _solve(sum);
+}
+
+void Cmfd::reweight(std::vector<FissionSite> &sites) const
+{
+    if (_solution.empty()) {
+        return;
+    }
+
+    std::vector<double> banked(_nx * _ny, 0.0);
+    for (const auto &site : sites) {
+        banked[_cell_of(site.location)] += site.weight;
+    }
+    double total_banked   = std::accumulate(banked.begin(), banked.end(), 0.0);
+    double total_solution = 0.0;
+    for (size_t i = 0; i < banked.size(); ++i) {
+        // Cells without any sites have nothing to reweight
+        if (banked[i] > 0.0) {
+            total_solution += _solution[i];
+        }
+    }
+    if (total_solution <= 0.0) {
+        return;
+    }
+
+    for (auto &site : sites) {
+        size_t i      = _cell_of(site.location);
+        double factor = (_solution[i] / total_solution) / (banked[i] / total_banked);
+        site.weight   = static_cast<float>(site.weight * factor);
+    }
+}
+
+size_t Cmfd::_cell_of(Vec2 location) const
+{
+    float x   = std::max(0.0f, (location.x - _bounds.lo.x) / _cell_w);
+    float y   = std::max(0.0f, (location.y - _bounds.lo.y) / _cell_h);
+    size_t ix = std::min(_nx - 1, static_cast<size_t>(x));
+    size_t iy = std::min(_ny - 1, static_cast<size_t>(y));
+    return iy * _nx + ix;
+}
+
+double Cmfd::_solve(const Tallies &sum)
+{
+    size_t n_cells                  = _nx * _ny;
+    const std::vector<double> &flux = sum.flux;
+
+    // The loss operator, as its diagonal and the coefficients of the neighbours
+    // on each side, in terms of the flux integrated over each cell
+    std::vector<double> diagonal(n_cells, 0.0);
+    std::vector<double> left(n_cells, 0.0);
+    std::vector<double> right(n_cells, 0.0);
+    std::vector<double> below(n_cells, 0.0);
+    std::vector<double> above(n_cells, 0.0);
+    std::vector<double> nu_fission(n_cells, 0.0);
+
+    // Diffusion with a correction that brings back the tallied current J from i
+    // to j: J = -d (flux_j - flux_i) + c (flux_i + flux_j)
+    auto couple = [&](size_t i, size_t j, double current, double h,
+                      std::vector<double> &to_j, std::vector<double> &to_i) {
+        if (flux[i] <= 0.0 || flux[j] <= 0.0) {
+            return;
+        }
+        // Harmonic mean of the diffusion coefficients 1 / (3 sigma) of the
+        // cells, over the distance between their centers, per unit of integrated
+        // flux
+        double sigma_i = sum.total[i] / flux[i];
+        double sigma_j = sum.total[j] / flux[j];
+        double d       = 2.0 / (3.0 * h * h * std::max(sigma_i + sigma_j, 1e-6));
+        double c       = (current + d * (flux[j] - flux[i])) / (flux[i] + flux[j]);
+        if (std::abs(c) > d) {
+            // A correction this large would make the loss operator negative in
+            // places, so carry the current from the upwind cell alone instead
+            d = current > 0.0 ? current / flux[i] / 2.0 : -current / flux[j] / 2.0;
+            c = current > 0.0 ? d : -d;
+        }
+        diagonal[i] += d + c;
+        to_j[i] += -d + c;
+        diagonal[j] += d - c;
+        to_i[j] += -d - c;
+    };
+
+    for (size_t iy = 0; iy < _ny; ++iy) {
+        for (size_t ix = 0; ix < _nx; ++ix) {
+            size_t i = iy * _nx + ix;
+            if (ix + 1 < _nx) {
+                couple(i, i + 1, sum.current_x[i], _cell_w, right, left);
+            }
+            if (iy + 1 < _ny) {
+                couple(i, i + _nx, sum.current_y[i], _cell_h, above, below);
+            }
+        }
+    }
+
+    for (size_t iy = 0; iy < _ny; ++iy) {
+        for (size_t ix = 0; ix < _nx; ++ix) {
+            size_t i = iy * _nx + ix;
+            if (flux[i] <= 0.0) {
+                // Never reached, so it takes no part
+                diagonal[i] = 1.0;
+                continue;
+            }
+            double loss = sum.absorption[i];
+            bool edge   = ix == 0 || iy == 0 || ix + 1 == _nx || iy + 1 == _ny;
+            if (edge) {
+                // Whatever started in the cell and wasn't absorbed or carried to a
+                // neighbour left through the edge
+                double net = sum.current_x[i] + sum.current_y[i];
+                if (ix > 0) {
+                    net -= sum.current_x[i - 1];
+                }
+                if (iy > 0) {
+                    net -= sum.current_y[i - _nx];
+                }
+                loss = std::max(loss, sum.source[i] - net);
+            }
+            diagonal[i] += loss / flux[i];
+            nu_fission[i] = sum.production[i] / flux[i];
+        }
+    }
+
+    // Power iteration on the diffusion problem, starting from the tallies, with a
+    // few Gauss-Seidel sweeps to apply the inverse of the loss operator each time
+    double total_source = std::accumulate(sum.source.begin(), sum.source.end(), 0.0);
+    double total_production =
+        std::accumulate(sum.production.begin(), sum.production.end(), 0.0);
+    if (total_source <= 0.0 || total_production <= 0.0) {
+        _solution.clear();
+        return 0.0;
+    }
+    double k = total_production / total_source;
+    std::vector<double> phi = flux;
+    std::vector<double> fission(n_cells);
+    for (int outer = 0; outer < MAX_OUTER; ++outer) {
+        double before = 0.0;
+        for (size_t i = 0; i < n_cells; ++i) {
+            fission[i] = nu_fission[i] * phi[i];
+            before += fission[i];
+        }
+        for (int sweep = 0; sweep < N_SWEEPS; ++sweep) {
+            for (size_t iy = 0; iy < _ny; ++iy) {
+                for (size_t ix = 0; ix < _nx; ++ix) {
+                    size_t i = iy * _nx + ix;
+                    double b = fission[i] / k;
+                    if (ix > 0) {
+                        b -= left[i] * phi[i - 1];
+                    }
+                    if (ix + 1 < _nx) {
+                        b -= right[i] * phi[i + 1];
+                    }
+                    if (iy > 0) {
+                        b -= below[i] * phi[i - _nx];
+                    }
+                    if (iy + 1 < _ny) {
+                        b -= above[i] * phi[i + _nx];
+                    }
+                    phi[i] = b / diagonal[i];
+                }
+            }
+        }
+
+        double after = 0.0;
+        for (size_t i = 0; i < n_cells; ++i) {
+            after += nu_fission[i] * phi[i];
+        }
+        double change = 0.0;
+        for (size_t i = 0; i < n_cells; ++i) {
+            double f = nu_fission[i] * phi[i];
+            change   = std::max(change, std::abs(f / after - fission[i] / before));
+        }
+        double k_next = k * after / before;
+        bool settled  = std::abs(k_next - k) < TOLERANCE && change < TOLERANCE;
+        k             = k_next;
+        if (settled) {
+            break;
+        }
+    }
+
+    _solution.resize(n_cells);
+    for (size_t i = 0; i < n_cells; ++i) {
+        _solution[i] = nu_fission[i] * phi[i];
+    }
+    return k;
+}
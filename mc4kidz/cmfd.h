@@ -0,0 +1,91 @@
+#pragma once
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "fission_bank.h"
+#include "mesh.h"
+#include "particle.h"
+#include "simple_structs.h"
+#include "tally.h"
+
+// Coarse mesh finite difference (CMFD) acceleration of the fission source.
+//
+// Power iteration only moves the fission source a little towards its final shape
+// in each generation, so in a large, loosely coupled lattice it takes many
+// generations to settle. CMFD tallies the flux, reaction rates and the currents
+// between the cells of a coarse mesh during the transport, and uses them to set
+// up a diffusion problem on that mesh, which is small enough to solve for its
+// fundamental mode outright between generations. The currents fix up the
+// diffusion coefficients so that the diffusion problem gives back the transport
+// currents for the tallied flux. The fission sites are then reweighted so that
+// the number of neutrons born in each cell follows the diffusion solution.
+//
+// The diffusion problem is in one group, collapsed with the tallied flux. The
+// leakage out of the edge of the mesh is taken from the balance of the cells
+// along it, which works with any boundary condition. Tallies are summed over a
+// window of the last few generations, to keep the noise down.
+//
+// This is experimental: it has yet to be shown to settle the source in fewer
+// generations than plain power iteration on any of the bundled lattices.
+class Cmfd {
+public:
+    Cmfd(Rect bounds, size_t nx, size_t ny, size_t window);
+
+    // The tally to score the transport into
+    std::shared_ptr<MeshTally> tally() const
+    {
+        return _tally;
+    }
+
+    // Start a generation from the given particles
+    void start_generation(const std::vector<Particle> &particles);
+
+    // End a generation that banked the given fission sites, and solve the
+    // diffusion problem over the window. Returns its k. The mesh must be the
+    // whole lattice, not a sector of it.
+    double end_generation(const std::vector<FissionSite> &sites, const Mesh &mesh);
+
+    // Reweight fission sites, keeping their total weight, so that the weight
+    // born in each cell follows the last solution
+    void reweight(std::vector<FissionSite> &sites) const;
+
+private:
+    // What a generation left in each cell
+    struct Tallies {
+        std::vector<double> flux;
+        std::vector<double> total;
+        std::vector<double> absorption;
+        std::vector<double> current_x;
+        std::vector<double> current_y;
+        // Weight started and banked
+        std::vector<double> source;
+        std::vector<double> production;
+    };
+
+    // Bounds on the power iteration on the diffusion problem: how far the
+    // eigenvalue and the shape of the source may still move when it stops, and
+    // the Gauss-Seidel sweeps for each iteration
+    const double TOLERANCE = 1e-7;
+    const int MAX_OUTER    = 2000;
+    const int N_SWEEPS     = 4;
+
+    size_t _cell_of(Vec2 location) const;
+
+    // Solve for the fundamental mode of the sum over the window, leaving the
+    // fission source of each cell in _solution
+    double _solve(const Tallies &sum);
+
+    Rect _bounds;
+    size_t _nx;
+    size_t _ny;
+    float _cell_w;
+    float _cell_h;
+    size_t _window;
+    std::shared_ptr<MeshTally> _tally;
+
+    std::vector<double> _started;
+    std::deque<Tallies> _generations;
+    // The fission source of the last solution, up to a factor
+    std::vector<double> _solution;
+};
@@ -0,0 +1,256 @@
+#include "domain_decomposition.h"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <new>
+#include <sstream>
+
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "state.h"
+
+// Layout of the memory shared by all of the workers. The arrays live in the same
+// mapping, right after this header; the mapping is made before forking, so the
+// pointers are good in every worker.
+struct DomainDecomposition::Shared {
+    pthread_barrier_t barrier;
+    // What each worker reported for the current tic
+    Report *reports;
+    // Reports added up over the workers, one per tic
+    Report *totals;
+    // Number of particles in each queue, indexed by [from][to]
+    size_t *queue_sizes;
+    // Particles in each queue, indexed by [from][to][i]
+    Migrant *queues;
+};
+
+DomainDecomposition::DomainDecomposition(unsigned int nx, unsigned int ny,
+                                         std::shared_ptr<const MaterialLibrary> materials,
+                                         std::shared_ptr<const Mesh> mesh,
+                                         std::shared_ptr<const Playbook> playbook,
+                                         size_t queue_capacity)
+    : _materials(std::move(materials)),
+      _mesh(std::move(mesh)),
+      _playbook(std::move(playbook)),
+      _queue_capacity(queue_capacity)
+{
+    if (nx == 0 || ny == 0) {
+        throw std::string("Need at least one subdomain in each direction");
+    }
+
+    // The outer edges go on forever, so that particles sitting right on the
+    // boundary of the domain still belong somewhere
+    const float inf = std::numeric_limits<float>::infinity();
+    float dx        = _mesh->get_width() / nx;
+    float dy        = _mesh->get_height() / ny;
+    for (unsigned int iy = 0; iy < ny; ++iy) {
+        for (unsigned int ix = 0; ix < nx; ++ix) {
+            Rect r;
+            r.lo = Vec2{ix == 0 ? -inf : ix * dx, iy == 0 ? -inf : iy * dy};
+            r.hi = Vec2{ix == nx - 1 ? inf : (ix + 1) * dx,
+                        iy == ny - 1 ? inf : (iy + 1) * dy};
+            _subdomains.push_back(r);
+        }
+    }
+    return;
+}
+
+void DomainDecomposition::run(size_t n_tics, unsigned int seed,
+                              unsigned int threads_per_worker)
+{
+    const size_t n_ranks  = _subdomains.size();
+    const size_t n_queues = n_ranks * n_ranks;
+
+    // Lay out the shared memory, keeping everything aligned for the Migrants
+    const size_t align    = alignof(Migrant);
+    auto aligned          = [align](size_t n) { return (n + align - 1) / align * align; };
+    size_t reports_offset = aligned(sizeof(Shared));
+    size_t totals_offset  = aligned(reports_offset + n_ranks * sizeof(Report));
+    size_t sizes_offset   = aligned(totals_offset + n_tics * sizeof(Report));
+    size_t queues_offset  = aligned(sizes_offset + n_queues * sizeof(size_t));
+    size_t mapping_size   = queues_offset + n_queues * _queue_capacity * sizeof(Migrant);
+
+    void *mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        std::stringstream msg;
+        msg << "Failed to map " << mapping_size << " bytes of shared memory";
+        throw msg.str();
+    }
+
+    char *base         = static_cast<char *>(mapping);
+    Shared &shared     = *new (base) Shared;
+    shared.reports     = reinterpret_cast<Report *>(base + reports_offset);
+    shared.totals      = reinterpret_cast<Report *>(base + totals_offset);
+    shared.queue_sizes = reinterpret_cast<size_t *>(base + sizes_offset);
+    shared.queues      = reinterpret_cast<Migrant *>(base + queues_offset);
+
+    pthread_barrierattr_t attr;
+    pthread_barrierattr_init(&attr);
+    pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_barrier_init(&shared.barrier, &attr, static_cast<unsigned int>(n_ranks));
+    pthread_barrierattr_destroy(&attr);
+
+    // Anything still buffered would otherwise get written once per worker
+    std::cout.flush();
+
+    std::vector<pid_t> workers;
+    for (size_t rank = 0; rank < n_ranks; ++rank) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            int status = 0;
+            try {
+                _work(shared, rank, n_tics, seed, threads_per_worker);
+            } catch (const std::string &msg) {
+                std::cerr << "Worker " << rank << ": " << msg << "\n";
+                status = 1;
+            } catch (const std::exception &e) {
+                std::cerr << "Worker " << rank << ": " << e.what() << "\n";
+                status = 1;
+            }
+            std::cout.flush();
+            _exit(status);
+        }
+        if (pid < 0) {
+            break;
+        }
+        workers.push_back(pid);
+    }
+
+    // Wait for everyone. If one of the workers dies, the others would wait for
+    // it forever at the next barrier, so take them down too.
+    bool failed = workers.size() < n_ranks;
+    if (failed) {
+        for (pid_t pid : workers) {
+            kill(pid, SIGKILL);
+        }
+    }
+    for (size_t i = 0; i < workers.size(); ++i) {
+        int status = 0;
+        pid_t pid  = wait(&status);
+        if (pid > 0 && !(WIFEXITED(status) && WEXITSTATUS(status) == 0) && !failed) {
+            failed = true;
+            for (pid_t other : workers) {
+                kill(other, SIGKILL);
+            }
+        }
+    }
+
+    if (!failed) {
+        _population.clear();
+        _population.reserve(n_tics);
+        _n_migrations = 0;
+        for (size_t t = 0; t < n_tics; ++t) {
+            _population.push_back(static_cast<unsigned int>(shared.totals[t].population));
+            _n_migrations += shared.totals[t].migrations;
+        }
+        _interactions.assign(4, 0);
+        if (n_tics > 0) {
+            const Report &last = shared.totals[n_tics - 1];
+            _interactions.assign(last.counts, last.counts + 4);
+        }
+    }
+
+    pthread_barrier_destroy(&shared.barrier);
+    munmap(mapping, mapping_size);
+
+    if (failed) {
+        throw std::string("A domain decomposition worker failed");
+    }
+}
+
+void DomainDecomposition::_work(Shared &shared, size_t rank, size_t n_tics,
+                                unsigned int seed, unsigned int threads) const
+{
+    const size_t n_ranks = _subdomains.size();
+
+    State state(_materials, _mesh);
+    state.set_thread_pool(threads > 1 ? std::make_shared<ThreadPool>(threads) : nullptr);
+    state.set_seed(seed + static_cast<unsigned int>(rank));
+    // Leave plenty of room between the ids handed out by each worker
+    state.set_subdomain(_subdomains[rank], static_cast<uint64_t>(rank) << 48);
+    state.set_playbook(std::make_unique<Playbook>(*_playbook));
+
+    auto owner = [this, n_ranks](Vec2 location) {
+        for (size_t i = 0; i < n_ranks; ++i) {
+            if (_subdomains[i].contains(location)) {
+                return i;
+            }
+        }
+        return n_ranks;
+    };
+
+    std::vector<Particle> emigrants;
+    std::vector<Particle> immigrants;
+    for (size_t t = 0; t < n_tics; ++t) {
+        state.advance(1);
+
+        Report &report    = shared.reports[rank];
+        report.population = state.population();
+        report.migrations = 0;
+        auto counts       = state.statistics().interactions;
+        std::copy(counts.begin(), counts.end(), report.counts);
+
+        // Post the particles that left to the workers that own them now. Those
+        // that don't fit stay here for another tic.
+        emigrants.clear();
+        immigrants.clear();
+        state.take_emigrants(emigrants);
+        size_t *sizes = shared.queue_sizes + rank * n_ranks;
+        std::fill(sizes, sizes + n_ranks, 0);
+        for (auto &p : emigrants) {
+            size_t to = owner(p.location);
+            if (to == n_ranks || sizes[to] == _queue_capacity) {
+                immigrants.push_back(std::move(p));
+                continue;
+            }
+            size_t queue = rank * n_ranks + to;
+            shared.queues[queue * _queue_capacity + sizes[to]] =
+                Migrant{p.location, p.direction, p.distance, p.weight, p.id,
+                        p.e_group, p.generation, p.material ? p.material->id : -1};
+            sizes[to]++;
+            report.migrations++;
+        }
+
+        pthread_barrier_wait(&shared.barrier);
+
+        if (rank == 0) {
+            Report total{};
+            for (size_t i = 0; i < n_ranks; ++i) {
+                const Report &r = shared.reports[i];
+                total.population += r.population;
+                total.migrations += r.migrations;
+                for (int j = 0; j < 4; ++j) {
+                    total.counts[j] += r.counts[j];
+                }
+            }
+            shared.totals[t] = total;
+        }
+
+        // Pick up the particles sent here, in order of where they came from
+        for (size_t from = 0; from < n_ranks; ++from) {
+            size_t queue     = from * n_ranks + rank;
+            const Migrant *q = shared.queues + queue * _queue_capacity;
+            for (size_t i = 0; i < shared.queue_sizes[queue]; ++i) {
+                Particle p(q[i].location, q[i].direction);
+                p.distance   = q[i].distance;
+                p.weight     = q[i].weight;
+                p.id         = q[i].id;
+                p.e_group    = q[i].e_group;
+                p.generation = q[i].generation;
+                p.material =
+                    q[i].material < 0 ? nullptr : &_materials->get_by_id(q[i].material);
+                immigrants.push_back(std::move(p));
+            }
+        }
+        state.add_immigrants(immigrants);
+
+        // Nobody may refill the queues until everyone has emptied them
+        pthread_barrier_wait(&shared.barrier);
+    }
+}
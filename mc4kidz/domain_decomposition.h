@@ -0,0 +1,100 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "materials.h"
+#include "mesh.h"
+#include "playbook.h"
+#include "simple_structs.h"
+
+// Runs one problem split into nx by ny rectangular subdomains, each owned by its
+// own worker process. Every worker has the whole mesh and runs the same
+// playbook, but only tracks the particles inside its subdomain. After each tic,
+// particles that have moved into another subdomain are handed over through
+// queues in memory shared by all of the workers, and the counters and population
+// of the subdomains are added up.
+//
+// A queue holds a fixed number of particles. If one fills up, the rest of the
+// particles stay where they are until the next tic; since every worker has the
+// whole mesh, this only delays the hand-over.
+class DomainDecomposition {
+public:
+    static constexpr size_t DEFAULT_QUEUE_CAPACITY = 1 << 14;
+
+    DomainDecomposition(unsigned int nx, unsigned int ny,
+                        std::shared_ptr<const MaterialLibrary> materials,
+                        std::shared_ptr<const Mesh> mesh,
+                        std::shared_ptr<const Playbook> playbook,
+                        size_t queue_capacity = DEFAULT_QUEUE_CAPACITY);
+
+    size_t n_subdomains() const
+    {
+        return _subdomains.size();
+    }
+
+    const Rect &subdomain(size_t rank) const
+    {
+        return _subdomains[rank];
+    }
+
+    // Fork one worker per subdomain, run them all for n_tics and wait for them to
+    // finish. Each worker runs its tics with threads_per_worker threads. Throws
+    // if any of the workers fails.
+    void run(size_t n_tics, unsigned int seed, unsigned int threads_per_worker = 1);
+
+    // Total population after each tic of the last run
+    const std::vector<unsigned int> &population_history() const
+    {
+        return _population;
+    }
+
+    // Total interaction counts at the end of the last run, in the same order as
+    // State::get_interaction_counts()
+    const std::vector<double> &interaction_counts() const
+    {
+        return _interactions;
+    }
+
+    // Number of particles that moved between subdomains during the last run
+    uint64_t n_migrations() const
+    {
+        return _n_migrations;
+    }
+
+private:
+    // A particle on its way to another subdomain
+    struct Migrant {
+        Vec2 location;
+        Vec2 direction;
+        float distance;
+        float weight;
+        uint64_t id;
+        int e_group;
+        unsigned int generation;
+        int material;
+    };
+
+    // What each worker reports after a tic
+    struct Report {
+        uint64_t population;
+        uint64_t migrations;
+        double counts[4];
+    };
+
+    struct Shared;
+
+    // Body of the worker process for a subdomain
+    void _work(Shared &shared, size_t rank, size_t n_tics, unsigned int seed,
+               unsigned int threads) const;
+
+    std::vector<Rect> _subdomains;
+    std::shared_ptr<const MaterialLibrary> _materials;
+    std::shared_ptr<const Mesh> _mesh;
+    std::shared_ptr<const Playbook> _playbook;
+    size_t _queue_capacity;
+
+    std::vector<unsigned int> _population;
+    std::vector<double> _interactions;
+    uint64_t _n_migrations = 0;
+};
@@ -0,0 +1,263 @@
+#include "eigenvalue.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+
+#include "source.h"
+#include "state.h"
+
+PowerIteration::PowerIteration(std::shared_ptr<const Playbook> setup,
+                               const Settings &settings)
+    : _setup(std::move(setup)), _settings(settings)
+{
+    _check_settings();
+    _materials = std::make_shared<const MaterialLibrary>(C5G7());
+    _mesh      = State::make_lattice(*_materials);
+    return;
+}
+
+PowerIteration::PowerIteration(std::shared_ptr<const MaterialLibrary> materials,
+                               std::shared_ptr<const Mesh> mesh, BoundaryCondition bc,
+                               const Settings &settings)
+    : _bc(bc),
+      _settings(settings),
+      _materials(std::move(materials)),
+      _mesh(std::move(mesh))
+{
+    _check_settings();
+    return;
+}
+
+void PowerIteration::_check_settings() const
+{
+    if (_settings.n_particles == 0 || _settings.entropy_nx == 0 ||
+        _settings.entropy_ny == 0) {
+        throw std::string("Power iteration needs particles and an entropy mesh");
+    }
+    if (_settings.entropy_window == 0 ||
+        _settings.max_inactive < _settings.min_inactive) {
+        throw std::string("Power iteration needs an entropy window, and at least as "
+                          "many inactive generations as it has to run");
+    }
+    for (size_t cell : _settings.target_cells) {
+        if (cell >= _settings.tally_nx * _settings.tally_ny) {
+            throw std::string("Target cell ") + std::to_string(cell) +
+                " is outside of the tally";
+        }
+    }
+}
+
+void PowerIteration::run(std::shared_ptr<ThreadPool> pool,
+                         const GenerationCallback &on_generation)
+{
+    State state(_materials, _mesh);
+    state.set_thread_pool(std::move(pool));
+    state.set_seed(_settings.seed);
+    if (_setup) {
+        _setup->apply_all(&state);
+    } else {
+        state.set_boundary_condition(_bc);
+    }
+    state.hold_fission_sites(true);
+
+    Rect lattice{Vec2{0.0f, 0.0f}, Vec2{_mesh->get_width(), _mesh->get_height()}};
+
+    _generations.clear();
+    _n_inactive = 0;
+    _k          = RunningStat();
+    _tally      = nullptr;
+    _target_cells.clear();
+    if (_settings.tally) {
+        _tally = std::make_shared<MeshTally>(lattice, _settings.tally_nx,
+                                             _settings.tally_ny, Source::N_GROUPS);
+        _target_cells = _settings.target_cells;
+        if (_target_cells.empty()) {
+            _target_cells = _fissile_cells(*state.displayed_mesh());
+        }
+    }
+    std::unique_ptr<Cmfd> cmfd;
+    if (_settings.cmfd) {
+        cmfd = std::make_unique<Cmfd>(lattice, _settings.cmfd_nx, _settings.cmfd_ny,
+                                      _settings.cmfd_window);
+        state.set_tally(cmfd->tally());
+    }
+
+    state.add_particles(Source::box(lattice), _settings.n_particles);
+
+    std::default_random_engine random(_settings.seed);
+    std::uniform_real_distribution<double> unit;
+    bool active = false;
+    while (!_done() && !_stopped) {
+        double w_started  = state.total_weight();
+        unsigned int tics = 0;
+        if (cmfd && !active) {
+            cmfd->start_generation(state.particles());
+        }
+        while (!state.particles().empty()) {
+            if (_stopped) {
+                return;
+            }
+            if (tics++ == _settings.max_tics) {
+                throw std::string("Generation ") + std::to_string(_generations.size()) +
+                    " was still going after " + std::to_string(_settings.max_tics) +
+                    " tics";
+            }
+            state.advance(1);
+        }
+
+        std::vector<FissionSite> sites = state.take_fission_sites();
+        if (sites.empty()) {
+            throw std::string("The fission source died out in generation ") +
+                std::to_string(_generations.size());
+        }
+
+        double w_sites = 0.0;
+        for (const auto &site : sites) {
+            w_sites += site.weight;
+        }
+        w_sites *= _mesh->multiplicity();
+
+        Generation generation{w_sites / w_started, _entropy(sites), active};
+        if (cmfd && !active) {
+            generation.cmfd_k = cmfd->end_generation(sites, *state.mesh_snapshot());
+            if (_generations.size() >= _settings.cmfd_begin) {
+                cmfd->reweight(sites);
+            }
+        }
+        _generations.push_back(generation);
+        if (active) {
+            _k.add(generation.k);
+            if (_tally) {
+                _tally->end_batch(w_started, *_mesh);
+            }
+        } else {
+            _n_inactive++;
+            active = _converged();
+            if (active) {
+                // The first flights of the next generation are sampled as it is
+                // added below
+                state.set_tally(_tally);
+            }
+        }
+
+        if (on_generation) {
+            on_generation(_generations.size() - 1, generation);
+        }
+
+        size_t n = _settings.n_particles / _mesh->multiplicity();
+        state.add_fission_sites(comb(sites, n, unit(random)));
+    }
+}
+
+std::vector<FissionSite> PowerIteration::comb(const std::vector<FissionSite> &sites,
+                                              size_t n, double offset)
+{
+    double total = 0.0;
+    for (const auto &site : sites) {
+        total += site.weight;
+    }
+
+    std::vector<FissionSite> combed;
+    combed.reserve(n);
+    double spacing    = total / n;
+    double next_tooth = offset * spacing;
+    double cumulative = 0.0;
+    for (const auto &site : sites) {
+        cumulative += site.weight;
+        while (next_tooth < cumulative && combed.size() < n) {
+            combed.push_back(site);
+            combed.back().weight = 1.0f;
+            next_tooth += spacing;
+        }
+    }
+    // Rounding can leave the last tooth just past the end
+    while (!sites.empty() && combed.size() < n) {
+        combed.push_back(sites.back());
+        combed.back().weight = 1.0f;
+    }
+    return combed;
+}
+
+double PowerIteration::_entropy(const std::vector<FissionSite> &sites) const
+{
+    size_t nx = _settings.entropy_nx;
+    size_t ny = _settings.entropy_ny;
+    std::vector<size_t> counts(nx * ny, 0);
+    float width  = _mesh->get_width();
+    float height = _mesh->get_height();
+    for (const auto &site : sites) {
+        float x   = std::max(0.0f, site.location.x / width * nx);
+        float y   = std::max(0.0f, site.location.y / height * ny);
+        size_t ix = std::min(nx - 1, size_t(x));
+        size_t iy = std::min(ny - 1, size_t(y));
+        counts[iy * nx + ix]++;
+    }
+
+    double entropy = 0.0;
+    for (auto count : counts) {
+        if (count > 0) {
+            double p = double(count) / sites.size();
+            entropy -= p * std::log2(p);
+        }
+    }
+    return entropy;
+}
+
+bool PowerIteration::_done() const
+{
+    if (_k.count() >= _settings.n_active) {
+        return true;
+    }
+    if (!_tally || _settings.target_error <= 0.0 ||
+        _k.count() < std::max<size_t>(_settings.min_active, 2)) {
+        return false;
+    }
+    using Score  = MeshTally::Score;
+    double error = _tally->max_relative_error(_target_cells, Score::FISSION);
+    return error <= _settings.target_error;
+}
+
+std::vector<size_t> PowerIteration::_fissile_cells(const Mesh &mesh) const
+{
+    std::vector<size_t> cells;
+    Rect bounds  = _tally->bounds();
+    float cell_w = (bounds.hi.x - bounds.lo.x) / _tally->nx();
+    float cell_h = (bounds.hi.y - bounds.lo.y) / _tally->ny();
+    for (size_t iy = 0; iy < _tally->ny(); ++iy) {
+        for (size_t ix = 0; ix < _tally->nx(); ++ix) {
+            Vec2 center{bounds.lo.x + (ix + 0.5f) * cell_w,
+                        bounds.lo.y + (iy + 0.5f) * cell_h};
+            const auto &xsf = mesh.get_material(center)->xsf;
+            if (std::any_of(xsf.begin(), xsf.end(), [](float x) { return x > 0.0f; })) {
+                cells.push_back(iy * _tally->nx() + ix);
+            }
+        }
+    }
+    return cells;
+}
+
+bool PowerIteration::_converged() const
+{
+    size_t n = _generations.size();
+    if (n >= _settings.max_inactive) {
+        return true;
+    }
+    size_t w = _settings.entropy_window;
+    if (n < _settings.min_inactive || n < 2 * w) {
+        return false;
+    }
+
+    RunningStat last;
+    RunningStat before;
+    for (size_t i = n - 2 * w; i < n - w; ++i) {
+        before.add(_generations[i].entropy);
+    }
+    for (size_t i = n - w; i < n; ++i) {
+        last.add(_generations[i].entropy);
+    }
+    // The entropy of a settled source still wanders from one generation to the
+    // next, by about its standard deviation
+    return std::abs(last.mean() - before.mean()) <= last.std_dev();
+}
@@ -0,0 +1,184 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "cmfd.h"
+#include "fission_bank.h"
+#include "materials.h"
+#include "mesh.h"
+#include "playbook.h"
+#include "running_stats.h"
+#include "state.h"
+#include "tally.h"
+#include "thread_pool.h"
+
+// Estimates k-effective of the lattice by power iteration.
+//
+// Rather than following a population through time, the run is split into
+// generations of a fixed number of particles. Each generation is run until all of
+// its particles are gone, with their fission sites held back from the simulation.
+// The ratio of sites banked to particles started is that generation's estimate of
+// k, and the sites are combed back down to the fixed size to start the next one.
+//
+// The first generations are inactive: their fission source still remembers where
+// the run started, so their estimates of k are biased. The source has settled
+// once the Shannon entropy of the sites on a coarse mesh stops drifting, that is
+// once the mean entropy over the last few generations is within the noise of the
+// mean over the few before. Only the active generations after that count towards
+// the estimate of k.
+//
+// The active generations can also be tallied on a mesh, each generation making a
+// batch, for maps of the flux and reaction rates such as pin powers. With a
+// target error, the run stops as soon as the fission rate of every target cell is
+// known that well, rather than after a fixed number of generations.
+//
+// With CMFD on, the fission sites of each inactive generation are reweighted
+// with a diffusion solution on a coarse mesh before they are combed, which
+// brings the source to its settled shape in far fewer generations. The active
+// generations are left alone, so that the estimates aren't biased by it.
+class PowerIteration {
+public:
+    struct Settings {
+        // Particles started in each generation
+        size_t n_particles = 10000;
+        // Generations to average k over, once the source has settled
+        size_t n_active = 100;
+        // Bounds on the number of generations thrown away while settling
+        size_t min_inactive = 10;
+        size_t max_inactive = 200;
+        // Number of generations the entropy is averaged over to tell if it is
+        // still drifting
+        size_t entropy_window = 10;
+        // Cells of the mesh the entropy is taken over
+        size_t entropy_nx = 8;
+        size_t entropy_ny = 8;
+        // A generation that is still going after this many tics is an error,
+        // most likely a lattice that doesn't let neutrons escape or get absorbed
+        unsigned int max_tics = 100000;
+        unsigned int seed     = 0;
+        // Tally the active generations, by default with one cell per pin of the
+        // lattice
+        bool tally      = false;
+        size_t tally_nx = 17;
+        size_t tally_ny = 17;
+        // Relative error of the fission rates to stop at, once there have been at
+        // least min_active generations. Zero runs all n_active generations.
+        double target_error = 0.0;
+        size_t min_active   = 10;
+        // Cells of the tally that have to reach the target error, each given as
+        // iy * tally_nx + ix. Without any, the cells whose centers are in fissile
+        // material once the lattice is set up are used, so that cells that only
+        // clip the edge of a pin, and score next to nothing, don't hold up the run.
+        std::vector<size_t> target_cells;
+        // Accelerate the inactive generations with CMFD, by default with one
+        // coarse cell per pin. The tallies are summed over a window of the last
+        // few generations, and the sites are reweighted from cmfd_begin on. This is
+        // experimental and off by default: on lattices the size of the ones here
+        // the source settles in a few generations without it, so it hasn't been
+        // shown to pay for itself.
+        bool cmfd          = false;
+        size_t cmfd_nx     = 17;
+        size_t cmfd_ny     = 17;
+        size_t cmfd_window = 4;
+        size_t cmfd_begin  = 2;
+    };
+
+    struct Generation {
+        double k;
+        // Shannon entropy of the fission sites, in bits
+        double entropy;
+        bool active;
+        // k of the CMFD solution, or zero without one
+        double cmfd_k = 0.0;
+    };
+
+    // Called after every generation
+    using GenerationCallback = std::function<void(size_t i, const Generation &)>;
+
+    PowerIteration(std::shared_ptr<const Playbook> setup, const Settings &settings);
+
+    // Estimate k of a given geometry, rather than of a lattice a playbook sets up
+    PowerIteration(std::shared_ptr<const MaterialLibrary> materials,
+                   std::shared_ptr<const Mesh> mesh, BoundaryCondition bc,
+                   const Settings &settings);
+
+    PowerIteration(const PowerIteration &) = delete;
+    PowerIteration &operator=(const PowerIteration &) = delete;
+
+    // Comb fission sites down to n of unit weight, picking them in proportion to
+    // their weights, so that the next generation keeps the shape of the source.
+    // The first tooth is a fraction offset of the way along the spacing between
+    // teeth, which should be drawn at random.
+    static std::vector<FissionSite> comb(const std::vector<FissionSite> &sites,
+                                         size_t n, double offset);
+
+    // Run the inactive generations, then the active ones. Without a pool, the
+    // generations are run on this thread only.
+    void run(std::shared_ptr<ThreadPool> pool, const GenerationCallback &on_generation);
+
+    // Have run() return as soon as it finishes the tic it is on. Safe to call from
+    // any thread, and before the run starts.
+    void stop()
+    {
+        _stopped = true;
+    }
+
+    const std::vector<Generation> &generations() const
+    {
+        return _generations;
+    }
+
+    size_t n_inactive() const
+    {
+        return _n_inactive;
+    }
+
+    // k over the active generations
+    const RunningStat &k() const
+    {
+        return _k;
+    }
+
+    // The tally of the active generations, if there is one
+    std::shared_ptr<const MeshTally> tally() const
+    {
+        return _tally;
+    }
+
+    // Cells of the tally the target error applies to in the last run
+    const std::vector<size_t> &target_cells() const
+    {
+        return _target_cells;
+    }
+
+private:
+    void _check_settings() const;
+
+    double _entropy(const std::vector<FissionSite> &sites) const;
+
+    // Cells of the tally whose centers are in fissile material
+    std::vector<size_t> _fissile_cells(const Mesh &mesh) const;
+
+    // Whether the entropy of the generations so far has stopped drifting
+    bool _converged() const;
+
+    // Whether enough active generations have been run
+    bool _done() const;
+
+    // Either a playbook to set up the lattice, or the boundary condition of a
+    // geometry given outright
+    std::shared_ptr<const Playbook> _setup;
+    BoundaryCondition _bc = BoundaryCondition::VACUUM;
+    Settings _settings;
+    std::shared_ptr<const MaterialLibrary> _materials;
+    std::shared_ptr<const Mesh> _mesh;
+
+    std::vector<Generation> _generations;
+    size_t _n_inactive = 0;
+    RunningStat _k;
+    std::shared_ptr<MeshTally> _tally;
+    std::vector<size_t> _target_cells;
+    std::atomic<bool> _stopped{false};
+};
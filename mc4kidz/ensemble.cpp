@@ -0,0 +1,52 @@
+#include "ensemble.h"
+
+Ensemble::Ensemble(size_t n_replicas, std::shared_ptr<const MaterialLibrary> materials,
+                   std::shared_ptr<const Mesh> mesh,
+                   const PlaybookFactory &make_playbook, unsigned int base_seed)
+    : _histories(n_replicas)
+{
+    _replicas.reserve(n_replicas);
+    for (size_t i = 0; i < n_replicas; ++i) {
+        auto state = std::make_unique<State>(materials, mesh);
+        // Replicas already run in parallel with each other
+        state->set_thread_pool(nullptr);
+        state->set_seed(base_seed + static_cast<unsigned int>(i));
+        state->set_playbook(make_playbook());
+        _replicas.push_back(std::move(state));
+    }
+    return;
+}
+
+void Ensemble::run(size_t n_tics, ThreadPool &pool)
+{
+    pool.parallel_for(_replicas.size(), [this, n_tics](size_t i) {
+        State &state  = *_replicas[i];
+        auto &history = _histories[i];
+        history.clear();
+        history.reserve(n_tics);
+        for (size_t t = 0; t < n_tics; ++t) {
+            state.advance(1);
+            history.push_back(state.population());
+        }
+    });
+
+    // Gather in replica order, so the statistics don't depend on which replica
+    // finished first
+    size_t offset = _population.size();
+    _population.resize(offset + n_tics);
+    _interactions.assign(4, RunningStat());
+    _spectrum.assign(7, RunningStat());
+    for (size_t i = 0; i < _replicas.size(); ++i) {
+        for (size_t t = 0; t < n_tics; ++t) {
+            _population[offset + t].add(_histories[i][t]);
+        }
+
+        State::Statistics statistics = _replicas[i]->statistics();
+        for (size_t j = 0; j < statistics.interactions.size(); ++j) {
+            _interactions[j].add(statistics.interactions[j]);
+        }
+        for (size_t g = 0; g < statistics.spectrum.size(); ++g) {
+            _spectrum[g].add(statistics.spectrum[g]);
+        }
+    }
+}
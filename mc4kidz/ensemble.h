@@ -0,0 +1,67 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "materials.h"
+#include "mesh.h"
+#include "playbook.h"
+#include "running_stats.h"
+#include "state.h"
+#include "thread_pool.h"
+
+// A set of independent replicas of the same problem, differing only in their
+// random number seeds. The replicas share the materials and the geometry they
+// start from, and run side by side on a thread pool; each one runs its tics on
+// a single thread. Their results are gathered into means and variances.
+class Ensemble {
+public:
+    using PlaybookFactory = std::function<std::unique_ptr<Playbook>()>;
+
+    // Set up n_replicas replicas, seeded with base_seed, base_seed + 1, ...
+    // Each replica gets its own playbook from make_playbook.
+    Ensemble(size_t n_replicas, std::shared_ptr<const MaterialLibrary> materials,
+             std::shared_ptr<const Mesh> mesh, const PlaybookFactory &make_playbook,
+             unsigned int base_seed = 0);
+
+    // Run every replica for n_tics, adding to the statistics
+    void run(size_t n_tics, ThreadPool &pool);
+
+    size_t size() const
+    {
+        return _replicas.size();
+    }
+
+    State &replica(size_t i)
+    {
+        return *_replicas[i];
+    }
+
+    // Population after each tic, over the replicas
+    const std::vector<RunningStat> &population_history() const
+    {
+        return _population;
+    }
+
+    // Interaction counts at the end of the last run, in the same order as
+    // State::get_interaction_counts()
+    const std::vector<RunningStat> &interaction_counts() const
+    {
+        return _interactions;
+    }
+
+    // Energy spectrum at the end of the last run
+    const std::vector<RunningStat> &spectrum() const
+    {
+        return _spectrum;
+    }
+
+private:
+    std::vector<std::unique_ptr<State>> _replicas;
+    // Population of each replica after each tic of a run
+    std::vector<std::vector<unsigned int>> _histories;
+
+    std::vector<RunningStat> _population;
+    std::vector<RunningStat> _interactions;
+    std::vector<RunningStat> _spectrum;
+};
@@ -0,0 +1,63 @@
+#include "fission_bank.h"
+
+#include <algorithm>
+
+void FissionBank::SubBank::reserve(size_t n_sites)
+{
+    if (n_sites <= _sites.capacity()) {
+        return;
+    }
+
+    // Round up to a whole number of growth steps, and at least double so that
+    // very large banks don't grow linearly
+    size_t target = std::max(n_sites, 2 * _sites.capacity());
+    target        = ((target + _growth - 1) / _growth) * _growth;
+    _sites.reserve(target);
+}
+
+FissionBank::FissionBank(size_t growth) : _growth(std::max<size_t>(growth, 1))
+{
+    return;
+}
+
+void FissionBank::resize(size_t n)
+{
+    while (_sub_banks.size() < n) {
+        _sub_banks.emplace_back(_growth);
+    }
+}
+
+size_t FissionBank::size() const
+{
+    size_t n = 0;
+    for (const auto &sub_bank : _sub_banks) {
+        n += sub_bank.size();
+    }
+    return n;
+}
+
+const std::vector<FissionSite> &FissionBank::collect()
+{
+    _sites.clear();
+    _sites.reserve(size());
+    for (auto &sub_bank : _sub_banks) {
+        _sites.insert(_sites.end(), sub_bank._sites.begin(), sub_bank._sites.end());
+        sub_bank._sites.clear();
+    }
+
+    std::sort(_sites.begin(), _sites.end(),
+              [](const FissionSite &a, const FissionSite &b) {
+                  return a.parent < b.parent ||
+                         (a.parent == b.parent && a.index < b.index);
+              });
+
+    return _sites;
+}
+
+void FissionBank::clear()
+{
+    for (auto &sub_bank : _sub_banks) {
+        sub_bank._sites.clear();
+    }
+    _sites.clear();
+}
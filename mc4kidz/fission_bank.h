@@ -0,0 +1,93 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "materials.h"
+#include "simple_structs.h"
+
+// Where a fission neutron is to be born. Sites are identified by the particle
+// that caused the fission and which of its daughters they are, so they can be
+// put in an order that doesn't depend on the order in which they were banked.
+struct FissionSite {
+    Vec2 location;
+    const Material *material;
+    uint64_t parent;
+    unsigned int generation;
+    unsigned int index;
+    // Weight of the particle that will start from the site
+    float weight = 1.0f;
+};
+
+// Storage for the fission sites produced during a tic.
+//
+// Sites are banked into sub-banks, each of which is only ever used by one
+// worker at a time, so banking needs no synchronization. Sub-banks keep their
+// storage from one tic to the next and grow in large steps, so a growing
+// population doesn't spend its time reallocating.
+class FissionBank {
+public:
+    class SubBank {
+    public:
+        SubBank(size_t growth) : _growth(growth)
+        {
+            return;
+        }
+
+        void bank(const FissionSite &site)
+        {
+            if (_sites.size() == _sites.capacity()) {
+                reserve(_sites.size() + 1);
+            }
+            _sites.push_back(site);
+        }
+
+        // Make room for at least n_sites more sites
+        void reserve_more(float n_sites)
+        {
+            reserve(_sites.size() + static_cast<size_t>(n_sites) + 1);
+        }
+
+        size_t size() const
+        {
+            return _sites.size();
+        }
+
+        size_t capacity() const
+        {
+            return _sites.capacity();
+        }
+
+    private:
+        friend class FissionBank;
+
+        void reserve(size_t n_sites);
+
+        size_t _growth;
+        std::vector<FissionSite> _sites;
+    };
+
+    // Sub-banks grow in steps of at least growth sites
+    FissionBank(size_t growth = 4096);
+
+    // Make sure that there are at least n sub-banks
+    void resize(size_t n);
+
+    SubBank &sub_bank(size_t i)
+    {
+        return _sub_banks[i];
+    }
+
+    size_t size() const;
+
+    // Gather the sites from all sub-banks, ordered by parent and daughter index,
+    // and empty the sub-banks. The result is valid until the next call.
+    const std::vector<FissionSite> &collect();
+
+    void clear();
+
+private:
+    size_t _growth;
+    std::vector<SubBank> _sub_banks;
+    std::vector<FissionSite> _sites;
+};
@@ -0,0 +1,61 @@
+#include "flight_stats.h"
+
+#include <algorithm>
+
+FlightStats::FlightStats()
+{
+    return;
+}
+
+FlightStats::FlightStats(const FlightStats &) : FlightStats()
+{
+    return;
+}
+
+std::map<std::pair<int, int>, FlightStats::Entry> FlightStats::merged() const
+{
+    std::map<std::pair<int, int>, Entry> merged;
+    _accumulators.for_each([&merged](const Accumulator &accumulator) {
+        const auto &entries = accumulator.entries;
+        for (size_t i_mat = 0; i_mat < entries.size(); ++i_mat) {
+            for (size_t g = 0; g < entries[i_mat].size(); ++g) {
+                const Entry &entry = entries[i_mat][g];
+                if (entry.length.stat.count() == 0) {
+                    continue;
+                }
+                int id = static_cast<int>(i_mat) - 1;
+                merged[{id, static_cast<int>(g)}].merge(entry);
+            }
+        }
+    });
+    return merged;
+}
+
+RunningStat FlightStats::lengths() const
+{
+    RunningStat lengths;
+    _accumulators.for_each([&lengths](const Accumulator &accumulator) {
+        for (const auto &by_group : accumulator.entries) {
+            for (const auto &entry : by_group) {
+                lengths.merge(entry.length.stat);
+            }
+        }
+    });
+    return lengths;
+}
+
+void FlightStats::Accumulator::record(const Material &material, int e_group,
+                                      float length, int crossings)
+{
+    size_t i_mat = static_cast<size_t>(std::max(material.id, NO_LIBRARY) + 1);
+    if (entries.size() <= i_mat) {
+        entries.resize(i_mat + 1);
+    }
+    auto &by_group = entries[i_mat];
+    if (by_group.size() <= static_cast<size_t>(e_group)) {
+        by_group.resize(e_group + 1);
+    }
+    Entry &entry = by_group[e_group];
+    entry.length.add(length);
+    entry.crossings.add(static_cast<float>(crossings));
+}
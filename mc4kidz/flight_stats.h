@@ -0,0 +1,84 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "materials.h"
+#include "per_thread.h"
+#include "quantile_sketch.h"
+#include "running_stats.h"
+
+// Statistics of the flights particles take through a mesh, by the material each
+// flight ends in and the energy group of the particle: how far they go, and how
+// many surfaces they cross on the way.
+//
+// Each thread records into an accumulator of its own, so that transport shares
+// nothing mutable. Accumulators are merged on demand, which must not happen while
+// transport is under way. Every statistic takes a fixed amount of memory, however
+// many flights it has seen.
+class FlightStats {
+public:
+    // Mean and variance of a quantity, along with its distribution
+    struct Distribution {
+        RunningStat stat;
+        QuantileSketch sketch;
+
+        void add(float x)
+        {
+            stat.add(x);
+            sketch.add(x);
+        }
+
+        void merge(const Distribution &other)
+        {
+            stat.merge(other.stat);
+            sketch.merge(other.sketch);
+        }
+    };
+
+    struct Entry {
+        Distribution length;
+        Distribution crossings;
+
+        void merge(const Entry &other)
+        {
+            length.merge(other.length);
+            crossings.merge(other.crossings);
+        }
+    };
+
+    // Materials that don't belong to a library are all counted under this id
+    static constexpr int NO_LIBRARY = -1;
+
+    FlightStats();
+    // Copies start out empty, since what was recorded belongs to the original
+    FlightStats(const FlightStats &other);
+    FlightStats &operator=(const FlightStats &) = delete;
+
+    void record(const Material &material, int e_group, float length, int crossings)
+    {
+        _accumulators.local([]() { return Accumulator(); })
+            .record(material, e_group, length, crossings);
+    }
+
+    // Everything recorded so far, by material id and group
+    std::map<std::pair<int, int>, Entry> merged() const;
+
+    // Lengths of all the flights, without their distribution, which is quicker
+    // to put together
+    RunningStat lengths() const;
+
+private:
+    struct Accumulator {
+        // By material id, shifted up by one, and group
+        std::vector<std::vector<Entry>> entries;
+
+        void record(const Material &material, int e_group, float length,
+                    int crossings);
+    };
+
+    // Recording into a const mesh is fine, since nothing else reads what is
+    // recorded until transport is over
+    mutable PerThread<Accumulator> _accumulators;
+};
@@ -0,0 +1,33 @@
+#include "frame_budget.h"
+
+#include <cmath>
+
+FrameBudget::FrameBudget(double budget_ms) : _budget_ms(std::max(budget_ms, 0.0))
+{
+    return;
+}
+
+int FrameBudget::tics_this_frame() const
+{
+    double fit  = _budget_ms / std::max(_tic_cost_ms, 1.0e-6);
+    int n_tics  = static_cast<int>(std::floor(fit));
+    int max_now = static_cast<int>(std::ceil(_last_tics * MAX_GROWTH));
+    return std::clamp(n_tics, 1, std::min(max_now, MAX_TICS));
+}
+
+void FrameBudget::record(int n_tics, double elapsed_ms)
+{
+    if (n_tics < 1) {
+        return;
+    }
+    _last_tics = n_tics;
+
+    double cost = elapsed_ms / n_tics;
+    if (cost > _tic_cost_ms) {
+        // Getting more expensive; believe it immediately so the frame rate holds
+        _tic_cost_ms = cost;
+    } else {
+        _tic_cost_ms += SMOOTHING * (cost - _tic_cost_ms);
+    }
+    return;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <algorithm>
+
+// Decide how many tics to run per display frame so that the simulation fits into
+// a fixed wall-clock budget. The cost of a tic is measured as we go; it grows
+// with the particle population, so the estimate backs off right away when tics
+// get more expensive and only creeps back up when they get cheaper.
+class FrameBudget {
+public:
+    FrameBudget(double budget_ms);
+
+    // Number of tics to run in the next frame
+    int tics_this_frame() const;
+
+    // Record that the last frame ran n_tics in elapsed_ms of wall time
+    void record(int n_tics, double elapsed_ms);
+
+    void set_budget(double budget_ms)
+    {
+        _budget_ms = std::max(budget_ms, 0.0);
+    }
+
+    double budget() const
+    {
+        return _budget_ms;
+    }
+
+    // Current estimate of the cost of a single tic, in milliseconds
+    double tic_cost() const
+    {
+        return _tic_cost_ms;
+    }
+
+private:
+    // Limit on how much faster than the previous frame we are allowed to go. This
+    // keeps a single cheap frame from sending us way over budget on the next.
+    const double MAX_GROWTH = 2.0;
+    const int MAX_TICS      = 10'000;
+    // Weight of a new measurement when the tic cost is dropping
+    const double SMOOTHING = 0.1;
+
+    double _budget_ms;
+    double _tic_cost_ms = 1.0;
+    int _last_tics      = 1;
+};
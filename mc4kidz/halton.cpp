@@ -0,0 +1,53 @@
+#include "halton.h"
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <string>
+
+static const uint32_t PRIMES[HaltonSequence::MAX_DIMENSIONS] = {2,  3,  5,  7,
+                                                                11, 13, 17, 19};
+
+HaltonSequence::HaltonSequence(int n_dimensions, unsigned int seed)
+{
+    if (n_dimensions <= 0 || n_dimensions > MAX_DIMENSIONS) {
+        throw std::string("Halton points have between 1 and ") +
+            std::to_string(MAX_DIMENSIONS) + " dimensions";
+    }
+
+    std::seed_seq seed_seq{seed, 5u};
+    std::default_random_engine random(seed_seq);
+    _dimensions.resize(n_dimensions);
+    for (int d = 0; d < n_dimensions; ++d) {
+        Dimension &dim = _dimensions[d];
+        dim.base       = PRIMES[d];
+        dim.n_digits   = 0;
+        for (uint64_t reach = 1; reach <= UINT32_MAX; reach *= dim.base) {
+            dim.n_digits++;
+        }
+
+        dim.permutations.resize(dim.n_digits * dim.base);
+        for (int k = 0; k < dim.n_digits; ++k) {
+            auto begin = dim.permutations.begin() + k * dim.base;
+            std::iota(begin, begin + dim.base, uint8_t(0));
+            std::shuffle(begin, begin + dim.base, random);
+        }
+    }
+    return;
+}
+
+float HaltonSequence::sample(uint32_t i, int dimension) const
+{
+    const Dimension &dim  = _dimensions[dimension];
+    const uint8_t *digits = dim.permutations.data();
+    double scale          = 1.0 / dim.base;
+    double place          = scale;
+    double x              = 0.0;
+    // Leading zeros are permuted too, which is what makes each point uniform
+    for (int k = 0; k < dim.n_digits; ++k) {
+        x += digits[k * dim.base + i % dim.base] * place;
+        i /= dim.base;
+        place *= scale;
+    }
+    return std::min(static_cast<float>(x), 0x1.fffffep-1f);
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Scrambled Halton points, for quasi-Monte Carlo sampling.
+//
+// In each dimension, the coordinate of point i of the Halton sequence is i written
+// in a prime base of its own, mirrored around the radix point. Consecutive points
+// fill the unit cube far more evenly than random ones do, so averages over them
+// can converge faster than the 1 / sqrt(N) of plain Monte Carlo.
+//
+// Every digit is put through a random permutation, one for each base and digit
+// position, drawn from a seed. The points stay as evenly spread, but each one is
+// uniform on its own, so runs with different seeds are independent replicates
+// with unbiased results, and error bars can be taken over them as usual.
+class HaltonSequence {
+public:
+    static constexpr int MAX_DIMENSIONS = 8;
+
+    HaltonSequence(int n_dimensions, unsigned int seed);
+
+    int n_dimensions() const
+    {
+        return static_cast<int>(_dimensions.size());
+    }
+
+    // Coordinate of point i in a dimension, on [0, 1)
+    float sample(uint32_t i, int dimension) const;
+
+private:
+    struct Dimension {
+        uint32_t base;
+        // Enough digits to tell any two 32-bit indices apart
+        int n_digits;
+        // The permutation of the digits in each position, one after another
+        std::vector<uint8_t> permutations;
+    };
+
+    std::vector<Dimension> _dimensions;
+};
@@ -12,7 +12,11 @@
 
 void Histogram::draw() const
 {
-    const auto data = _get_data();
+    _get_data(_data);
+    const auto &data = _data;
+    if (data.empty()) {
+        return;
+    }
     size_t n_data   = data.size();
     float bar_width = 1.0f / static_cast<float>(n_data);
     float max_val   = static_cast<float>(*std::max_element(data.begin(), data.end()));
@@ -10,7 +10,11 @@ public:
     void draw() const;
 
 private:
-    virtual std::vector<unsigned int> _get_data() const = 0;
+    // Fill in the height of each bar
+    virtual void _get_data(std::vector<double> &data) const = 0;
+
+    // Kept from frame to frame, so that drawing doesn't allocate
+    mutable std::vector<double> _data;
 };
 
 class SpectrumHistogram : public Histogram {
@@ -23,14 +27,12 @@ public:
 private:
     const State *_state = nullptr;
 
-    std::vector<unsigned int> _get_data() const override final
+    void _get_data(std::vector<double> &data) const override final
     {
+        data.clear();
         if (_state) {
-            auto spectrum = _state->get_spectrum();
-            std::reverse(spectrum.begin(), spectrum.end());
-            return spectrum;
+            const auto spectrum = _state->statistics().spectrum;
+            data.assign(spectrum.rbegin(), spectrum.rend());
         }
-
-        return {};
     }
 };
\ No newline at end of file
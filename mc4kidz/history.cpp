@@ -0,0 +1,66 @@
+#include "history.h"
+
+#include <algorithm>
+
+History::History() : _buckets(N_LEVELS * BUCKETS_PER_LEVEL)
+{
+    return;
+}
+
+void History::add(double x)
+{
+    float value = static_cast<float>(x);
+    _push(0, Bucket{value, value, value, 1});
+    _n++;
+}
+
+void History::clear()
+{
+    _head.fill(0);
+    _size.fill(0);
+    _n = 0;
+}
+
+void History::buckets(std::vector<Bucket> &out) const
+{
+    out.clear();
+    for (size_t level = N_LEVELS; level-- > 0;) {
+        for (size_t i = 0; i < _size[level]; ++i) {
+            out.push_back(_at(level, i));
+        }
+    }
+}
+
+void History::_push(size_t level, const Bucket &bucket)
+{
+    if (_size[level] == BUCKETS_PER_LEVEL) {
+        if (level + 1 < N_LEVELS) {
+            Bucket oldest = _at(level, 0);
+            for (size_t i = 1; i < MERGE; ++i) {
+                oldest = _merge(oldest, _at(level, i));
+            }
+            _head[level] = (_head[level] + MERGE) % BUCKETS_PER_LEVEL;
+            _size[level] -= MERGE;
+            _push(level + 1, oldest);
+        } else {
+            // Halve the resolution of the top level. Each bucket is written no
+            // later than where it is read from, so this can be done in place.
+            size_t half = _size[level] / 2;
+            for (size_t i = 0; i < half; ++i) {
+                _at(level, i) = _merge(_at(level, 2 * i), _at(level, 2 * i + 1));
+            }
+            _size[level] = half;
+        }
+    }
+
+    _size[level]++;
+    _at(level, _size[level] - 1) = bucket;
+}
+
+History::Bucket History::_merge(const Bucket &a, const Bucket &b)
+{
+    uint32_t n  = a.n + b.n;
+    double mean = (double(a.mean) * a.n + double(b.mean) * b.n) / n;
+    return Bucket{std::min(a.min, b.min), std::max(a.max, b.max),
+                  static_cast<float>(mean), n};
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A quantity sampled once per tic, over the whole of a run, in a fixed amount of
+// memory.
+//
+// Samples are kept in levels of buckets, each bucket holding the smallest,
+// largest and mean sample of a stretch of the run. The newest samples are on the
+// lowest level, a bucket each. When a level is full, its oldest MERGE buckets are
+// merged into one and moved up to the next, so that each level covers a stretch
+// MERGE times as long as the one below it, before it. When the top level is full,
+// its buckets are merged in pairs, so that it keeps going back to the first
+// sample. Spikes survive as the minimum or maximum of the buckets they end up in.
+//
+// Adding a sample takes constant time, amortized over the run.
+class History {
+public:
+    struct Bucket {
+        float min;
+        float max;
+        float mean;
+        // Number of samples in the bucket
+        uint32_t n;
+    };
+
+    static constexpr size_t BUCKETS_PER_LEVEL = 256;
+    static constexpr size_t N_LEVELS          = 6;
+    static constexpr size_t MERGE             = 4;
+
+    History();
+
+    void add(double x);
+
+    void clear();
+
+    // Samples added since the history was last cleared
+    uint64_t count() const
+    {
+        return _n;
+    }
+
+    // All of the buckets, oldest first, into a buffer that can be kept from call
+    // to call so as not to allocate
+    void buckets(std::vector<Bucket> &out) const;
+
+private:
+    // The i-th oldest bucket of a level
+    Bucket &_at(size_t level, size_t i)
+    {
+        size_t slot = (_head[level] + i) % BUCKETS_PER_LEVEL;
+        return _buckets[level * BUCKETS_PER_LEVEL + slot];
+    }
+
+    const Bucket &_at(size_t level, size_t i) const
+    {
+        size_t slot = (_head[level] + i) % BUCKETS_PER_LEVEL;
+        return _buckets[level * BUCKETS_PER_LEVEL + slot];
+    }
+
+    // Add a bucket to the newest end of a level, making room for it first
+    void _push(size_t level, const Bucket &bucket);
+
+    static Bucket _merge(const Bucket &a, const Bucket &b);
+
+    // A ring of buckets for each level, one after another
+    std::vector<Bucket> _buckets;
+    std::array<size_t, N_LEVELS> _head = {};
+    std::array<size_t, N_LEVELS> _size = {};
+    uint64_t _n                        = 0;
+};
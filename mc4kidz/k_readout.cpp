@@ -0,0 +1,41 @@
+#include "k_readout.h"
+
+#include <cstdio>
+#include <string>
+
+#ifdef WIN32
+#define NOMINMAX
+#include <windows.h>
+#endif
+#include "GL/freeglut.h"
+#include "GL/gl.h"
+
+void KReadout::draw() const
+{
+    auto estimate = _estimator->estimate();
+
+    char k_line[64];
+    std::string detail;
+    if (estimate.failed) {
+        std::snprintf(k_line, sizeof(k_line), "k = 0");
+        detail = "no fission chain";
+    } else if (estimate.n_active == 0) {
+        std::snprintf(k_line, sizeof(k_line), "k = ...");
+        detail = "settling";
+    } else {
+        std::snprintf(k_line, sizeof(k_line), "k = %.4f +/- %.4f", estimate.k,
+                      estimate.std_error);
+        detail = std::to_string(estimate.n_active) + " generations";
+    }
+
+    glPushMatrix();
+    glLoadIdentity();
+    gluOrtho2D(-1.0f, 1.0f, -1.0f, 1.0f);
+    glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+    glRasterPos2f(-0.95f, 0.6f);
+    glutBitmapString(GLUT_BITMAP_HELVETICA_18, (const unsigned char *)k_line);
+    glRasterPos2f(-0.95f, 0.3f);
+    glutBitmapString(GLUT_BITMAP_HELVETICA_12, (const unsigned char *)detail.c_str());
+    glPopMatrix();
+    return;
+}
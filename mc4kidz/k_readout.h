@@ -0,0 +1,18 @@
+#pragma once
+
+#include "background_eigenvalue.h"
+#include "drawable.h"
+
+// The latest background estimate of k-effective, as text
+class KReadout : public Drawable {
+public:
+    KReadout(const BackgroundEigenvalue *estimator) : _estimator(estimator)
+    {
+        return;
+    }
+
+    void draw() const;
+
+private:
+    const BackgroundEigenvalue *_estimator;
+};
@@ -1,6 +1,7 @@
 #include "line_plot.h"
 
-#include <numeric>
+#include <algorithm>
+#include <cstdint>
 #include <vector>
 
 #ifdef WIN32
@@ -10,18 +11,24 @@
 #include "GL/freeglut.h"
 #include "GL/gl.h"
 
+// Tics the plot spans until the run is longer than that, so that it fills up
+// from the left at first
+static const uint64_t MIN_DOMAIN = 1000;
+
 void LinePlot::draw() const
 {
-    const auto &data = get_data();
-    if (data.size() < 1) {
+    const History &history = get_data();
+    history.buckets(_buckets);
+    if (_buckets.empty()) {
         return;
     }
-    size_t domain   = data.capacity();
-    size_t n_points = data.size();
 
-    float dx     = 2.0f / domain;
-    auto max_pop = *std::max_element(data.begin(), data.end());
-    float scale  = 2.0f / max_pop;
+    float dx      = 2.0f / std::max(history.count(), MIN_DOMAIN);
+    float max_pop = 0.0f;
+    for (const auto &bucket : _buckets) {
+        max_pop = std::max(max_pop, bucket.max);
+    }
+    float scale = max_pop > 0.0f ? 2.0f / max_pop : 0.0f;
 
     glPushMatrix();
     glLoadIdentity();
@@ -35,12 +42,25 @@ void LinePlot::draw() const
     glVertex2f(-1.0f, 1.0f);
     glEnd();
 
+    // The range of each bucket, over the stretch of the run it covers
+    glBegin(GL_QUAD_STRIP);
+    glColor4f(1.0f, 1.0f, 1.0f, 0.3f);
+    uint64_t t = 0;
+    for (const auto &bucket : _buckets) {
+        for (uint64_t edge : {t, t + bucket.n}) {
+            glVertex2f(dx * edge - 1.0f, scale * bucket.min - 1.0f);
+            glVertex2f(dx * edge - 1.0f, scale * bucket.max - 1.0f);
+        }
+        t += bucket.n;
+    }
+    glEnd();
+
     glBegin(GL_LINE_STRIP);
-    int i = 0;
     glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
-    for (size_t i = 0; i < data.size(); ++i) {
-		glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
-        glVertex2f(dx * i - 1.0f, scale * data[i] - 1.0f);
+    t = 0;
+    for (const auto &bucket : _buckets) {
+        glVertex2f(dx * (t + 0.5f * bucket.n) - 1.0f, scale * bucket.mean - 1.0f);
+        t += bucket.n;
     }
     glEnd();
 
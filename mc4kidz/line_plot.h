@@ -2,14 +2,20 @@
 #include <vector>
 
 #include "drawable.h"
+#include "history.h"
 #include "state.h"
 
+// Plots a history over the whole run so far, as its mean, in a band from the
+// smallest to the largest value of each stretch of it
 class LinePlot : public Drawable {
 public:
     void draw() const;
 
 private:
-    virtual const std::vector<unsigned int> &get_data() const = 0;
+    virtual const History &get_data() const = 0;
+
+    // Kept from frame to frame, so that drawing doesn't allocate
+    mutable std::vector<History::Bucket> _buckets;
 };
 
 class PopulationLinePlot : public LinePlot {
@@ -22,7 +28,7 @@ public:
 private:
     const State *_state;
 
-    const std::vector<unsigned int> &get_data() const override final
+    const History &get_data() const override final
     {
         return _state->get_population_history();
     }
@@ -1,3 +1,4 @@
+#include <chrono>
 #include <iostream>
 #include <memory>
 
@@ -9,11 +10,15 @@
 #include "GL/freeglut.h"
 #include "GL/glut.h"
 
+#include "background_eigenvalue.h"
+#include "frame_budget.h"
 #include "histogram.h"
 #include "info_pane.h"
+#include "k_readout.h"
 #include "line_plot.h"
 #include "pie_chart.h"
 #include "playbook.h"
+#include "render.h"
 #include "shapes.h"
 #include "simple_structs.h"
 #include "state.h"
@@ -23,15 +28,30 @@ static const float WORLD_WIDTH   = 17.0f;
 static const float WORLD_HEIGHT  = 17.0f;
 static const float WORLD_MARGIN  = 0.1f;
 static const int INFO_PANE_WIDTH = 150;
+static const int FRAME_INTERVAL  = 20;
+// Share of each frame interval that turbo mode may spend simulating. The rest is
+// left for drawing and handling input.
+static const double TURBO_BUDGET = 0.75 * FRAME_INTERVAL;
+// Number of tics to jump with the seek keys
+static const unsigned int SEEK_STEP = 1000;
+// Number of particles population control holds the simulation at
+static const size_t POPULATION_TARGET = 20000;
 
 std::unique_ptr<State> state;
 std::unique_ptr<InfoPane> info_pane;
+// Works out k of whatever is on screen, on a thread of its own
+std::unique_ptr<BackgroundEigenvalue> k_estimator;
 
 int frame = 0;
 int time_now  = 0;
 int time_base = 0;
 float fps     = 0.0;
 
+// Run as many tics per frame as fit in the frame budget
+bool turbo = false;
+FrameBudget frame_budget(TURBO_BUDGET);
+int tics_per_frame = 1;
+
 bool fullscreen = false;
 // window size before going fullscreen
 int old_width = 512;
@@ -51,7 +71,7 @@ void display()
 
     glViewport(0, 0, window_width, window_height);
 
-    state->draw();
+    draw_state(*state);
     info_pane->draw();
 
 	frame++;
@@ -65,6 +85,9 @@ void display()
     glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
 	glRasterPos2f(0.0f, 0.0f);
     auto fps_str = std::to_string(fps);
+    if (turbo) {
+        fps_str += " (turbo: " + std::to_string(tics_per_frame) + " tics/frame)";
+    }
     glutBitmapString(GLUT_BITMAP_HELVETICA_18, (const unsigned char *)fps_str.c_str());
 
     glFlush();
@@ -72,9 +95,25 @@ void display()
 
 void timer(int paused)
 {
-    state->tic();
+    if (turbo && !state->paused()) {
+        tics_per_frame = frame_budget.tics_this_frame();
+        auto start     = std::chrono::steady_clock::now();
+        // Only the last tic gets drawn, so only it prepares anything for display
+        if (tics_per_frame > 1) {
+            state->advance(static_cast<unsigned int>(tics_per_frame - 1));
+        }
+        state->tic();
+        std::chrono::duration<double, std::milli> elapsed =
+            std::chrono::steady_clock::now() - start;
+        frame_budget.record(tics_per_frame, elapsed.count());
+    } else {
+        tics_per_frame = 1;
+        state->tic();
+    }
+    // Edits take effect in the tic, so this sees them in the same frame
+    k_estimator->follow(*state);
     glutPostRedisplay();
-    glutTimerFunc(20, timer, paused);
+    glutTimerFunc(FRAME_INTERVAL, timer, paused);
 }
 
 void reshape(int width, int height)
@@ -119,6 +158,44 @@ void key(unsigned char key, int x, int y)
     case 'c':
         state->cycle_all();
         break;
+    case 't':
+        turbo = !turbo;
+        break;
+    case 'g':
+        state->toggle_generation_tracking();
+        glutPostRedisplay();
+        break;
+    case ']':
+        state->seek(state->elapsed() + SEEK_STEP);
+        glutPostRedisplay();
+        break;
+    case '[':
+        state->seek(state->elapsed() > SEEK_STEP ? state->elapsed() - SEEK_STEP : 0);
+        glutPostRedisplay();
+        break;
+    case 'o': {
+        // Off, then combing, then roulette and splitting
+        PopulationControl next = PopulationControl::NONE;
+        if (state->population_control() == PopulationControl::NONE) {
+            next = PopulationControl::COMB;
+        } else if (state->population_control() == PopulationControl::COMB) {
+            next = PopulationControl::ROULETTE;
+        }
+        state->set_population_control(next, POPULATION_TARGET);
+        break;
+    }
+    case 'y': {
+        Symmetry next = Symmetry::NONE;
+        if (state->symmetry() == Symmetry::NONE) {
+            next = Symmetry::QUARTER;
+        } else if (state->symmetry() == Symmetry::QUARTER) {
+            next = Symmetry::EIGHTH;
+        }
+        if (!state->set_symmetry(next)) {
+            std::cout << "The lattice is not symmetric enough\n";
+        }
+        break;
+    }
     case 'f':
         if (fullscreen) {
             glutReshapeWindow(old_width, old_height);
@@ -201,10 +278,13 @@ int main(int argc, char *argv[])
     std::cout << "Here we go!\n";
 
     state     = std::make_unique<State>();
+    state->set_keyframes(true);
     info_pane = std::make_unique<InfoPane>(200, 10);
     info_pane->add_info(std::make_unique<InteractionPieChart>(state.get()));
     info_pane->add_info(std::make_unique<SpectrumHistogram>(state.get()));
     info_pane->add_info(std::make_unique<PopulationLinePlot>(state.get()));
+    k_estimator = std::make_unique<BackgroundEigenvalue>();
+    info_pane->add_info(std::make_unique<KReadout>(k_estimator.get()));
 
     if (argc > 1) {
         std::string playbook_file = argv[1];
@@ -222,7 +302,7 @@ int main(int argc, char *argv[])
     glutKeyboardFunc(key);
     glutMouseFunc(mouse);
     glutMotionFunc(mouse_drag);
-    glutTimerFunc(20, timer, 0);
+    glutTimerFunc(FRAME_INTERVAL, timer, 0);
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     glPointSize(1.5f);
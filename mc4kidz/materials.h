@@ -36,6 +36,17 @@ public:
         return Interaction::CAPTURE;
     }
 
+    float capture_probability() const
+    {
+        return 1.0f - _cdf[1];
+    }
+
+    // Sample an interaction other than capture, given a random float on [0, 1)
+    Interaction sample_surviving(float r) const
+    {
+        return sample(r * _cdf[1]);
+    }
+
 private:
     std::array<float, 3> _cdf;
 };
@@ -80,6 +91,8 @@ struct Material {
     std::vector<float> xsch;
     Array2D<float> xssc;
     std::string name;
+    // Position in the library, set when the material is added to one
+    int id = -1;
 };
 
 class MaterialLibrary {
@@ -91,6 +104,7 @@ public:
 
     void add_material(Material mat)
     {
+        mat.id                 = static_cast<int>(_materials_by_id.size());
         _ids_by_name[mat.name] = _materials_by_id.size();
         _materials_by_id.push_back(mat);
     }
@@ -1,51 +1,57 @@
 #include "mesh.h"
 
-#ifdef WIN32
-#define NOMINMAX
-#include <windows.h>
-#endif
-#include "GL/freeglut.h"
-#include "GL/gl.h"
+#include <cmath>
+
+#include "tally.h"
 
 Mesh::Mesh(float width, float height, const Material *inter_mat, Color background_color)
     : _width(width),
       _height(height),
       _inter_mat(inter_mat),
-      _background(background_color)
+      _background(background_color),
+      _center{0.5f * width, 0.5f * height}
 {
     return;
 }
 
-void Mesh::draw() const
+Mesh::Mesh(const Mesh &other)
+    : _width(other._width),
+      _height(other._height),
+      _shapes(other._shapes),
+      _colors(other._colors),
+      _materials(other._materials),
+      _inter_mat(other._inter_mat),
+      _background(other._background),
+      _version(other._version),
+      _lattice(other._lattice),
+      _symmetry(other._symmetry),
+      _multiplicity(other._multiplicity),
+      _center(other._center),
+      _fold_x(other._fold_x),
+      _fold_y(other._fold_y),
+      _fold_diagonal(other._fold_diagonal)
 {
-    glBegin(GL_QUADS);
-
-	glColor4f(_background.r, _background.g, _background.b, _background.a);
-    glVertex2f(0.0f, 0.0f);
-    glVertex2f(_width, 0.0f);
-    glVertex2f(_width, _height);
-    glVertex2f(0.0f, _height);
-    glEnd();
-
-	glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
-    for (const auto &s : _shapes) {
-        s->draw();
-    }
+    return;
 }
 
-void Mesh::transport_particle(Particle &particle,
-                              std::default_random_engine &random) const
+template <bool WAYPOINTS>
+void Mesh::transport_particle(Particle &particle, std::default_random_engine &random,
+                              MeshTally *tally,
+                              std::optional<float> first_flight) const
 {
     auto i_reg             = find_region(particle.location);
     const Material *mat    = particle.material;
     float distance         = 0.0;
     Vec2 location          = particle.location;
     size_t coincident_surf = _shapes.size();
+    int n_crossings        = 0;
 
     while (location.x >= 0.0f && location.y >= 0.0f && location.x <= _width &&
            location.y <= _height) {
         // Distance to collision in current material
-        float d_to_c = particle.sample_distance(random);
+        float d_to_c = first_flight ? particle.sample_distance(*first_flight)
+                                    : particle.sample_distance(random);
+        first_flight.reset();
         // Distance to next surface; start with something stupid big
         float d_to_s = std::numeric_limits<float>::max();
 
@@ -59,6 +65,11 @@ void Mesh::transport_particle(Particle &particle,
             }
         }
 
+        if (tally) {
+            tally->score(location, particle.direction, std::min(d_to_c, d_to_s), *mat,
+                         particle.e_group, particle.weight);
+        }
+
         if (d_to_c < d_to_s) {
             // Particle didn't make it to the surface. No need to update material
             distance += d_to_c;
@@ -72,8 +83,11 @@ void Mesh::transport_particle(Particle &particle,
             // is. Should circle back to this if i have time...
             auto delta = particle.direction * (d_to_s * 1.0001f);
             location   = location + delta;
-            particle.waypoints.push_back(location);
+            if constexpr (WAYPOINTS) {
+                particle.waypoints.push_back(location);
+            }
             distance += d_to_s;
+            n_crossings++;
 
             // We know we are crossing a surface, so we are either entering the
             // coincident shape or exiting.
@@ -91,13 +105,23 @@ void Mesh::transport_particle(Particle &particle,
         }
     }
 
-    _total_distance += distance;
-    _n_collisions++;
+    _flight_stats.record(*mat, particle.e_group, distance, n_crossings);
 
     particle.distance = distance;
-    particle.waypoints.push_back(particle.location + particle.direction * distance);
+    if constexpr (WAYPOINTS) {
+        particle.waypoints.push_back(particle.location + particle.direction * distance);
+    }
 }
 
+template void Mesh::transport_particle<true>(Particle &particle,
+                                             std::default_random_engine &random,
+                                             MeshTally *tally,
+                                             std::optional<float> first_flight) const;
+template void Mesh::transport_particle<false>(Particle &particle,
+                                              std::default_random_engine &random,
+                                              MeshTally *tally,
+                                              std::optional<float> first_flight) const;
+
 std::optional<size_t> Mesh::find_region(Vec2 location) const
 {
     for (size_t i = 0; i < _shapes.size(); ++i) {
@@ -107,3 +131,92 @@ std::optional<size_t> Mesh::find_region(Vec2 location) const
     }
     return std::nullopt;
 }
+
+std::vector<size_t> Mesh::regions_in_rect(Rect rect) const
+{
+    std::vector<size_t> regions;
+    for (size_t i = 0; i < _shapes.size(); ++i) {
+        Vec2 c = _shapes[i]->centroid();
+        if (c.x >= rect.lo.x && c.x <= rect.hi.x && c.y >= rect.lo.y &&
+            c.y <= rect.hi.y) {
+            regions.push_back(i);
+        }
+    }
+    return regions;
+}
+
+std::vector<size_t> Mesh::regions_in_ring(Vec2 center, float r_inner,
+                                          float r_outer) const
+{
+    std::vector<size_t> regions;
+    for (size_t i = 0; i < _shapes.size(); ++i) {
+        float r = (_shapes[i]->centroid() - center).norm();
+        if (r >= r_inner && r <= r_outer) {
+            regions.push_back(i);
+        }
+    }
+    return regions;
+}
+
+void Mesh::set_symmetry(Symmetry symmetry)
+{
+    _symmetry      = symmetry;
+    _multiplicity  = _multiplicity_of(symmetry);
+    _fold_x        = symmetry != Symmetry::NONE;
+    _fold_y        = symmetry != Symmetry::NONE;
+    _fold_diagonal = symmetry == Symmetry::EIGHTH;
+    return;
+}
+
+bool Mesh::is_symmetric(Symmetry symmetry) const
+{
+    if (symmetry == Symmetry::EIGHTH && _width != _height) {
+        return false;
+    }
+
+    unsigned int n_images = _multiplicity_of(symmetry);
+    for (size_t i_reg = 0; i_reg < _shapes.size(); ++i_reg) {
+        // Every image of the middle of a region has to land in a region with the
+        // same material
+        Vec2 middle = _shapes[i_reg]->centroid();
+
+        for (unsigned int i = 1; i < n_images; ++i) {
+            auto image = find_region(image_location(middle, i));
+            if (!image || _materials[image.value()] != _materials[i_reg]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void Mesh::fold(Vec2 &location, Vec2 &direction) const
+{
+    auto [flip_x, flip_y, swap] = _fold_planes(location);
+    location  = _center + _reflect(location - _center, flip_x, flip_y, swap);
+    direction = _reflect(direction, flip_x, flip_y, swap);
+    return;
+}
+
+void Mesh::fold(Particle &particle) const
+{
+    auto [flip_x, flip_y, swap] = _fold_planes(particle.location);
+    Vec2 r             = particle.location - _center;
+    particle.location  = _center + _reflect(r, flip_x, flip_y, swap);
+    particle.direction = _reflect(particle.direction, flip_x, flip_y, swap);
+    // Keep the path ahead of the particle attached to it
+    for (auto &waypoint : particle.waypoints) {
+        waypoint = _center + _reflect(waypoint - _center, flip_x, flip_y, swap);
+    }
+    return;
+}
+
+std::tuple<bool, bool, bool> Mesh::_fold_planes(Vec2 location) const
+{
+    Vec2 r      = location - _center;
+    bool flip_x = _fold_x && r.x < 0.0f;
+    bool flip_y = _fold_y && r.y < 0.0f;
+    // The diagonal is checked once the point is in the top-right quadrant
+    bool swap = _fold_diagonal && std::abs(r.y) > std::abs(r.x);
+    return {flip_x, flip_y, swap};
+}
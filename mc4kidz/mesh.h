@@ -1,23 +1,73 @@
 #pragma once
 #include <algorithm>
+#include <cmath>
 #include <limits>
 #include <memory>
 #include <optional>
 #include <random>
 #include <tuple>
+#include <utility>
 #include <vector>
 
+#include "flight_stats.h"
 #include "materials.h"
 #include "particle.h"
 #include "shapes.h"
 #include "simple_structs.h"
 
+class MeshTally;
+
+// Symmetries that a mesh may be declared to have. With one set, only the
+// fundamental sector of the mesh is simulated, and the rest is its mirror image.
+//   - QUARTER: mirror planes through the centre, parallel to each axis. The
+//     sector is the top-right quadrant.
+//   - EIGHTH: the QUARTER planes plus the diagonal through the centre. The
+//     sector is the lower half of the top-right quadrant.
+enum class Symmetry : uint8_t { NONE, QUARTER, EIGHTH };
+
+// A collection of shapes, each filled with a material, embedded in a background
+// material.
+//
+// Meshes are treated as immutable snapshots once they are handed to the
+// transport. To edit one, clone() it, modify the clone and swap it in at a tic
+// boundary. The geometry itself is shared between all versions; only the
+// per-region colors and materials are copied.
 class Mesh {
 public:
+    // A regular grid of pins, nx wide and ny high, with its lower left corner at
+    // the origin
+    struct Lattice {
+        Vec2 origin;
+        int nx;
+        int ny;
+        float pitch;
+
+        // The (x, y) index of the pin a location is in, if it is on the lattice
+        std::optional<std::pair<int, int>> pin_at(Vec2 location) const
+        {
+            int ix = static_cast<int>(std::floor((location.x - origin.x) / pitch));
+            int iy = static_cast<int>(std::floor((location.y - origin.y) / pitch));
+            if (ix < 0 || ix >= nx || iy < 0 || iy >= ny) {
+                return std::nullopt;
+            }
+            return std::make_pair(ix, iy);
+        }
+    };
+
     Mesh(float width, float height, const Material *inter_mat, Color background_color);
+    Mesh(const Mesh &other);
+
+    // Make a new, editable version of this mesh
+    std::shared_ptr<Mesh> clone() const
+    {
+        auto mesh = std::make_shared<Mesh>(*this);
+        mesh->_version++;
+        return mesh;
+    }
 
     void add_shape(std::unique_ptr<Shape> shape, const Material *material)
     {
+        _colors.push_back(shape->color);
         _shapes.emplace_back(std::move(shape));
         _materials.push_back(material);
     }
@@ -29,16 +79,15 @@ public:
         if (!i_reg) {
             return std::make_tuple(_background, _inter_mat);
         }
-        return std::make_tuple(_shapes[i_reg.value()]->color,
-                               _materials[i_reg.value()]);
+        return std::make_tuple(_colors[i_reg.value()], _materials[i_reg.value()]);
     }
 
     void set_color_material_at(Vec2 location, Color c, const Material *mat)
     {
         auto i_reg = find_region(location);
         if (i_reg) {
-            _shapes[i_reg.value()]->color = c;
-            _materials[i_reg.value()]     = mat;
+            _colors[i_reg.value()]    = c;
+            _materials[i_reg.value()] = mat;
         } else {
             _inter_mat  = mat;
             _background = c;
@@ -48,22 +97,93 @@ public:
 
     void set_color_material_all_shapes(Color c, const Material *mat)
     {
-        for (auto &shape : _shapes) {
-            shape->color = c;
+        for (auto &color : _colors) {
+            color = c;
         }
         for (auto &material : _materials) {
             material = mat;
         }
     }
 
-    void draw() const;
+    // Bulk edits. Regions are picked out by their centroids, which is much cheaper
+    // than finding the region under each of a set of points.
+    void set_color_material(size_t i_reg, Color c, const Material *mat)
+    {
+        _colors[i_reg]    = c;
+        _materials[i_reg] = mat;
+    }
+
+    void set_color_material(const std::vector<size_t> &regions, Color c,
+                            const Material *mat)
+    {
+        for (size_t i_reg : regions) {
+            set_color_material(i_reg, c, mat);
+        }
+    }
+
+    // Say that the regions are pins on a lattice, so that they can be edited by
+    // their index in it. The lattice is part of the geometry, shared by every
+    // version of the mesh.
+    void set_lattice(Lattice lattice)
+    {
+        _lattice = lattice;
+    }
+
+    const std::optional<Lattice> &lattice() const
+    {
+        return _lattice;
+    }
+
+    // Regions with their centroid inside a rectangle, edges included
+    std::vector<size_t> regions_in_rect(Rect rect) const;
+
+    // Regions with their centroid between two distances from a point
+    std::vector<size_t> regions_in_ring(Vec2 center, float r_inner, float r_outer) const;
+
+    Vec2 region_centroid(size_t i) const
+    {
+        return _shapes[i]->centroid();
+    }
+
+    const Material *region_material(size_t i) const
+    {
+        return _materials[i];
+    }
+
+    // Access to the regions of the mesh, for drawing
+    size_t n_regions() const
+    {
+        return _shapes.size();
+    }
+
+    const Shape &get_shape(size_t i) const
+    {
+        return *_shapes[i];
+    }
+
+    Color get_color(size_t i) const
+    {
+        return _colors[i];
+    }
+
+    Color get_background() const
+    {
+        return _background;
+    }
 
     // Simulate the passage of a particle through the mesh to its next interaction.
     // This will:
     //   - Set the particle's distance to travel to it's next interaction site
     //   - Set the particle's material pointer to the material at that site
-    void transport_particle(Particle &particle,
-                            std::default_random_engine &random) const;
+    //   - Append the surface crossings and the interaction site to the particle's
+    //     waypoints, if WAYPOINTS is set
+    //   - Score the flight into a tally, if there is one
+    // The first distance to collision can be sampled from a given uniform number
+    // rather than from the engine, for quasi-random sampling.
+    template <bool WAYPOINTS = true>
+    void transport_particle(Particle &particle, std::default_random_engine &random,
+                            MeshTally *tally = nullptr,
+                            std::optional<float> first_flight = std::nullopt) const;
 
     const Material *get_material(Vec2 location) const
     {
@@ -77,7 +197,13 @@ public:
 
     float mean_distance_to_collision() const
     {
-        return _total_distance / _n_collisions;
+        return static_cast<float>(_flight_stats.lengths().mean());
+    }
+
+    // Flights taken through this mesh. Copies of the mesh start out without any.
+    const FlightStats &flight_stats() const
+    {
+        return _flight_stats;
     }
 
     std::optional<size_t> find_region(Vec2 location) const;
@@ -92,13 +218,127 @@ public:
         return _height;
     }
 
+    // Reflective symmetry planes. The caller is responsible for only setting a
+    // symmetry that the mesh actually has; see is_symmetric().
+    void set_symmetry(Symmetry symmetry);
+
+    Symmetry symmetry() const
+    {
+        return _symmetry;
+    }
+
+    // Whether every region looks the same as its mirror images under a symmetry
+    bool is_symmetric(Symmetry symmetry) const;
+
+    // How many copies of the fundamental sector make up the whole mesh
+    unsigned int multiplicity() const
+    {
+        return _multiplicity;
+    }
+
+    // Whether a location is in the fundamental sector. Written without branches so
+    // that it can be used in loops over particles.
+    bool in_sector(Vec2 location) const
+    {
+        float rx = location.x - _center.x;
+        float ry = location.y - _center.y;
+        return !((_fold_x & (rx < 0.0f)) | (_fold_y & (ry < 0.0f)) |
+                 (_fold_diagonal & (ry > rx)));
+    }
+
+    // Reflect a location and direction that have crossed a symmetry plane back
+    // into the fundamental sector. Particles never move far enough in a tic to
+    // cross the same plane twice.
+    void fold(Vec2 &location, Vec2 &direction) const;
+
+    // Fold a particle back into the fundamental sector, along with its waypoints
+    void fold(Particle &particle) const;
+
+    // The i-th of the multiplicity() mirror images of a location or a direction.
+    // Image 0 is the original. Points that lie on a symmetry plane are their own
+    // images, so they show up more than once.
+    Vec2 image_location(Vec2 location, unsigned int i) const
+    {
+        return _center + _mirror(location - _center, i);
+    }
+
+    Vec2 image_direction(Vec2 direction, unsigned int i) const
+    {
+        return _mirror(direction, i);
+    }
+
+    // Number of edits that led to this version of the mesh
+    unsigned int version() const
+    {
+        return _version;
+    }
+
 private:
+    // Apply the i-th mirror transformation, relative to the centre. Bit 2 swaps
+    // the axes, bit 0 flips x and bit 1 flips y.
+    static Vec2 _mirror(Vec2 r, unsigned int i)
+    {
+        if (i & 4) {
+            std::swap(r.x, r.y);
+        }
+        if (i & 1) {
+            r.x = -r.x;
+        }
+        if (i & 2) {
+            r.y = -r.y;
+        }
+        return r;
+    }
+
+    // Reflect a point, relative to the centre, or a direction. Flips come before
+    // the swap, which is the reverse of _mirror().
+    static Vec2 _reflect(Vec2 r, bool flip_x, bool flip_y, bool swap)
+    {
+        if (flip_x) {
+            r.x = -r.x;
+        }
+        if (flip_y) {
+            r.y = -r.y;
+        }
+        if (swap) {
+            std::swap(r.x, r.y);
+        }
+        return r;
+    }
+
+    // Which planes a location has to be reflected through to get it back into the
+    // fundamental sector
+    std::tuple<bool, bool, bool> _fold_planes(Vec2 location) const;
+
+    static unsigned int _multiplicity_of(Symmetry symmetry)
+    {
+        switch (symmetry) {
+        case Symmetry::QUARTER:
+            return 4;
+        case Symmetry::EIGHTH:
+            return 8;
+        default:
+            return 1;
+        }
+    }
+
     float _width;
     float _height;
-    std::vector<std::unique_ptr<Shape>> _shapes;
+    std::vector<std::shared_ptr<const Shape>> _shapes;
+    std::vector<Color> _colors;
     std::vector<const Material *> _materials;
     const Material *_inter_mat;
     Color _background;
-    mutable int _n_collisions     = 0;
-    mutable float _total_distance = 0.0f;
+    unsigned int _version = 0;
+    std::optional<Lattice> _lattice;
+
+    // Symmetry planes, all through the centre of the mesh
+    Symmetry _symmetry         = Symmetry::NONE;
+    unsigned int _multiplicity = 1;
+    Vec2 _center;
+    bool _fold_x        = false;
+    bool _fold_y        = false;
+    bool _fold_diagonal = false;
+    // Transport statistics, recorded from all of the threads doing transport
+    mutable FlightStats _flight_stats;
 };
@@ -0,0 +1,218 @@
+#include "optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "source.h"
+#include "state.h"
+
+#undef VOID
+
+Optimizer::Optimizer(std::shared_ptr<const Playbook> setup, const Settings &settings)
+    : _setup(std::move(setup)), _settings(settings)
+{
+    if (_settings.n_settle >= _settings.n_tics) {
+        throw std::string("The scoring runs need more tics than they spend settling");
+    }
+    if (_settings.batch_size == 0 || _settings.n_best == 0 ||
+        _settings.n_particles == 0) {
+        throw std::string("The optimizer needs proposals, particles and somewhere to "
+                          "keep the best patterns");
+    }
+
+    _materials = std::make_shared<const MaterialLibrary>(C5G7());
+    _mesh      = State::make_lattice(*_materials);
+
+    State state(_materials, _mesh);
+    state.set_thread_pool(nullptr);
+    _setup->apply_all(&state);
+    _start = state.pin_pattern();
+    return;
+}
+
+void Optimizer::run(std::shared_ptr<ThreadPool> pool, const StepCallback &on_step)
+{
+    // Where the pins are, so that swaps can be picked from them
+    std::vector<std::pair<size_t, size_t>> pins;
+    for (size_t row = 0; row < _start.size(); ++row) {
+        for (size_t col = 0; col < _start[row].size(); ++col) {
+            if (_start[row][col]) {
+                pins.emplace_back(row, col);
+            }
+        }
+    }
+
+    std::default_random_engine random(_settings.seed);
+    size_t last_pin = std::max<size_t>(pins.size(), 1) - 1;
+    std::uniform_int_distribution<size_t> pick_pin(0, last_pin);
+    auto propose = [&](const Pattern &pattern) {
+        // Give up on patterns made of one type of pin, which have no swaps
+        for (int attempt = 0; attempt < 1000; ++attempt) {
+            auto [r0, c0] = pins[pick_pin(random)];
+            auto [r1, c1] = pins[pick_pin(random)];
+            if (pattern[r0][c0] != pattern[r1][c1]) {
+                Pattern proposal = pattern;
+                std::swap(proposal[r0][c0], proposal[r1][c1]);
+                return proposal;
+            }
+        }
+        throw std::string("The lattice needs at least two types of pin to optimize");
+    };
+
+    // Settle a source for the starting pattern
+    Evaluation current_run = _evaluate(_start, {}, pool);
+    Candidate current{_start, current_run.k, _score(current_run.k)};
+    _n_evaluations++;
+    _keep(current);
+
+    std::vector<Pattern> proposals(_settings.batch_size);
+    std::vector<Evaluation> evaluations(_settings.batch_size);
+    std::uniform_real_distribution<double> unit;
+    for (size_t step = 0; step < _settings.n_steps; ++step) {
+        // Propose on this thread, so that the proposals don't depend on the pool
+        for (auto &proposal : proposals) {
+            proposal = propose(current.pattern);
+        }
+
+        auto evaluate = [&](size_t i) {
+            evaluations[i] = _evaluate(proposals[i], current_run.source, pool);
+        };
+        if (pool) {
+            pool->parallel_for(proposals.size(), evaluate);
+        } else {
+            for (size_t i = 0; i < proposals.size(); ++i) {
+                evaluate(i);
+            }
+        }
+        _n_evaluations += proposals.size();
+
+        size_t i_best = 0;
+        std::vector<double> scores(proposals.size());
+        for (size_t i = 0; i < proposals.size(); ++i) {
+            scores[i] = _score(evaluations[i].k);
+            _keep(Candidate{proposals[i], evaluations[i].k, scores[i]});
+            if (scores[i] > scores[i_best]) {
+                i_best = i;
+            }
+        }
+
+        double fraction =
+            _settings.n_steps > 1 ? double(step) / (_settings.n_steps - 1) : 1.0;
+        double t0          = _settings.initial_temperature;
+        double temperature = t0 * std::pow(_settings.final_temperature / t0, fraction);
+
+        double worse = current.score - scores[i_best];
+        if (worse <= 0.0 || unit(random) < std::exp(-worse / temperature)) {
+            Evaluation &chosen = evaluations[i_best];
+            current            = Candidate{proposals[i_best], chosen.k, scores[i_best]};
+            current_run        = std::move(chosen);
+        }
+
+        if (on_step) {
+            on_step(step, current, _best.front());
+        }
+    }
+}
+
+std::string Optimizer::to_command(const Pattern &pattern)
+{
+    // The same letters as set_pattern uses
+    std::string command = "set_pattern";
+    for (const auto &row : pattern) {
+        command += " ";
+        for (const auto &pin : row) {
+            if (!pin) {
+                command += ".";
+                continue;
+            }
+            switch (pin.value()) {
+            case PinType::FUEL:
+                command += "f";
+                break;
+            case PinType::MODERATOR:
+                command += "m";
+                break;
+            case PinType::BLACK:
+                command += "c";
+                break;
+            case PinType::VOID:
+                command += "v";
+                break;
+            }
+        }
+    }
+    return command;
+}
+
+Optimizer::Evaluation Optimizer::_evaluate(const Pattern &pattern,
+                                           const std::vector<Particle> &source,
+                                           std::shared_ptr<ThreadPool> pool) const
+{
+    State state(_materials, _mesh);
+    state.set_thread_pool(std::move(pool));
+    state.set_seed(_settings.seed);
+    _setup->apply_all(&state);
+    state.set_pin_pattern(pattern);
+
+    if (source.empty()) {
+        Rect lattice{Vec2{0.0f, 0.0f}, Vec2{_mesh->get_width(), _mesh->get_height()}};
+        state.add_particles(Source::box(lattice), _settings.n_particles);
+    } else {
+        state.set_population(source);
+    }
+
+    auto count = [&state]() {
+        auto counts         = state.statistics().interactions;
+        double from_fission = state.n_born_from_fission();
+        double lost         = counts[1] + counts[2] + counts[3];
+        return std::make_pair(from_fission, lost);
+    };
+
+    state.advance(static_cast<unsigned int>(_settings.n_settle));
+    auto [born_before, lost_before] = count();
+    state.advance(static_cast<unsigned int>(_settings.n_tics - _settings.n_settle));
+    auto [born_after, lost_after] = count();
+
+    Evaluation evaluation;
+    double lost  = lost_after - lost_before;
+    evaluation.k = lost > 0.0 ? (born_after - born_before) / lost : 0.0;
+
+    // Comb what is left down to the size of the source, keeping its shape
+    const auto &particles = state.particles();
+    if (!particles.empty()) {
+        size_t n = _settings.n_particles;
+        evaluation.source.reserve(n);
+        double stride = double(particles.size()) / n;
+        for (size_t i = 0; i < n; ++i) {
+            evaluation.source.push_back(
+                particles[std::min(particles.size() - 1, size_t((i + 0.5) * stride))]);
+        }
+    }
+    return evaluation;
+}
+
+double Optimizer::_score(double k) const
+{
+    if (_settings.target_k) {
+        return -std::abs(k - _settings.target_k.value());
+    }
+    return k;
+}
+
+void Optimizer::_keep(const Candidate &candidate)
+{
+    for (const auto &kept : _best) {
+        if (kept.pattern == candidate.pattern) {
+            return;
+        }
+    }
+
+    auto after = std::find_if(_best.begin(), _best.end(), [&](const Candidate &kept) {
+        return kept.score < candidate.score;
+    });
+    _best.insert(after, candidate);
+    if (_best.size() > _settings.n_best) {
+        _best.pop_back();
+    }
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "materials.h"
+#include "mesh.h"
+#include "particle.h"
+#include "pin_types.h"
+#include "playbook.h"
+#include "thread_pool.h"
+
+// Searches for a loading pattern of the lattice by simulated annealing.
+//
+// The search starts from the lattice as a setup playbook leaves it, with its
+// commands applied once before the first tic, like the options of a Sweep. Each
+// step proposes a batch of patterns, each of which swaps two pins of different
+// types in the current pattern, so that the number of pins of each type never
+// changes. The proposals are scored side by side on a thread pool. The best of
+// them replaces the current pattern if it is better, or with a probability that
+// falls off with how much worse it is and with the temperature.
+//
+// Each proposal is scored with a short run that starts from the fission source
+// left by the current pattern, which is close to its own, so little of the run
+// is spent settling. Every run uses the same seed, so that differences between
+// the scores come from the patterns rather than from the noise. The score is an
+// estimate of k over the end of the run: neutrons born from fission over
+// neutrons lost to capture, fission and leakage. Without a target, the search
+// maximizes k; with one, it looks for the k closest to the target.
+class Optimizer {
+public:
+    // Rows of the lattice, top row first, as for State::set_pin_pattern()
+    using Pattern = std::vector<std::vector<std::optional<PinType>>>;
+
+    struct Settings {
+        size_t n_steps    = 100;
+        // Proposals scored at each step
+        size_t batch_size = 8;
+        // Length of each scoring run, and how much of the start of it is left
+        // out of the score
+        size_t n_tics   = 150;
+        size_t n_settle = 50;
+        // Number of particles handed from one run to the next
+        size_t n_particles = 2000;
+        // The temperature falls geometrically from the first to the last step
+        double initial_temperature = 0.02;
+        double final_temperature   = 0.0005;
+        std::optional<double> target_k = std::nullopt;
+        // How many of the best patterns to keep
+        size_t n_best     = 5;
+        unsigned int seed = 0;
+    };
+
+    struct Candidate {
+        Pattern pattern;
+        double k;
+        double score;
+    };
+
+    // Called after every step with the current and the best pattern so far
+    using StepCallback = std::function<void(size_t step, const Candidate &current,
+                                            const Candidate &best)>;
+
+    Optimizer(std::shared_ptr<const Playbook> setup, const Settings &settings);
+
+    // Search for a number of steps. The proposals of a step, and the tics of each
+    // of their runs, share the pool; without one, everything runs on this thread.
+    // Either way, the search goes the same way for the same seed.
+    void run(std::shared_ptr<ThreadPool> pool, const StepCallback &on_step);
+
+    // The best patterns found so far, best first
+    const std::vector<Candidate> &best() const
+    {
+        return _best;
+    }
+
+    size_t n_evaluations() const
+    {
+        return _n_evaluations;
+    }
+
+    // A pattern as a set_pattern playbook command, without the number of tics
+    static std::string to_command(const Pattern &pattern);
+
+private:
+    struct Evaluation {
+        double k;
+        // Particles left at the end of the run, as a source for the next ones
+        std::vector<Particle> source;
+    };
+
+    // Run a pattern from a source. An empty source starts from particles
+    // spread evenly over the lattice instead.
+    Evaluation _evaluate(const Pattern &pattern, const std::vector<Particle> &source,
+                         std::shared_ptr<ThreadPool> pool) const;
+
+    double _score(double k) const;
+
+    // Add a candidate to the best patterns, if it is good enough
+    void _keep(const Candidate &candidate);
+
+    std::shared_ptr<const Playbook> _setup;
+    Settings _settings;
+    std::shared_ptr<const MaterialLibrary> _materials;
+    std::shared_ptr<const Mesh> _mesh;
+    Pattern _start;
+
+    std::vector<Candidate> _best;
+    size_t _n_evaluations = 0;
+};
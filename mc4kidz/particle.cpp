@@ -1,4 +1,3 @@
 #include "particle.h"
 
-std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
 float Particle::base_speed = 0.05f;
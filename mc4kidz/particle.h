@@ -1,13 +1,13 @@
 #pragma once
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <iostream>
 #include <random>
 
 #include "materials.h"
 #include "simple_structs.h"
 
-extern std::uniform_real_distribution<float> uniform;
-
 struct Particle {
 public:
     Particle(Vec2 l, Vec2 v) : location(l), direction(v), alive(true)
@@ -20,15 +20,11 @@ public:
      */
     bool tic(float t)
     {
+        // Written without branches so that loops over particles can be if-converted
         float delta = base_speed / (float)(e_group + 1) * t;
-        bool done   = false;
-        if (delta > distance) {
-            delta = distance;
-            distance = 0.0;
-            done  = true;
-        } else {
-            distance -= delta;
-        }
+        bool done   = delta > distance;
+        delta       = std::min(delta, distance);
+        distance -= delta;
 
         location += direction * delta;
 
@@ -38,17 +34,32 @@ public:
     float sample_distance(std::default_random_engine &r)
     {
         assert(material);
+        std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
         distance = -std::log(uniform(r)) / material->xstr[e_group];
         return distance;
     }
 
+    // The same, from a uniform number on [0, 1)
+    float sample_distance(float u)
+    {
+        assert(material);
+        distance = -std::log1p(-u) / material->xstr[e_group];
+        return distance;
+    }
+
     Vec2 location;
     Vec2 direction;
     std::vector<Vec2> waypoints;
     static float base_speed;
     float distance          = 1.0f;
+    // Unique within a run, so that particles can be told apart regardless of
+    // where they end up in the population
+    uint64_t id             = 0;
     int e_group             = 0;
     unsigned int generation = 0;
+    // Number of neutrons the particle stands for. Counters and spectra add up
+    // weights rather than particles.
+    float weight            = 1.0f;
     bool alive              = true;
 
     const Material *material = nullptr;
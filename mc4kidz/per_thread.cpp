@@ -0,0 +1,68 @@
+#include "per_thread.h"
+
+#include <algorithm>
+#include <atomic>
+#include <unordered_set>
+#include <utility>
+
+static std::atomic<uint64_t> next_id{0};
+
+// Ids of the objects that are still around, and how many have gone so far
+static std::mutex registry_mutex;
+static std::unordered_set<uint64_t> live_ids;
+static std::atomic<uint64_t> n_retired{0};
+
+// Copies the calling thread has made, by the id of the object they belong to,
+// newest last
+struct ThreadCopies {
+    std::vector<std::pair<uint64_t, void *>> entries;
+    // Value of n_retired when the entries were last pruned
+    uint64_t n_retired_seen = 0;
+};
+static thread_local ThreadCopies thread_copies;
+
+PerThreadBase::PerThreadBase() : _id(next_id++)
+{
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    live_ids.insert(_id);
+    return;
+}
+
+PerThreadBase::~PerThreadBase()
+{
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    live_ids.erase(_id);
+    n_retired++;
+}
+
+size_t PerThreadBase::n_thread_copies()
+{
+    return thread_copies.entries.size();
+}
+
+void *PerThreadBase::_find() const
+{
+    const auto &entries = thread_copies.entries;
+    for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+        if (it->first == _id) {
+            return it->second;
+        }
+    }
+    return nullptr;
+}
+
+void PerThreadBase::_add(void *copy) const
+{
+    auto &copies = thread_copies;
+    if (copies.n_retired_seen != n_retired.load()) {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        auto gone = [](const std::pair<uint64_t, void *> &entry) {
+            return live_ids.count(entry.first) == 0;
+        };
+        copies.entries.erase(
+            std::remove_if(copies.entries.begin(), copies.entries.end(), gone),
+            copies.entries.end());
+        copies.n_retired_seen = n_retired.load();
+    }
+    copies.entries.emplace_back(_id, copy);
+}
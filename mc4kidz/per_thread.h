@@ -0,0 +1,78 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// The part of PerThread that doesn't depend on what it holds
+class PerThreadBase {
+public:
+    // Number of objects the calling thread has a copy of in its list
+    static size_t n_thread_copies();
+
+protected:
+    PerThreadBase();
+    ~PerThreadBase();
+
+    PerThreadBase(const PerThreadBase &) = delete;
+    PerThreadBase &operator=(const PerThreadBase &) = delete;
+
+    // The calling thread's copy, or nullptr if it hasn't made one yet
+    void *_find() const;
+
+    // Remember the calling thread's copy
+    void _add(void *copy) const;
+
+private:
+    // Never reused, so a thread can't mistake an object for one that is gone
+    uint64_t _id;
+};
+
+// A copy of something for each thread that uses it, such as a buffer to score
+// into, so that the threads don't contend over it.
+//
+// Each thread keeps a list of the copies it has made, which it searches newest
+// first without taking any lock. The copies themselves belong to the PerThread
+// and go with it. A thread drops the entries of objects that have gone the next
+// time it makes a copy, so that its list never holds more than the objects that
+// are still around.
+template <typename T> class PerThread : private PerThreadBase {
+public:
+    PerThread() = default;
+
+    // The calling thread's copy, made by make() the first time it asks
+    template <typename Make> T &local(const Make &make)
+    {
+        if (void *copy = _find()) {
+            return *static_cast<T *>(copy);
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _copies.push_back(std::make_unique<T>(make()));
+        _add(_copies.back().get());
+        return *_copies.back();
+    }
+
+    // Call f on every copy made so far. The copies themselves aren't locked, so
+    // this must not be called while any thread might be changing its own.
+    template <typename F> void for_each(const F &f)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto &copy : _copies) {
+            f(*copy);
+        }
+    }
+
+    template <typename F> void for_each(const F &f) const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (const auto &copy : _copies) {
+            f(static_cast<const T &>(*copy));
+        }
+    }
+
+private:
+    mutable std::mutex _mutex;
+    std::vector<std::unique_ptr<T>> _copies;
+};
@@ -22,9 +22,10 @@ static const std::vector<Color> _colors = {
 
 template <typename T> void PieChart<T>::draw() const
 {
-    const auto data          = get_data();
+    get_data(_data);
+    const auto &data         = _data;
     const int total_segments = 100;
-    T total                  = std::accumulate(data.begin(), data.end(), 0);
+    T total                  = std::accumulate(data.begin(), data.end(), T(0));
     float stt_angle          = 0.0f;
     for (int i = 0; i < data.size(); ++i) {
         float fraction   = static_cast<float>(data[i]) / static_cast<float>(total);
@@ -47,4 +48,4 @@ template <typename T> void PieChart<T>::draw() const
     return;
 }
 
-template class PieChart<unsigned int>;
\ No newline at end of file
+template class PieChart<double>;
\ No newline at end of file
@@ -14,22 +14,28 @@ public:
 
     void draw() const;
 
-    virtual std::vector<T> get_data() const = 0;
+    // Fill in the size of each slice
+    virtual void get_data(std::vector<T> &data) const = 0;
+
+private:
+    // Kept from frame to frame, so that drawing doesn't allocate
+    mutable std::vector<T> _data;
 };
 
-class InteractionPieChart : public PieChart<unsigned int> {
+class InteractionPieChart : public PieChart<double> {
 public:
     InteractionPieChart(const State *state) : _state(state)
     {
         return;
     }
 
-    std::vector<unsigned int> get_data() const
+    void get_data(std::vector<double> &data) const
     {
+        data.clear();
         if (_state) {
-            return _state->get_interaction_counts();   
-		}
-        return {};
+            const auto counts = _state->statistics().interactions;
+            data.assign(counts.begin(), counts.end());
+        }
     }
 
 private:
@@ -1,7 +1,11 @@
 #include "playbook.h"
 
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
 #include <fstream>
-#include <iostream>
+#include <iterator>
 #include <memory>
 #include <sstream>
 #include <string>
@@ -13,177 +17,144 @@
 
 #undef VOID
 
-// trim from start (in place)
-static inline void ltrim(std::string &s)
+// First bytes of a compiled playbook. The rest of the header follows, then the
+// Ops, then the arguments, all in the byte order of the machine that wrote them.
+// Version 1 kept every argument as a float.
+static const char MAGIC[8] = {'M', 'C', '4', 'K', 'P', 'B', 'C', '2'};
+
+struct CompiledHeader {
+    char magic[8];
+    uint32_t n_ops;
+    uint32_t n_args;
+    // Index of the op to stop at, or n_ops if there isn't one
+    uint64_t stop_command;
+};
+
+static const std::unordered_map<std::string_view, PinType> pin_type_map = {
+    {"fuel", PinType::FUEL},
+    {"moderator", PinType::MODERATOR},
+    {"control", PinType::BLACK},
+    {"void", PinType::VOID}};
+
+// Letters used for each pin type in a pattern, with '.' leaving a pin alone
+static const std::unordered_map<char, PinType> pattern_map = {{'f', PinType::FUEL},
+                                                              {'m', PinType::MODERATOR},
+                                                              {'c', PinType::BLACK},
+                                                              {'v', PinType::VOID}};
+
+// Pattern entry for a pin that is left alone
+static const int32_t PATTERN_SKIP = 255;
+
+static Arg float_arg(float x)
 {
-    s.erase(s.begin(),
-            std::find_if(s.begin(), s.end(), [](int ch) { return !std::isspace(ch); }));
+    Arg arg;
+    arg.f = x;
+    return arg;
 }
 
-// trim from end (in place)
-static inline void rtrim(std::string &s)
+static Arg int_arg(int32_t x)
 {
-    s.erase(std::find_if(s.rbegin(), s.rend(), [](int ch) { return !std::isspace(ch); })
-                .base(),
-            s.end());
+    Arg arg;
+    arg.i = x;
+    return arg;
 }
 
-// trim from both ends (in place)
-static inline void trim(std::string &s)
+static bool is_space(char c)
 {
-    ltrim(s);
-    rtrim(s);
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f' || c == '\v';
 }
 
-class NoOpCommand : public Command {
-public:
-    NoOpCommand()
-    {
-        std::cout << "wait";
-        return;
-    };
-
-    void execute(State *state) const override final
-    {
-        return;
-    }
-};
-
-class ResetCommand : public Command {
-public:
-    ResetCommand()
-    {
-        std::cout << "resetting";
-        return;
-    };
-
-    void execute(State *state) const override final
-    {
-        state->reset(false);
-    }
-};
-
-class ToggleBoundaryCommand : public Command {
+// Split a line into whitespace-separated tokens, one at a time
+class Tokens {
 public:
-    ToggleBoundaryCommand()
+    Tokens(std::string_view line, size_t line_number)
+        : _rest(line), _line_number(line_number)
     {
-        std::cout << "toggling boundary condition";
         return;
     }
 
-    void execute(State *state) const override final
-    {
-        state->toggle_boundary_condition();
-    }
-};
-
-class ToggleMaterialCommand : public Command {
-public:
-    ToggleMaterialCommand(std::stringstream &args)
+    bool empty()
     {
-        args >> _x;
-        args >> _y;
-        std::cout << "cycling material at (" << _x << ", " << _y << ")";
-        return;
+        _skip_space();
+        return _rest.empty();
     }
 
-    void execute(State *state) const override final
+    // First character of the next token. Only call this if !empty().
+    char front()
     {
-        state->cycle_shape(_x, _y);
+        _skip_space();
+        return _rest.front();
     }
 
-private:
-    float _x;
-    float _y;
-};
-
-class CycleAllPinsCommand : public Command {
-public:
-    CycleAllPinsCommand()
+    std::string_view next()
     {
-        std::cout << "cycle all pin materials";
-        return;
+        _skip_space();
+        size_t end = 0;
+        while (end < _rest.size() && !is_space(_rest[end])) {
+            ++end;
+        }
+        auto token = _rest.substr(0, end);
+        _rest.remove_prefix(end);
+        if (token.empty()) {
+            fail("unexpected end of line");
+        }
+        return token;
     }
 
-    void execute(State *state) const override final
+    template <typename T> T next_number()
     {
-        state->cycle_all();
+        auto token = next();
+        T value{};
+        auto result = std::from_chars(token.data(), token.data() + token.size(), value);
+        if (result.ec != std::errc() || result.ptr != token.data() + token.size()) {
+            fail("failed to parse number: " + std::string(token));
+        }
+        return value;
     }
-};
 
-class SetMaterialCommand : public Command {
-public:
-    SetMaterialCommand(std::stringstream &args)
+    PinType next_pin_type()
     {
-        args >> _x;
-        args >> _y;
-        std::string material;
-        args >> material;
-
-        auto material_iter = _material_map.find(material);
-        if (material_iter == _material_map.end()) {
-            std::stringstream msg;
-            msg << "failed to parse material specification: " << material;
-            throw msg.str();
+        auto token = next();
+        auto type  = pin_type_map.find(token);
+        if (type == pin_type_map.end()) {
+            fail("failed to parse material specification: " + std::string(token));
         }
-        _material = material_iter->second;
-
-        std::cout << "Setting material to " << material << " at (" << _x << ", " << _y
-                  << ")";
-        return;
+        return type->second;
     }
 
-    void execute(State *state) const override final
+    [[noreturn]] void fail(const std::string &what) const
     {
-        state->set_material_at(Vec2{_x, _y}, _material);
+        std::stringstream msg;
+        msg << "Playbook line " << _line_number << ": " << what;
+        throw msg.str();
     }
 
 private:
-    float _x;
-    float _y;
-    PinType _material;
-    static const std::unordered_map<std::string, PinType> _material_map;
-};
-
-const std::unordered_map<std::string, PinType> SetMaterialCommand::_material_map = {
-    {"fuel", PinType::FUEL},
-    {"moderator", PinType::MODERATOR},
-    {"control", PinType::BLACK},
-    {"void", PinType::VOID}};
-
-class AddParticlesCommand : public Command {
-public:
-    AddParticlesCommand(std::stringstream &args)
+    void _skip_space()
     {
-        args >> _x;
-        args >> _y;
-        args >> _n;
-        std::cout << "adding " << _n << " particles at (" << _x << ", " << _y << ")";
-        return;
-    }
-
-    void execute(State *state) const override final
-    {
-        state->add_particles(Vec2{_x, _y}, _n);
+        size_t n = 0;
+        while (n < _rest.size() && is_space(_rest[n])) {
+            ++n;
+        }
+        _rest.remove_prefix(n);
     }
 
-private:
-    float _x;
-    float _y;
-    float _n;
+    std::string_view _rest;
+    size_t _line_number;
 };
 
 Playbook::Playbook()
 {
-    auto ss = std::stringstream("8.5 8.5 200");
-    _commands.push_back(std::make_pair(
-        0, std::make_unique<AddParticlesCommand>(ss)));
+    auto program = std::make_shared<Program>();
+    program->args = {float_arg(8.5f), float_arg(8.5f), int_arg(200)};
+    program->ops.push_back(Op{0, 0, 3, Instruction::ADD_PARTICLES, 0, {0, 0}});
+    _program = std::move(program);
     return;
 }
 
 Playbook::Playbook(const std::string &fname)
 {
-    std::ifstream in_file(fname);
+    std::ifstream in_file(fname, std::ios::binary | std::ios::ate);
     if (!in_file.good()) {
         std::stringstream msg;
         msg << "Failed to open playbook file: " << fname;
@@ -191,88 +162,463 @@ Playbook::Playbook(const std::string &fname)
         throw str;
     }
 
-    while (in_file.good()) {
-        std::string line_src;
-        std::getline(in_file, line_src);
-        trim(line_src);
+    // Read it all in one go
+    std::string contents(static_cast<size_t>(in_file.tellg()), '\0');
+    in_file.seekg(0);
+    in_file.read(contents.data(), contents.size());
 
-        if (line_src.size() == 0) {
-            continue;
+    _load(contents, fname);
+}
+
+Playbook::Playbook(std::istream &in)
+{
+    std::string contents((std::istreambuf_iterator<char>(in)),
+                         std::istreambuf_iterator<char>());
+    _load(contents, "<stream>");
+}
+
+void Playbook::_load(const std::string &contents, const std::string &fname)
+{
+    if (contents.size() >= sizeof(MAGIC) &&
+        std::memcmp(contents.data(), MAGIC, sizeof(MAGIC)) == 0) {
+        _load_compiled(contents, fname);
+    } else {
+        _parse(contents);
+    }
+}
+
+void Playbook::_parse(std::string_view text)
+{
+    auto program = std::make_shared<Program>();
+    auto &ops    = program->ops;
+    auto &args   = program->args;
+
+    // Most lines hold one instruction
+    ops.reserve(std::count(text.begin(), text.end(), '\n') + 1);
+
+    std::string joined;
+    size_t line_number = 0;
+    while (!text.empty()) {
+        // Gather up one logical line. A trailing backslash continues it.
+        size_t first_line = line_number + 1;
+        std::string_view line;
+        joined.clear();
+        bool continued = true;
+        while (continued && !text.empty()) {
+            size_t eol = text.find('\n');
+            auto piece = text.substr(0, eol);
+            text.remove_prefix(eol == std::string_view::npos ? text.size() : eol + 1);
+            line_number++;
+
+            while (!piece.empty() && is_space(piece.back())) {
+                piece.remove_suffix(1);
+            }
+            continued = !piece.empty() && piece.back() == '\\';
+            if (continued) {
+                piece.remove_suffix(1);
+            }
+
+            if (continued || !joined.empty()) {
+                joined.append(piece);
+                joined.push_back(' ');
+                line = joined;
+            } else {
+                line = piece;
+            }
         }
 
-        if (line_src[0] == '#') {
+        Tokens tokens(line, first_line);
+        if (tokens.empty() || tokens.front() == '#') {
             continue;
         }
 
-        std::stringstream line(line_src);
-
-        // Parse the number of tics until the following instruction
-        size_t n_tics;
-        line >> n_tics;
+        Op op{};
+        op.wait      = tokens.next_number<uint32_t>();
+        op.arg_begin = static_cast<uint32_t>(args.size());
 
-        // Try to parse the instruction
-        std::string instruction_str;
-        line >> instruction_str;
-
-        auto inst_iter = _instruction_map.find(instruction_str);
+        auto instruction_str = tokens.next();
+        auto inst_iter       = _instruction_map.find(instruction_str);
         if (inst_iter == _instruction_map.end()) {
-            std::stringstream msg;
-            msg << "Failed to parse instruction: " << instruction_str;
-            throw msg.str();
+            tokens.fail("failed to parse instruction: " + std::string(instruction_str));
         }
-        Instruction instruction = inst_iter->second;
+        op.instruction = inst_iter->second;
 
-        // Based on the instruction, parse arguments or not
-        std::unique_ptr<Command> cmd = nullptr;
+        auto take = [&](int n) {
+            for (int i = 0; i < n; ++i) {
+                args.push_back(float_arg(tokens.next_number<float>()));
+            }
+        };
 
-        std::cout << "After " << n_tics << " tics, ";
-        switch (instruction) {
+        switch (op.instruction) {
         case Instruction::RESET:
-            cmd = std::make_unique<ResetCommand>();
-            break;
-
         case Instruction::TOGGLE_BOUNDARY:
-            cmd = std::make_unique<ToggleBoundaryCommand>();
+        case Instruction::CYCLE_ALL:
+        case Instruction::NOOP:
             break;
-
         case Instruction::TOGGLE_MATERIAL:
-            cmd = std::make_unique<ToggleMaterialCommand>(line);
+            take(2);
             break;
-        case Instruction::CYCLE_ALL:
-            cmd = std::make_unique<CycleAllPinsCommand>();
+        case Instruction::SET_MATERIAL:
+            take(2);
+            op.pin_type = static_cast<uint8_t>(tokens.next_pin_type());
+            break;
+        case Instruction::SET_RECT:
+        case Instruction::SET_RING:
+            take(4);
+            op.pin_type = static_cast<uint8_t>(tokens.next_pin_type());
+            break;
+        case Instruction::SET_PINS:
+            op.pin_type = static_cast<uint8_t>(tokens.next_pin_type());
+            // Pins are given as ix,iy
+            while (!tokens.empty()) {
+                auto pin   = tokens.next();
+                int ix     = 0;
+                int iy     = 0;
+                auto end   = pin.data() + pin.size();
+                auto first = std::from_chars(pin.data(), end, ix);
+                bool good =
+                    first.ec == std::errc() && first.ptr != end && *first.ptr == ',';
+                if (good) {
+                    auto second = std::from_chars(first.ptr + 1, end, iy);
+                    good        = second.ec == std::errc() && second.ptr == end;
+                }
+                if (!good) {
+                    tokens.fail("failed to parse pin index: " + std::string(pin));
+                }
+                args.push_back(int_arg(ix));
+                args.push_back(int_arg(iy));
+            }
+            break;
+        case Instruction::SET_PATTERN:
+            // Each row is stored as its length, followed by a code per pin
+            while (!tokens.empty()) {
+                auto row = tokens.next();
+                args.push_back(int_arg(static_cast<int32_t>(row.size())));
+                for (char c : row) {
+                    if (c == '.') {
+                        args.push_back(int_arg(PATTERN_SKIP));
+                        continue;
+                    }
+                    auto type_iter = pattern_map.find(c);
+                    if (type_iter == pattern_map.end()) {
+                        tokens.fail("failed to parse pattern row: " + std::string(row));
+                    }
+                    args.push_back(int_arg(static_cast<int32_t>(type_iter->second)));
+                }
+            }
+            break;
+        case Instruction::ADD_PARTICLES:
+            take(2);
+            args.push_back(int_arg(tokens.next_number<int32_t>()));
+            break;
+        case Instruction::HALT:
+            // First halt instruction encountered stops the playbook. It keeps
+            // its slot as a noop.
+            if (!program->stop_command) {
+                program->stop_command = ops.size();
+            }
+            op.instruction = Instruction::NOOP;
             break;
+        }
+
+        op.n_args = static_cast<uint32_t>(args.size() - op.arg_begin);
+        ops.push_back(op);
+    }
+
+    _program = std::move(program);
+}
+
+// Number of arguments an instruction takes, or -1 if it varies
+static int arity(Instruction instruction)
+{
+    switch (instruction) {
+    case Instruction::TOGGLE_MATERIAL:
+    case Instruction::SET_MATERIAL:
+        return 2;
+    case Instruction::SET_RECT:
+    case Instruction::SET_RING:
+        return 4;
+    case Instruction::ADD_PARTICLES:
+        return 3;
+    case Instruction::SET_PINS:
+    case Instruction::SET_PATTERN:
+        return -1;
+    default:
+        return 0;
+    }
+}
+
+void Playbook::_load_compiled(std::string_view data, const std::string &fname)
+{
+    auto fail = [&fname](const std::string &what) {
+        std::stringstream msg;
+        msg << "Bad compiled playbook " << fname << ": " << what;
+        throw msg.str();
+    };
+
+    CompiledHeader header;
+    if (data.size() < sizeof(header)) {
+        fail("truncated header");
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    data.remove_prefix(sizeof(header));
+
+    size_t ops_size  = size_t(header.n_ops) * sizeof(Op);
+    size_t args_size = size_t(header.n_args) * sizeof(Arg);
+    if (data.size() != ops_size + args_size) {
+        fail("wrong size");
+    }
+
+    auto program = std::make_shared<Program>();
+    program->ops.resize(header.n_ops);
+    program->args.resize(header.n_args);
+    std::memcpy(program->ops.data(), data.data(), ops_size);
+    std::memcpy(program->args.data(), data.data() + ops_size, args_size);
+    if (header.stop_command < header.n_ops) {
+        program->stop_command = header.stop_command;
+    }
+
+    // Check enough that executing the ops can't go out of bounds, or hand the
+    // state positions that aren't numbers
+    for (const auto &op : program->ops) {
+        if (op.instruction > Instruction::HALT) {
+            fail("unknown instruction");
+        }
+        if (size_t(op.arg_begin) + op.n_args > header.n_args) {
+            fail("arguments out of range");
+        }
+        int n = arity(op.instruction);
+        if ((n >= 0 && op.n_args != static_cast<uint32_t>(n)) ||
+            (op.instruction == Instruction::SET_PINS && op.n_args % 2 != 0)) {
+            fail("wrong number of arguments");
+        }
+        if (op.pin_type > static_cast<uint8_t>(PinType::VOID)) {
+            fail("unknown material");
+        }
+        const Arg *a   = program->args.data() + op.arg_begin;
+        const Arg *end = a + op.n_args;
+        switch (op.instruction) {
+        case Instruction::TOGGLE_MATERIAL:
         case Instruction::SET_MATERIAL:
-            cmd = std::make_unique<SetMaterialCommand>(line);
+        case Instruction::SET_RECT:
+        case Instruction::SET_RING:
+            for (; a < end; ++a) {
+                if (!std::isfinite(a->f)) {
+                    fail("argument is not a number");
+                }
+            }
             break;
         case Instruction::ADD_PARTICLES:
-            cmd = std::make_unique<AddParticlesCommand>(line);
+            if (!std::isfinite(a[0].f) || !std::isfinite(a[1].f) || a[2].i < 0) {
+                fail("bad particle source");
+            }
             break;
-        case Instruction::NOOP:
-            cmd = std::make_unique<NoOpCommand>();
+        case Instruction::SET_PATTERN:
+            // Each row length has to fit in what is left of the op's arguments,
+            // and each code has to be a material or a skip
+            while (a < end) {
+                int32_t n = a->i;
+                ++a;
+                if (n < 0 || n > end - a) {
+                    fail("malformed pattern");
+                }
+                for (const Arg *row_end = a + n; a < row_end; ++a) {
+                    bool material =
+                        a->i >= 0 && a->i <= static_cast<int32_t>(PinType::VOID);
+                    if (!material && a->i != PATTERN_SKIP) {
+                        fail("unknown material in pattern");
+                    }
+                }
+            }
             break;
-        case Instruction::HALT:
-            // First halt instruction encountered stops the playbook
-            if (!_stop_command) {
-                _stop_command = _commands.size();
+        default:
+            break;
+        }
+    }
+
+    _program = std::move(program);
+}
+
+void Playbook::save(const std::string &fname) const
+{
+    std::ofstream out(fname, std::ios::binary);
+    if (!out.good()) {
+        std::stringstream msg;
+        msg << "Failed to open compiled playbook file: " << fname;
+        throw msg.str();
+    }
+
+    const auto &ops  = _program->ops;
+    const auto &args = _program->args;
+    CompiledHeader header;
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.n_ops        = static_cast<uint32_t>(ops.size());
+    header.n_args       = static_cast<uint32_t>(args.size());
+    header.stop_command = _program->stop_command.value_or(ops.size());
+
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(ops.data()), ops.size() * sizeof(Op));
+    out.write(reinterpret_cast<const char *>(args.data()), args.size() * sizeof(Arg));
+    if (!out.good()) {
+        std::stringstream msg;
+        msg << "Failed to write compiled playbook file: " << fname;
+        throw msg.str();
+    }
+}
+
+// Shortest text that reads back as the same float
+static void print_float(std::ostream &out, float x)
+{
+    char buffer[32];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), x);
+    out.write(buffer, result.ptr - buffer);
+}
+
+void Playbook::print(std::ostream &out) const
+{
+    const auto &ops = _program->ops;
+    for (size_t i = 0; i < ops.size(); ++i) {
+        const Op &op   = ops[i];
+        const Arg *a = _program->args.data() + op.arg_begin;
+
+        std::string_view name;
+        for (const auto &entry : _instruction_map) {
+            if (entry.second == op.instruction) {
+                name = entry.first;
+            }
+        }
+        if (_program->stop_command == i) {
+            name = "halt";
+        }
+        out << op.wait << " " << name;
+
+        std::string_view material;
+        for (const auto &entry : pin_type_map) {
+            if (static_cast<uint8_t>(entry.second) == op.pin_type) {
+                material = entry.first;
+            }
+        }
+
+        switch (op.instruction) {
+        case Instruction::SET_PINS:
+            out << " " << material;
+            for (uint32_t j = 0; j < op.n_args; j += 2) {
+                out << " " << a[j].i << "," << a[j + 1].i;
+            }
+            break;
+        case Instruction::SET_PATTERN: {
+            const Arg *end = a + op.n_args;
+            while (a < end) {
+                int32_t n = (a++)->i;
+                out << " ";
+                for (int32_t j = 0; j < n; ++j, ++a) {
+                    char c = '.';
+                    for (const auto &entry : pattern_map) {
+                        if (static_cast<int32_t>(entry.second) == a->i) {
+                            c = entry.first;
+                        }
+                    }
+                    out << c;
+                }
             }
-            // insert a noop so that there is a slot for this instruction
-            cmd = std::make_unique<NoOpCommand>();
             break;
         }
-        std::cout << "\n";
+        case Instruction::ADD_PARTICLES:
+            out << " ";
+            print_float(out, a[0].f);
+            out << " ";
+            print_float(out, a[1].f);
+            out << " " << a[2].i;
+            break;
+        default:
+            for (uint32_t j = 0; j < op.n_args; ++j) {
+                out << " ";
+                print_float(out, a[j].f);
+            }
+            if (op.instruction == Instruction::SET_MATERIAL ||
+                op.instruction == Instruction::SET_RECT ||
+                op.instruction == Instruction::SET_RING) {
+                out << " " << material;
+            }
+            break;
+        }
+        out << "\n";
+    }
+}
+
+void Playbook::_execute(const Op &op, State *state) const
+{
+    const Arg *a     = _program->args.data() + op.arg_begin;
+    PinType pin_type = static_cast<PinType>(op.pin_type);
 
-        if (cmd) {
-            _commands.push_back(std::make_pair(n_tics, std::move(cmd)));
+    switch (op.instruction) {
+    case Instruction::RESET:
+        state->reset(false);
+        break;
+    case Instruction::TOGGLE_BOUNDARY:
+        state->toggle_boundary_condition();
+        break;
+    case Instruction::TOGGLE_MATERIAL:
+        state->cycle_shape(a[0].f, a[1].f);
+        break;
+    case Instruction::CYCLE_ALL:
+        state->cycle_all();
+        break;
+    case Instruction::SET_MATERIAL:
+        state->set_material_at(Vec2{a[0].f, a[1].f}, pin_type);
+        break;
+    case Instruction::SET_RECT:
+        state->set_material_in_rect(Rect{Vec2{a[0].f, a[1].f}, Vec2{a[2].f, a[3].f}},
+                                    pin_type);
+        break;
+    case Instruction::SET_RING:
+        state->set_material_in_ring(Vec2{a[0].f, a[1].f}, a[2].f, a[3].f, pin_type);
+        break;
+    case Instruction::SET_PINS: {
+        std::vector<std::pair<int, int>> pins;
+        pins.reserve(op.n_args / 2);
+        for (uint32_t i = 0; i < op.n_args; i += 2) {
+            pins.emplace_back(a[i].i, a[i + 1].i);
         }
+        state->set_material_at_pins(pins, pin_type);
+        break;
+    }
+    case Instruction::SET_PATTERN: {
+        std::vector<std::vector<std::optional<PinType>>> rows;
+        const Arg *end = a + op.n_args;
+        while (a < end) {
+            auto &row = rows.emplace_back();
+            int32_t n = (a++)->i;
+            for (int32_t i = 0; i < n; ++i, ++a) {
+                if (a->i == PATTERN_SKIP) {
+                    row.push_back(std::nullopt);
+                } else {
+                    row.push_back(static_cast<PinType>(a->i));
+                }
+            }
+        }
+        state->set_pin_pattern(rows);
+        break;
+    }
+    case Instruction::ADD_PARTICLES:
+        state->add_particles(Vec2{a[0].f, a[1].f}, a[2].i);
+        break;
+    case Instruction::NOOP:
+    case Instruction::HALT:
+        break;
     }
 }
 
-const std::unordered_map<std::string, Instruction> Playbook::_instruction_map = {
+const std::unordered_map<std::string_view, Instruction> Playbook::_instruction_map = {
     {"reset", Instruction::RESET},
     {"toggle_boundary", Instruction::TOGGLE_BOUNDARY},
     {"toggle_material", Instruction::TOGGLE_MATERIAL},
     {"cycle_all", Instruction::CYCLE_ALL},
     {"set_material", Instruction::SET_MATERIAL},
+    {"set_rect", Instruction::SET_RECT},
+    {"set_ring", Instruction::SET_RING},
+    {"set_pins", Instruction::SET_PINS},
+    {"set_pattern", Instruction::SET_PATTERN},
     {"add_particles", Instruction::ADD_PARTICLES},
     {"noop", Instruction::NOOP},
     {"halt", Instruction::HALT}};
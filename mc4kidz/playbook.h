@@ -1,9 +1,12 @@
 #pragma once
 #include <cstdint>
+#include <istream>
 #include <limits>
 #include <memory>
 #include <optional>
+#include <ostream>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
@@ -15,34 +18,87 @@ enum class Instruction : uint8_t {
     TOGGLE_MATERIAL,
 	CYCLE_ALL,
 	SET_MATERIAL,
+    SET_RECT,
+    SET_RING,
+    SET_PINS,
+    SET_PATTERN,
 	ADD_PARTICLES,
     NOOP,
     HALT
 };
 
-class Command {
-public:
-    virtual void execute(State *state) const = 0;
+// One compiled command. Its arguments live in the argument pool of the playbook,
+// starting at arg_begin. The layout is fixed, since compiled playbooks are
+// written to disk as an array of these.
+struct Op {
+    // Number of tics to wait before carrying out the instruction
+    uint32_t wait;
+    uint32_t arg_begin;
+    uint32_t n_args;
+    Instruction instruction;
+    // For instructions that set a material, the PinType to set
+    uint8_t pin_type;
+    uint8_t padding[2];
+};
+static_assert(sizeof(Op) == 16, "compiled playbooks depend on the layout of Op");
+
+// One argument of an Op. Positions and radii are floats; particle counts, pin
+// indices and pattern codes are integers.
+union Arg {
+    float f;
+    int32_t i;
 };
+static_assert(sizeof(Arg) == 4, "compiled playbooks depend on the layout of Arg");
 
+// A sequence of timed instructions, looping back to the start once it gets to
+// the end.
+//
+// Playbooks are read either from text, one instruction per line (see the README),
+// or from the compiled form written by save(). Both are turned into a flat array
+// of Ops and a pool of arguments, which are shared between copies of a playbook;
+// each copy only keeps its own position in the sequence.
 class Playbook {
 public:
     Playbook();
+    // Read a text or compiled playbook, telling them apart by the first bytes of
+    // the file
     Playbook(const std::string &fname);
+    Playbook(std::istream &in);
+
+    // Write the compiled form of the playbook
+    void save(const std::string &fname) const;
+
+    // Write the playbook back out as text
+    void print(std::ostream &out) const;
+
+    size_t size() const
+    {
+        return _program->ops.size();
+    }
+
+    // Execute every command once, in order, regardless of their timing. Used to
+    // apply a set of edits up front rather than over the course of a run.
+    void apply_all(State *state) const
+    {
+        for (const auto &op : _program->ops) {
+            _execute(op, state);
+        }
+    }
 
     // Execute commands until a circuit is completed or we need to do more
     // simulation to get to the next command. Return the number of tics to get to
     // the next command.
     size_t execute_next(State *state)
     {
-        if (_commands.size() == 0) {
+        const auto &ops = _program->ops;
+        if (ops.size() == 0) {
             return std::numeric_limits<size_t>::max();
         }
 
         size_t current_command = _next_command;
         while (true) {
-            _commands[_next_command].second->execute(state);
-            _next_command = (_next_command + 1) % _commands.size();
+            _execute(ops[_next_command], state);
+            _next_command = (_next_command + 1) % ops.size();
 
             // Avoid infinite loops, if all commands happen after zero time
             if (_next_command == current_command) {
@@ -50,25 +106,26 @@ public:
             }
 
             // Execute commands until the next has a non-zero time
-            if (_commands[_next_command].first > 0) {
+            if (ops[_next_command].wait > 0) {
                 break;
             }
 
 			// Tell the caller to go on forever if we get to the halt command
-            if (_stop_command && _next_command == _stop_command.value()) {
+            const auto &stop = _program->stop_command;
+            if (stop && _next_command == stop.value()) {
                 return std::numeric_limits<size_t>::max();
             }
         }
 
-        return _commands[_next_command].first;
+        return ops[_next_command].wait;
     }
 
     size_t tics_to_next() const
     {
-        if (_commands.size() == 0) {
+        if (_program->ops.size() == 0) {
             return std::numeric_limits<size_t>::max();
         }
-        return _commands[_next_command].first;
+        return _program->ops[_next_command].wait;
     }
 
     void reset()
@@ -76,10 +133,32 @@ public:
         _next_command = 0;
     }
 
+    // Position in the sequence of commands, for saving and restoring progress
+    size_t cursor() const
+    {
+        return _next_command;
+    }
+
+    void set_cursor(size_t cursor)
+    {
+        _next_command = cursor;
+    }
+
 private:
-    size_t _next_command                = 0;
-    std::optional<size_t> _stop_command = std::nullopt;
-    std::vector<std::pair<size_t, std::unique_ptr<Command>>> _commands;
+    struct Program {
+        std::vector<Op> ops;
+        std::vector<Arg> args;
+        std::optional<size_t> stop_command = std::nullopt;
+    };
+
+    // Set up from the contents of a file, compiled or not
+    void _load(const std::string &contents, const std::string &fname);
+    void _parse(std::string_view text);
+    void _load_compiled(std::string_view data, const std::string &fname);
+    void _execute(const Op &op, State *state) const;
 
-    static const std::unordered_map<std::string, Instruction> _instruction_map;
-};
\ No newline at end of file
+    size_t _next_command = 0;
+    std::shared_ptr<const Program> _program;
+
+    static const std::unordered_map<std::string_view, Instruction> _instruction_map;
+};
@@ -0,0 +1,123 @@
+#include "quantile_sketch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+void QuantileSketch::add(float x)
+{
+    if (_levels.empty()) {
+        _grow(1);
+        _min = x;
+        _max = x;
+    }
+    _min = std::min(_min, x);
+    _max = std::max(_max, x);
+    _levels[0].push_back(x);
+    _n++;
+    _size++;
+    if (_size >= _limit) {
+        _compact();
+    }
+}
+
+void QuantileSketch::merge(const QuantileSketch &other)
+{
+    if (other._n == 0) {
+        return;
+    }
+    if (_n == 0) {
+        _min = other._min;
+        _max = other._max;
+    }
+    _min = std::min(_min, other._min);
+    _max = std::max(_max, other._max);
+    if (_levels.size() < other._levels.size()) {
+        _grow(other._levels.size());
+    }
+    for (size_t h = 0; h < other._levels.size(); ++h) {
+        _levels[h].insert(_levels[h].end(), other._levels[h].begin(),
+                          other._levels[h].end());
+    }
+    _n += other._n;
+    _size += other._size;
+    while (_size >= _limit) {
+        _compact();
+    }
+}
+
+float QuantileSketch::quantile(double q) const
+{
+    if (_n == 0) {
+        return 0.0f;
+    }
+    if (q <= 0.0) {
+        return _min;
+    }
+    if (q >= 1.0) {
+        return _max;
+    }
+
+    std::vector<std::pair<float, uint64_t>> weighted;
+    weighted.reserve(_size);
+    for (size_t h = 0; h < _levels.size(); ++h) {
+        for (float x : _levels[h]) {
+            weighted.emplace_back(x, uint64_t(1) << h);
+        }
+    }
+    std::sort(weighted.begin(), weighted.end());
+
+    // Compaction keeps the total weight equal to the count
+    double rank     = q * _n;
+    uint64_t passed = 0;
+    for (const auto &[x, weight] : weighted) {
+        passed += weight;
+        if (passed >= rank) {
+            return x;
+        }
+    }
+    return _max;
+}
+
+size_t QuantileSketch::_capacity(size_t level) const
+{
+    double depth = static_cast<double>(_levels.size() - 1 - level);
+    auto capacity = static_cast<size_t>(std::ceil(K * std::pow(2.0 / 3.0, depth)));
+    return std::max<size_t>(2, capacity);
+}
+
+void QuantileSketch::_grow(size_t n_levels)
+{
+    _levels.resize(n_levels);
+    _levels.back().reserve(K);
+    _limit = 0;
+    for (size_t h = 0; h < _levels.size(); ++h) {
+        _limit += _capacity(h);
+    }
+}
+
+void QuantileSketch::_compact()
+{
+    size_t h = 0;
+    while (h + 1 < _levels.size() && _levels[h].size() < _capacity(h)) {
+        h++;
+    }
+    if (h + 1 == _levels.size()) {
+        _grow(_levels.size() + 1);
+    }
+
+    std::vector<float> &level = _levels[h];
+    std::sort(level.begin(), level.end());
+    // An odd sample out stays behind, so that no weight is lost
+    size_t n_pairs = level.size() / 2;
+    size_t first   = level.size() - 2 * n_pairs;
+
+    _coin = _coin * 6364136223846793005u + 1442695040888963407u;
+    size_t offset = first + static_cast<size_t>(_coin >> 63);
+    for (size_t i = offset; i < level.size(); i += 2) {
+        _levels[h + 1].push_back(level[i]);
+    }
+    level.resize(first);
+    _size -= n_pairs;
+    return;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Approximate quantiles of a stream of samples in a bounded amount of memory, with
+// the KLL sketch of Karnin, Lang and Liberty.
+//
+// Samples are kept in levels, where each sample on level h stands for 2^h of the
+// originals. When the sketch is full, the lowest level over its capacity is sorted
+// and every other sample of it, starting from a random one of the first two, is
+// moved up a level; the rest are dropped. Capacities shrink by a factor of 2/3 going
+// down from the top level, so the sketch never holds more than about 3 K samples.
+// The rank of any quantile it reports is off by roughly 1.7 / K of the count.
+//
+// Two sketches can be merged, so partial results from different threads can be
+// combined. Once the levels have grown to fit the stream, adding a sample doesn't
+// allocate.
+class QuantileSketch {
+public:
+    static constexpr size_t K = 128;
+
+    void add(float x);
+
+    void merge(const QuantileSketch &other);
+
+    size_t count() const
+    {
+        return _n;
+    }
+
+    float min() const
+    {
+        return _min;
+    }
+
+    float max() const
+    {
+        return _max;
+    }
+
+    // The sample a fraction q of the stream is at or below, q on [0, 1]. Zero for
+    // an empty sketch.
+    float quantile(double q) const;
+
+private:
+    size_t _capacity(size_t level) const;
+    // Move samples up from the lowest level that is over its capacity
+    void _compact();
+    // Add levels, up to n_levels
+    void _grow(size_t n_levels);
+
+    // Samples on each level, lowest first
+    std::vector<std::vector<float>> _levels;
+    size_t _n    = 0;
+    size_t _size = 0;
+    // Sum of the capacities of the levels; the sketch is full when it holds as
+    // many samples
+    size_t _limit = 0;
+    float _min    = 0.0f;
+    float _max    = 0.0f;
+    // Picks which half of a level moves up. Deterministic, so that the same stream
+    // always gives the same sketch.
+    uint64_t _coin = 0x9e3779b97f4a7c15;
+};
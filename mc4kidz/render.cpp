@@ -0,0 +1,133 @@
+#include "render.h"
+
+#include <sstream>
+#include <string>
+
+#ifdef WIN32
+#define NOMINMAX
+#include <windows.h>
+#endif
+#include "GL/freeglut.h"
+#include "GL/gl.h"
+
+static const Color PARTICLE_DEST_COLOR{0.0f, 0.0f, 1.0f, 1.0f};
+
+static void draw_string(float x, float y, const std::string &str)
+{
+    glRasterPos2f(x, y);
+    glutBitmapString(GLUT_BITMAP_HELVETICA_18, (const unsigned char *)str.c_str());
+}
+
+void apply_view(const Ortho2D &view)
+{
+    glLoadIdentity();
+    gluOrtho2D(view.left, view.right, view.top, view.bottom);
+}
+
+void draw_shape(const Shape &shape, Color color)
+{
+    auto points = shape.outline();
+
+    glBegin(GL_TRIANGLE_FAN);
+    glColor4f(color.r, color.g, color.b, color.a);
+    for (const auto &p : points) {
+        glVertex2f(p.x, p.y);
+    }
+    glEnd();
+
+    if (shape.outline_color.has_value()) {
+        Color c = shape.outline_color.value();
+        glColor4f(c.r, c.g, c.b, c.a);
+        glBegin(GL_LINE_LOOP);
+        for (const auto &p : points) {
+            glVertex2f(p.x, p.y);
+        }
+        glEnd();
+    }
+}
+
+void draw_mesh(const Mesh &mesh)
+{
+    Color background = mesh.get_background();
+
+    glBegin(GL_QUADS);
+    glColor4f(background.r, background.g, background.b, background.a);
+    glVertex2f(0.0f, 0.0f);
+    glVertex2f(mesh.get_width(), 0.0f);
+    glVertex2f(mesh.get_width(), mesh.get_height());
+    glVertex2f(0.0f, mesh.get_height());
+    glEnd();
+
+    glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+    for (size_t i = 0; i < mesh.n_regions(); ++i) {
+        draw_shape(mesh.get_shape(i), mesh.get_color(i));
+    }
+}
+
+void draw_state(const State &state)
+{
+    glPushMatrix();
+
+    apply_view(state.view());
+
+    // Show pending edits right away, even if they haven't reached the transport
+    // yet
+    auto mesh = state.displayed_mesh();
+    draw_mesh(*mesh);
+
+    if (state.boundary_condition() != BoundaryCondition::VACUUM) {
+        draw_shape(state.boundary(), state.boundary().color);
+    }
+
+    const auto &particles = state.render_particles();
+
+    glBegin(GL_POINTS);
+    for (const auto &v : particles) {
+        glColor4f(v.color.r, v.color.g, v.color.b, v.color.a);
+        glVertex2f(v.location.x, v.location.y);
+    }
+    if (state.draw_waypoints()) {
+        glColor4f(PARTICLE_DEST_COLOR.r, PARTICLE_DEST_COLOR.g, PARTICLE_DEST_COLOR.b,
+                  PARTICLE_DEST_COLOR.a);
+        for (const auto &waypoint : state.render_waypoints()) {
+            glVertex2f(waypoint.x, waypoint.y);
+        }
+    }
+    glEnd();
+
+    if (state.draw_labels()) {
+        glColor3f(1.0f, 1.0f, 1.0f);
+        for (size_t id = 0; id < particles.size(); ++id) {
+            draw_string(particles[id].location.x, particles[id].location.y,
+                        std::to_string(id));
+        }
+    }
+
+    // Print statistics, etc
+    glColor3f(1.0f, 1.0f, 1.0f);
+    std::stringstream sstream;
+    sstream << "Neutron population: " << particles.size();
+    draw_string(1.0f, 1.0f, sstream.str());
+
+    sstream.str("");
+    sstream << "Mean dist. to collision: " << mesh->mean_distance_to_collision();
+    draw_string(1.0f, 1.5f, sstream.str());
+
+    sstream.str("");
+    sstream << "Time step: " << state.time_step();
+    draw_string(1.0f, 2.0f, sstream.str());
+
+    if (state.tracks_generations()) {
+        const auto &born       = state.generation_born();
+        const auto &population = state.generation_population();
+        for (size_t gen = 0; gen < born.size(); ++gen) {
+            sstream.str("");
+            sstream << "Generation " << state.first_generation() + gen << ": "
+                    << born[gen] << " (" << population[gen] << ")";
+            draw_string(mesh->get_width() + 0.2f,
+                        mesh->get_height() - 0.5f - 0.5f * gen, sstream.str());
+        }
+    }
+
+    glPopMatrix();
+}
@@ -0,0 +1,20 @@
+#pragma once
+// Drawing of the simulation with OpenGL. All of the GL calls for the simulation
+// itself live behind this header, so that the simulation builds and runs
+// without GL.
+
+#include "mesh.h"
+#include "shapes.h"
+#include "simple_structs.h"
+#include "state.h"
+#include "view.h"
+
+// Load an orthographic projection into the current matrix
+void apply_view(const Ortho2D &view);
+
+void draw_shape(const Shape &shape, Color color);
+
+void draw_mesh(const Mesh &mesh);
+
+// Draw the mesh, particles and statistics of a State, using its view
+void draw_state(const State &state);
@@ -0,0 +1,67 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+
+// Mean and variance of a stream of samples, kept up to date one sample at a time
+// with Welford's algorithm. Two of them can be merged, so partial results from
+// different threads can be combined.
+class RunningStat {
+public:
+    void add(double x)
+    {
+        _n++;
+        double delta = x - _mean;
+        _mean += delta / _n;
+        _m2 += delta * (x - _mean);
+    }
+
+    void merge(const RunningStat &other)
+    {
+        if (other._n == 0) {
+            return;
+        }
+        size_t n     = _n + other._n;
+        double delta = other._mean - _mean;
+        _mean += delta * other._n / n;
+        _m2 += other._m2 + delta * delta * _n * other._n / n;
+        _n = n;
+    }
+
+    size_t count() const
+    {
+        return _n;
+    }
+
+    double mean() const
+    {
+        return _mean;
+    }
+
+    // Sample variance
+    double variance() const
+    {
+        return _n > 1 ? _m2 / (_n - 1) : 0.0;
+    }
+
+    double std_dev() const
+    {
+        return std::sqrt(variance());
+    }
+
+    // Standard error of the mean
+    double std_error() const
+    {
+        return _n > 0 ? std::sqrt(variance() / _n) : 0.0;
+    }
+
+    // Half-width of an approximate 95% confidence interval on the mean
+    double ci95() const
+    {
+        return 1.96 * std_error();
+    }
+
+private:
+    size_t _n    = 0;
+    double _mean = 0.0;
+    double _m2   = 0.0;
+};
@@ -1,12 +1,5 @@
 #include "shapes.h"
 
-#ifdef WIN32
-#define NOMINMAX
-#include <windows.h>
-#endif
-#include "GL/gl.h"
-#include "GL/glut.h"
-
 #include <array>
 #include <cmath>
 #include <limits>
@@ -23,16 +16,18 @@ Circle::Circle(Color c, Vec2 center, float r) : Shape(c), center(center), r(r)
 
 // Circle::Circle(Color c, Vec2 center, float r, int segments)
 
-void Circle::draw() const
+std::vector<Vec2> Circle::outline() const
 {
-    glBegin(GL_TRIANGLE_FAN);
-    glColor4f(color.r, color.g, color.b, color.a);
+    std::vector<Vec2> points;
+    points.reserve(segments);
     for (unsigned int i = 0; i < segments; ++i) {
         float angle = (float)i * 2.0f * M_PI / (float)segments;
-        glVertex2f(r * cos(angle) + center.x, r * sin(angle) + center.y);
+        points.push_back(
+            Vec2{r * std::cos(angle) + center.x, r * std::sin(angle) + center.y});
     }
-    glEnd();
+    return points;
 }
+
 float Circle::distance_to_surface(Vec2 p, Vec2 dir, bool coincident) const
 {
     std::numeric_limits<float> lim;
@@ -65,26 +60,10 @@ float Circle::distance_to_surface(Vec2 p, Vec2 dir, bool coincident) const
     }
 }
 
-void Box::draw() const
+std::vector<Vec2> Box::outline() const
 {
-    glBegin(GL_QUADS);
-    glColor4f(color.r, color.g, color.b, color.a);
-    glVertex2f(_min_x, _min_y);
-    glVertex2f(_max_x, _min_y);
-    glVertex2f(_max_x, _max_y);
-    glVertex2f(_min_x, _max_y);
-    glEnd();
-
-    if (outline_color.has_value()) {
-        Color c = outline_color.value();
-        glColor4f(c.r, c.g, c.b, c.a);
-        glBegin(GL_LINE_LOOP);
-        glVertex2f(_min_x, _min_y);
-        glVertex2f(_max_x, _min_y);
-        glVertex2f(_max_x, _max_y);
-        glVertex2f(_min_x, _max_y);
-        glEnd();
-    }
+    return {Vec2{_min_x, _min_y}, Vec2{_max_x, _min_y}, Vec2{_max_x, _max_y},
+            Vec2{_min_x, _max_y}};
 }
 
 bool Box::point_inside(Vec2 p) const
@@ -1,6 +1,9 @@
 #pragma once
+#include <algorithm>
 #include <array>
+#include <limits>
 #include <optional>
+#include <vector>
 
 #include "simple_structs.h"
 
@@ -9,7 +12,13 @@ public:
     Shape(Color c) : color(c)
     {
     }
-    virtual void draw() const = 0;
+
+    // Vertices of a convex polygon approximating the shape, for drawing. Shapes
+    // in a Mesh are shared between mesh versions, so the color to draw them
+    // with lives in the Mesh instead.
+    virtual std::vector<Vec2> outline() const = 0;
+    // A point in the middle of the shape, used to pick out shapes by location
+    virtual Vec2 centroid() const = 0;
     virtual float distance_to_surface(Vec2 p, Vec2 dir, bool coincident) const = 0;
     virtual bool point_inside(Vec2 p) const = 0;
     // virtual std::array<std::optional<Vec2>, 2> line_intersect(Vec2 p1, Vec2 p2)
@@ -21,7 +30,12 @@ public:
 class Circle : public Shape {
 public:
     Circle(Color c, Vec2 center, float r);
-    void draw() const;
+    std::vector<Vec2> outline() const;
+
+    Vec2 centroid() const
+    {
+        return center;
+    }
 
     float distance_to_surface(Vec2 p, Vec2 dir, bool coincident) const;
     // virtual std::array<std::optional<Vec2>, 2> line_intersect(Vec2 p1, Vec2 p2)
@@ -57,7 +71,12 @@ public:
         return std::numeric_limits<float>::max();
     }
 
-    void draw() const;
+    std::vector<Vec2> outline() const;
+
+    Vec2 centroid() const
+    {
+        return Vec2{0.5f * (_min_x + _max_x), 0.5f * (_min_y + _max_y)};
+    }
 
 private:
     float _min_x;
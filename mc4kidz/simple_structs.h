@@ -113,3 +113,14 @@ struct Color {
     float b;
     float a;
 };
+
+// Axis-aligned rectangle, including its low edges but not its high edges
+struct Rect {
+    Vec2 lo;
+    Vec2 hi;
+
+    bool contains(Vec2 p) const
+    {
+        return p.x >= lo.x && p.x < hi.x && p.y >= lo.y && p.y < hi.y;
+    }
+};
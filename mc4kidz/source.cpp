@@ -0,0 +1,253 @@
+#include "source.h"
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+#ifdef MC4KIDZ_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+Source Source::point(Vec2 location)
+{
+    Source source(Shape::POINT);
+    source._center = location;
+    return source;
+}
+
+Source Source::box(Rect rect)
+{
+    Source source(Shape::BOX);
+    source._rect = rect;
+    return source;
+}
+
+Source Source::disc(Vec2 center, float radius)
+{
+    Source source(Shape::DISC);
+    source._center = center;
+    source._radius = radius;
+    return source;
+}
+
+Source Source::sites(std::vector<SourceSite> sites)
+{
+    Source source(Shape::SITES);
+    source._sites = std::make_shared<const Sites>(std::move(sites));
+    return source;
+}
+
+Source Source::from_file(const std::string &fname)
+{
+    Source source(Shape::SITES);
+    source._sites = std::make_shared<const Sites>(fname);
+    return source;
+}
+
+void Source::save_sites(const std::string &fname, const std::vector<SourceSite> &sites)
+{
+    std::ofstream out(fname, std::ios::binary);
+    out.write(reinterpret_cast<const char *>(sites.data()),
+              sites.size() * sizeof(SourceSite));
+    if (!out.good()) {
+        std::stringstream msg;
+        msg << "Failed to write source file: " << fname;
+        throw msg.str();
+    }
+}
+
+void Source::set_group_weights(const std::vector<float> &weights)
+{
+    if (weights.size() > N_GROUPS) {
+        throw std::string("More group weights than there are groups");
+    }
+
+    _group_cdf.assign(N_GROUPS, 0.0f);
+    float total = 0.0f;
+    for (int g = 0; g < N_GROUPS; ++g) {
+        float w = g < static_cast<int>(weights.size()) ? weights[g] : 0.0f;
+        if (!(w >= 0.0f) || !std::isfinite(w)) {
+            throw std::string("Group weights must be finite and not negative");
+        }
+        total += w;
+        _group_cdf[g] = total;
+    }
+    if (total <= 0.0f) {
+        throw std::string("At least one group needs a positive weight");
+    }
+}
+
+void Source::sample(const float *u, Vec2 &location, int &e_group) const
+{
+    switch (_shape) {
+    case Shape::POINT:
+        location = _center;
+        break;
+    case Shape::BOX:
+        location = Vec2{_rect.lo.x + u[0] * (_rect.hi.x - _rect.lo.x),
+                        _rect.lo.y + u[1] * (_rect.hi.y - _rect.lo.y)};
+        break;
+    case Shape::DISC: {
+        float r     = _radius * std::sqrt(u[0]);
+        float angle = 2.0f * 3.14159265f * u[1];
+        location =
+            Vec2{_center.x + r * std::cos(angle), _center.y + r * std::sin(angle)};
+        break;
+    }
+    case Shape::SITES: {
+        const SourceSite &site = _sites->site(_sites->pick(u[0], u[1]));
+        location               = Vec2{site.x, site.y};
+        e_group                = site.e_group;
+        return;
+    }
+    }
+    e_group = _sample_group(u[2]);
+}
+
+size_t Source::n_sites() const
+{
+    return _sites ? _sites->size() : 0;
+}
+
+Source::Sites::Sites(std::vector<SourceSite> sites) : _owned(std::move(sites))
+{
+    _data = _owned.data();
+    _size = _owned.size();
+    _build_alias_table();
+    return;
+}
+
+Source::Sites::Sites(const std::string &fname)
+{
+    auto fail = [&fname](const std::string &what) {
+        std::stringstream msg;
+        msg << "Failed to read source file " << fname << ": " << what;
+        throw msg.str();
+    };
+
+#ifdef MC4KIDZ_MMAP
+    int fd = open(fname.c_str(), O_RDONLY);
+    if (fd < 0) {
+        fail("can't open it");
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        fail("can't get its size");
+    }
+    _mapping_size = static_cast<size_t>(info.st_size);
+    if (_mapping_size % sizeof(SourceSite) != 0) {
+        close(fd);
+        fail("size isn't a whole number of sites");
+    }
+    if (_mapping_size > 0) {
+        _mapping = mmap(nullptr, _mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (_mapping == MAP_FAILED) {
+        _mapping = nullptr;
+        fail("can't map it");
+    }
+    _data = static_cast<const SourceSite *>(_mapping);
+    _size = _mapping_size / sizeof(SourceSite);
+
+    // The destructor won't run if this throws
+    try {
+        _build_alias_table();
+    } catch (...) {
+        if (_mapping) {
+            munmap(_mapping, _mapping_size);
+        }
+        throw;
+    }
+#else
+    std::ifstream in(fname, std::ios::binary | std::ios::ate);
+    if (!in.good()) {
+        fail("can't open it");
+    }
+    size_t n_bytes = static_cast<size_t>(in.tellg());
+    if (n_bytes % sizeof(SourceSite) != 0) {
+        fail("size isn't a whole number of sites");
+    }
+    _owned.resize(n_bytes / sizeof(SourceSite));
+    in.seekg(0);
+    in.read(reinterpret_cast<char *>(_owned.data()), n_bytes);
+    _data = _owned.data();
+    _size = _owned.size();
+    _build_alias_table();
+#endif
+    return;
+}
+
+Source::Sites::~Sites()
+{
+#ifdef MC4KIDZ_MMAP
+    if (_mapping) {
+        munmap(_mapping, _mapping_size);
+    }
+#endif
+    return;
+}
+
+void Source::Sites::_build_alias_table()
+{
+    if (_size == 0) {
+        throw std::string("A source needs at least one site");
+    }
+    if (_size > UINT32_MAX) {
+        throw std::string("Too many source sites");
+    }
+
+    double total = 0.0;
+    for (size_t i = 0; i < _size; ++i) {
+        const SourceSite &s = _data[i];
+        if (!(s.weight >= 0.0f) || !std::isfinite(s.weight) || !std::isfinite(s.x) ||
+            !std::isfinite(s.y)) {
+            throw std::string("Source sites need finite locations and weights that "
+                              "aren't negative");
+        }
+        if (s.e_group < 0 || s.e_group >= N_GROUPS) {
+            throw std::string("Source site energy group out of range");
+        }
+        total += s.weight;
+    }
+    if (total <= 0.0) {
+        throw std::string("At least one source site needs a positive weight");
+    }
+
+    // Vose's method: split the sites into those with more and less than the
+    // average weight, then top up each small one from a large one
+    _probability.resize(_size);
+    _alias.resize(_size);
+    std::vector<double> scaled(_size);
+    std::vector<uint32_t> small;
+    std::vector<uint32_t> large;
+    for (size_t i = 0; i < _size; ++i) {
+        scaled[i] = _data[i].weight * _size / total;
+        (scaled[i] < 1.0 ? small : large).push_back(static_cast<uint32_t>(i));
+    }
+    while (!small.empty() && !large.empty()) {
+        uint32_t s = small.back();
+        uint32_t l = large.back();
+        small.pop_back();
+        _probability[s] = static_cast<float>(scaled[s]);
+        _alias[s]       = l;
+        scaled[l] -= 1.0 - scaled[s];
+        if (scaled[l] < 1.0) {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+    // Whatever is left is only off from 1 by rounding
+    for (uint32_t i : large) {
+        _probability[i] = 1.0f;
+        _alias[i]       = i;
+    }
+    for (uint32_t i : small) {
+        _probability[i] = 1.0f;
+        _alias[i]       = i;
+    }
+}
@@ -0,0 +1,176 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "simple_structs.h"
+
+// One starting point in a source file. Site files are nothing but an array of
+// these, in the byte order of the machine that reads them.
+struct SourceSite {
+    float x;
+    float y;
+    int32_t e_group;
+    float weight;
+};
+static_assert(sizeof(SourceSite) == 16, "site files depend on the layout of sites");
+
+// Where, and in which energy group, new particles start.
+//
+// A source is either a spatial distribution (a point, a box or a disc) with an
+// energy distribution over the groups, or a set of sites, each with its own
+// group, picked with probability proportional to their weights. Sources are
+// cheap to copy; copies share the sites.
+class Source {
+public:
+    static constexpr int N_GROUPS      = 7;
+    // Group of particles from sources without an energy distribution, which is
+    // the group particles added by hand have always started in
+    static constexpr int DEFAULT_GROUP = 6;
+    // Uniform numbers taken by sampling from them rather than from an engine
+    static constexpr int N_SAMPLE_DIMENSIONS = 3;
+
+    static Source point(Vec2 location);
+    // Uniform over a rectangle
+    static Source box(Rect rect);
+    // Uniform over a disc
+    static Source disc(Vec2 center, float radius);
+    static Source sites(std::vector<SourceSite> sites);
+    // Read sites from a file, mapping it into memory where possible
+    static Source from_file(const std::string &fname);
+
+    // Write sites to a file that from_file() can read
+    static void save_sites(const std::string &fname,
+                           const std::vector<SourceSite> &sites);
+
+    // Relative probability of starting in each group. Sources made of sites use
+    // the groups of their sites instead.
+    void set_group_weights(const std::vector<float> &weights);
+
+    size_t n_sites() const;
+
+    // Draw a starting location and energy group
+    void sample(std::default_random_engine &random, Vec2 &location, int &e_group) const
+    {
+        std::uniform_real_distribution<float> unit;
+        switch (_shape) {
+        case Shape::POINT:
+            location = _center;
+            break;
+        case Shape::BOX:
+            location = Vec2{_rect.lo.x + unit(random) * (_rect.hi.x - _rect.lo.x),
+                            _rect.lo.y + unit(random) * (_rect.hi.y - _rect.lo.y)};
+            break;
+        case Shape::DISC: {
+            // Uniform in area, so the radius goes as the square root
+            float r     = _radius * std::sqrt(unit(random));
+            float angle = 2.0f * 3.14159265f * unit(random);
+            location =
+                Vec2{_center.x + r * std::cos(angle), _center.y + r * std::sin(angle)};
+            break;
+        }
+        case Shape::SITES: {
+            const SourceSite &site = _sites->site(_sites->pick(random));
+            location               = Vec2{site.x, site.y};
+            e_group                = site.e_group;
+            return;
+        }
+        }
+        e_group = _sample_group(random);
+    }
+
+    // Draw a starting location and energy group from uniform numbers on [0, 1),
+    // such as quasi-random points: the first two pick the location and the last
+    // one the group
+    void sample(const float *u, Vec2 &location, int &e_group) const;
+
+private:
+    enum class Shape : uint8_t { POINT, BOX, DISC, SITES };
+
+    // Sites, either read into memory or mapped from a file, with an alias table
+    // for picking them by weight in constant time
+    class Sites {
+    public:
+        Sites(std::vector<SourceSite> sites);
+        Sites(const std::string &fname);
+        ~Sites();
+
+        Sites(const Sites &) = delete;
+        Sites &operator=(const Sites &) = delete;
+
+        size_t size() const
+        {
+            return _size;
+        }
+
+        const SourceSite &site(size_t i) const
+        {
+            return _data[i];
+        }
+
+        size_t pick(std::default_random_engine &random) const
+        {
+            std::uniform_int_distribution<size_t> index(0, _size - 1);
+            std::uniform_real_distribution<float> unit;
+            size_t i = index(random);
+            return unit(random) < _probability[i] ? i : _alias[i];
+        }
+
+        size_t pick(float u_index, float u_alias) const
+        {
+            size_t i = std::min(_size - 1, static_cast<size_t>(u_index * _size));
+            return u_alias < _probability[i] ? i : _alias[i];
+        }
+
+    private:
+        void _build_alias_table();
+
+        const SourceSite *_data = nullptr;
+        size_t _size            = 0;
+        std::vector<SourceSite> _owned;
+        void *_mapping       = nullptr;
+        size_t _mapping_size = 0;
+
+        std::vector<float> _probability;
+        std::vector<uint32_t> _alias;
+    };
+
+    Source(Shape shape) : _shape(shape)
+    {
+        return;
+    }
+
+    int _sample_group(std::default_random_engine &random) const
+    {
+        if (_group_cdf.empty()) {
+            return DEFAULT_GROUP;
+        }
+        std::uniform_real_distribution<float> unit;
+        return _sample_group(unit(random));
+    }
+
+    int _sample_group(float u) const
+    {
+        if (_group_cdf.empty()) {
+            return DEFAULT_GROUP;
+        }
+        u     = u * _group_cdf.back();
+        int g = 0;
+        while (g < N_GROUPS - 1 && u >= _group_cdf[g]) {
+            ++g;
+        }
+        return g;
+    }
+
+    Shape _shape;
+    Vec2 _center{0.0f, 0.0f};
+    Rect _rect{};
+    float _radius = 0.0f;
+    // Running total of the group weights
+    std::vector<float> _group_cdf;
+    std::shared_ptr<const Sites> _sites;
+};
@@ -1,17 +1,12 @@
 #include "state.h"
 
+#include <algorithm>
+#include <iterator>
 #include <memory>
-#include <sstream>
+#include <numeric>
 #include <tuple>
 #include <unordered_map>
 
-#ifdef WIN32
-#define NOMINMAX
-#include <windows.h>
-#endif
-#include "GL/freeglut.h"
-#include "GL/gl.h"
-
 #include "materials.h"
 #include "pin_types.h"
 #include "shapes.h"
@@ -32,42 +27,34 @@ std::vector<Color> make_particle_colors()
     return colors;
 }
 
-State::State()
+State::State() : State(std::make_shared<const MaterialLibrary>(C5G7()))
+{
+    return;
+}
+
+State::State(std::shared_ptr<const MaterialLibrary> materials,
+             std::shared_ptr<const Mesh> mesh)
     : _particle_colors(make_particle_colors()),
-      _materials(C5G7()),
-      _mesh(NPINS_X * PIN_PITCH, NPINS_Y * PIN_PITCH,
-            &_materials.get_by_name("Moderator"), MODERATOR_COLOR),
+      _materials(std::move(materials)),
+      _mesh(mesh ? std::move(mesh) : make_lattice(*_materials)),
       _boundary(Color{0.0f, 0.0f, 0.0f, 0.0f}, Vec2{0.0f, 0.0f},
-                Vec2{_mesh.get_width(), _mesh.get_height()}),
+                Vec2{_mesh->get_width(), _mesh->get_height()}),
       _angle_distribution(0, 6.28318530718f)
 {
     Color gray{0.3f, 0.3f, 0.3f, 1.0f};
-    Color fuel{0.4f, 0.0f, 0.0f, 1.0f};
     Color white{1.0f, 1.0f, 1.0f, 1.0f};
     Color black{0.0f, 0.0f, 0.0f, 1.0f};
 
-    _pin_types[PinType::FUEL] = std::make_tuple(fuel, &_materials.get_by_name("UO2"));
+    _pin_types[PinType::FUEL] =
+        std::make_tuple(FUEL_COLOR, &_materials->get_by_name("UO2"));
     _pin_types[PinType::MODERATOR] =
-        std::make_tuple(MODERATOR_COLOR, &_materials.get_by_name("Moderator"));
+        std::make_tuple(MODERATOR_COLOR, &_materials->get_by_name("Moderator"));
     _pin_types[PinType::BLACK] =
-        std::make_tuple(gray, &_materials.get_by_name("Control2"));
-    _pin_types[PinType::VOID] = std::make_tuple(black, &_materials.get_by_name("Void"));
+        std::make_tuple(gray, &_materials->get_by_name("Control2"));
+    _pin_types[PinType::VOID] = std::make_tuple(black, &_materials->get_by_name("Void"));
 
     _boundary.outline_color = white;
 
-    for (int ix = 0; ix < NPINS_X; ++ix) {
-        for (int iy = 0; iy < NPINS_Y; ++iy) {
-            const Material *mat = (ix == iy) ? &_materials.get_by_name("UO2")
-                                             : &_materials.get_by_name("UO2");
-            auto color = ix == iy ? fuel : fuel;
-            _mesh.add_shape(
-                std::make_unique<Circle>(color, Vec2{0.5f * PIN_PITCH + ix * PIN_PITCH,
-                                                     0.5f * PIN_PITCH + iy * PIN_PITCH},
-                                         PIN_RADIUS),
-                mat);
-        }
-    }
-
     // Some reasonable amount of particles to start
     _particles.reserve(1'500);
 
@@ -76,27 +63,70 @@ State::State()
     return;
 }
 
+ThreadPool *State::_thread_pool()
+{
+    // The default pool is only started once there is work for it, so that States
+    // that are given a pool of their own, or none, never start threads at all
+    if (!_pool_chosen) {
+        _pool        = std::make_shared<ThreadPool>();
+        _pool_chosen = true;
+    }
+    return _pool.get();
+}
+
+std::shared_ptr<const Mesh> State::make_lattice(const MaterialLibrary &materials)
+{
+    auto mesh = std::make_shared<Mesh>(NPINS_X * PIN_PITCH, NPINS_Y * PIN_PITCH,
+                                       &materials.get_by_name("Moderator"),
+                                       MODERATOR_COLOR);
+    mesh->set_lattice(Mesh::Lattice{Vec2{0.0f, 0.0f}, NPINS_X, NPINS_Y, PIN_PITCH});
+    for (int ix = 0; ix < NPINS_X; ++ix) {
+        for (int iy = 0; iy < NPINS_Y; ++iy) {
+            mesh->add_shape(
+                std::make_unique<Circle>(FUEL_COLOR,
+                                         Vec2{0.5f * PIN_PITCH + ix * PIN_PITCH,
+                                              0.5f * PIN_PITCH + iy * PIN_PITCH},
+                                         PIN_RADIUS),
+                &materials.get_by_name("UO2"));
+        }
+    }
+    return mesh;
+}
+
 void State::reset(bool hard)
 {
     _particles.clear();
-    _process_queue.clear();
+    _fission_bank.clear();
+    _held_sites.clear();
+    _next_id = _first_id;
     _generation_born.clear();
     _generation_population.clear();
-    _population_history.clear();
-    _population_history.reserve(MAX_POP_HIST);
-    _history_resolution = 1;
-    _time_step          = 0;
+    _first_generation  = 0;
+    _born_from_fission = 0.0;
+    _retired_born.clear();
+    for (auto &history : _histories) {
+        history.clear();
+    }
+    _time_step = 0;
 
     _n_capture = 0;
     _n_fission = 0;
     _n_scatter = 0;
     _n_leak    = 0;
+    _n_born    = 0;
+    _recorded_counts.fill(0.0);
+    _injected_draws = 0;
+    _source_draws   = 0;
+    _spectrum.fill(0.0);
 
     _generation_born.push_back(0);
     _generation_population.push_back(0);
 
     if (hard) {
         _since_last_command = 0;
+        _elapsed            = 0;
+        _keyframes.clear();
+        _keyframe_interval = KEYFRAME_INTERVAL;
 
         if (_playbook) {
             _playbook->reset();
@@ -105,6 +135,8 @@ void State::reset(bool hard)
             _next_command = std::numeric_limits<size_t>::max();
         }
     }
+
+    _summarize();
 }
 
 void State::tic(bool force)
@@ -113,6 +145,33 @@ void State::tic(bool force)
         return;
     }
 
+    _step();
+
+    if (force) {
+        // Stepping by hand, so show the outcome of this step right away
+        _summarize();
+    }
+
+    assert(!_track_generations ||
+           population() == std::accumulate(_generation_population.begin(),
+                                           _generation_population.end(), 0u));
+#ifndef NDEBUG
+    // The spectrum is kept up to date piece by piece, but should add up to the
+    // weight of the population all the same
+    double weight = 0.0;
+    for (const auto &p : _particles) {
+        weight += p.weight * _mesh->multiplicity();
+    }
+    assert(std::abs(total_weight() - weight) <= 1e-6 * std::max(1.0, weight));
+#endif
+}
+
+void State::_step()
+{
+    if (_keyframing && _elapsed % _keyframe_interval == 0) {
+        _save_keyframe();
+    }
+
     if (_since_last_command == _next_command) {
         _since_last_command = 0;
         if (_playbook) {
@@ -122,207 +181,1007 @@ void State::tic(bool force)
         }
     }
 
+    _commit_mesh();
+
     _time_step++;
     _since_last_command++;
 
     if (_source) {
-        Vec2 location = _source.value();
+        _add_particles(Source::point(_source.value()), 1, _source_draws);
+    }
 
-        Particle p = _new_particle(location);
-        _generation_born[0]++;
-        _generation_population[0]++;
-        _mesh.transport_particle(p, _random);
-        _particles.push_back(p);
+    size_t n_chunks = (_particles.size() + TIC_CHUNK_SIZE - 1) / TIC_CHUNK_SIZE;
+    if (_chunks.size() < n_chunks) {
+        _chunks.resize(n_chunks);
+    }
+    _fission_bank.resize(n_chunks);
+    for (size_t i_chunk = 0; i_chunk < n_chunks; ++i_chunk) {
+        _chunks[i_chunk].bank = &_fission_bank.sub_bank(i_chunk);
     }
 
-    _process_queue.clear();
-    size_t id = 0;
-    for (auto &p : _particles) {
-        bool process = p.tic(1.0f);
+    AdvanceKernel kernel = _select_kernel();
+    auto advance         = [this, kernel](size_t i_chunk) {
+        std::seed_seq seed{_seed, _time_step, static_cast<unsigned int>(i_chunk)};
+        std::default_random_engine random(seed);
+        size_t begin = i_chunk * TIC_CHUNK_SIZE;
+        size_t end   = std::min(begin + TIC_CHUNK_SIZE, _particles.size());
+        (this->*kernel)(begin, end, _chunks[i_chunk], random);
+    };
+
+    // The waypoints to draw are taken away with the particles as they are
+    // advanced, so they have to be gathered up first
+    ThreadPool *pool = _thread_pool();
+    bool overlap     = pool && !_headless && !_draw_waypoints;
+    if (!overlap && !_headless) {
+        _summarize();
+    }
+    if (overlap) {
+        // Get the incoming population ready to draw while it is being advanced.
+        // This is one more piece of the same loop, rather than a task of its own,
+        // so that a State run from inside one of the pool's tasks never waits on
+        // a task that no worker is free to pick up.
+        pool->parallel_for(n_chunks + 1, [this, &advance](size_t i) {
+            if (i == 0) {
+                _summarize();
+            } else {
+                advance(i - 1);
+            }
+        });
+    } else if (pool) {
+        pool->parallel_for(n_chunks, advance);
+    } else {
+        for (size_t i_chunk = 0; i_chunk < n_chunks; ++i_chunk) {
+            advance(i_chunk);
+        }
+    }
+
+    _merge_chunks(n_chunks);
+    _apply_weight_windows();
+    _control_population();
+    if (_track_generations) {
+        _retire_generations();
+    }
+    // Only now is everything that happened in the tic counted, fission daughters
+    // included
+    _record_history();
+    _elapsed++;
+}
+
+void State::seek(unsigned int elapsed)
+{
+    set_keyframes(true);
+
+    if (elapsed < _elapsed) {
+        auto after = std::upper_bound(
+            _keyframes.begin(), _keyframes.end(), elapsed,
+            [](unsigned int e, const Keyframe &keyframe) { return e < keyframe.elapsed; });
+        if (after != _keyframes.begin()) {
+            _restore_keyframe(*(after - 1));
+        } else {
+            // Keyframes were turned on after the point to go back to, so start over
+            // and run up to it again, which comes out the same for the same seed
+            reset(true);
+            _random.seed(_seed);
+            set_keyframes(true);
+        }
+    }
+
+    if (elapsed > _elapsed) {
+        advance(elapsed - _elapsed);
+    }
+    _summarize();
+}
+
+void State::set_keyframes(bool keyframes)
+{
+    if (keyframes && !_keyframing) {
+        _keyframing = true;
+        _save_keyframe();
+    } else if (!keyframes) {
+        _keyframing = false;
+        _keyframes.clear();
+        _keyframe_interval = KEYFRAME_INTERVAL;
+    }
+}
+
+void State::advance(unsigned int n_tics)
+{
+    _headless = true;
+    for (unsigned int i = 0; i < n_tics; ++i) {
+        _step();
+    }
+    _headless = false;
+}
+
+void State::_save_keyframe()
+{
+    // Anything saved past this point belongs to a different history now
+    while (!_keyframes.empty() && _keyframes.back().elapsed >= _elapsed) {
+        _keyframes.pop_back();
+    }
+
+    Keyframe keyframe{_elapsed,
+                      _time_step,
+                      _particles,
+                      _next_id,
+                      _generation_born,
+                      _generation_population,
+                      _first_generation,
+                      _retired_born,
+                      _born_from_fission,
+                      _histories,
+                      _since_last_command,
+                      _next_command,
+                      _playbook ? _playbook->cursor() : 0,
+                      _mesh,
+                      nullptr,
+                      false,
+                      _bc,
+                      _random,
+                      _source,
+                      _injected_draws,
+                      _source_draws,
+                      _held_sites,
+                      _current_pin_type,
+                      _n_capture,
+                      _n_fission,
+                      _n_scatter,
+                      _n_leak,
+                      _n_born,
+                      _spectrum};
+    for (auto &p : keyframe.particles) {
+        p.waypoints.clear();
+        p.waypoints.shrink_to_fit();
+    }
+    {
+        std::lock_guard<std::mutex> lock(_edit_mutex);
+        keyframe.next_mesh        = _next_mesh;
+        keyframe.resample_pending = _resample_pending;
+    }
+    _keyframes.push_back(std::move(keyframe));
+
+    if (_keyframes.size() > MAX_KEYFRAMES) {
+        for (size_t i = 0; i < _keyframes.size() / 2; ++i) {
+            _keyframes[i] = std::move(_keyframes[i * 2]);
+        }
+        _keyframes.resize((_keyframes.size() + 1) / 2);
+        _keyframe_interval *= 2;
+    }
+}
+
+void State::_restore_keyframe(const Keyframe &keyframe)
+{
+    _elapsed               = keyframe.elapsed;
+    _time_step             = keyframe.time_step;
+    _particles             = keyframe.particles;
+    _next_id               = keyframe.next_id;
+    _generation_born       = keyframe.generation_born;
+    _generation_population = keyframe.generation_population;
+    _first_generation      = keyframe.first_generation;
+    _retired_born          = keyframe.retired_born;
+    _born_from_fission     = keyframe.born_from_fission;
+    _histories             = keyframe.histories;
+    _since_last_command    = keyframe.since_last_command;
+    _next_command          = keyframe.next_command;
+    if (_playbook) {
+        _playbook->set_cursor(keyframe.playbook_cursor);
+    }
+    std::atomic_store(&_mesh, keyframe.mesh);
+    {
+        std::lock_guard<std::mutex> lock(_edit_mutex);
+        _next_mesh        = keyframe.next_mesh;
+        _resample_pending = keyframe.resample_pending;
+    }
+    _bc               = keyframe.bc;
+    _random           = keyframe.random;
+    _source           = keyframe.source;
+    _injected_draws   = keyframe.injected_draws;
+    _source_draws     = keyframe.source_draws;
+    _held_sites       = keyframe.held_sites;
+    _current_pin_type = keyframe.current_pin_type;
+    _n_capture        = keyframe.n_capture;
+    _n_fission        = keyframe.n_fission;
+    _n_scatter        = keyframe.n_scatter;
+    _n_leak           = keyframe.n_leak;
+    _n_born           = keyframe.n_born;
+    _recorded_counts  = {_n_scatter, _n_capture, _n_fission, _n_leak, _n_born};
+    _spectrum         = keyframe.spectrum;
+    _fission_bank.clear();
+}
+
+void State::add_particles(const Source &source, size_t n)
+{
+    _add_particles(source, n, _injected_draws);
+}
+
+void State::_add_particles(const Source &source, size_t n, uint64_t &draws)
+{
+    // Round the sector's share up or down at random, so that it comes out right
+    // on average
+    const Mesh &mesh = *_mesh;
+    unsigned int m   = mesh.multiplicity();
+    std::uniform_real_distribution<float> unit_distribution;
+    size_t n_sector = n / m;
+    if (n % m != 0 && unit_distribution(_random) * m < n % m) {
+        n_sector++;
+    }
+    if (n_sector == 0) {
+        return;
+    }
+
+    // Grow the population in one step, but never by less than it would grow
+    // by itself, so that adding a few at a time doesn't reallocate every time
+    if (_particles.capacity() < _particles.size() + n_sector) {
+        _particles.reserve(
+            std::max(_particles.size() + n_sector, 2 * _particles.capacity()));
+    }
+
+    // Every batch gets its own ids, so they also make the random numbers of
+    // batches added during the same tic different
+    uint64_t first_id    = _next_id;
+    uint64_t first_point = draws;
+    _next_id += n_sector;
+    draws += n_sector;
+    size_t before = _particles.size();
+    _spawn_from_source(source, n_sector, first_id, first_point);
+
+    if (_track_generations) {
+        size_t added = _particles.size() - before;
+        size_t first = _generation_index(0);
+        _generation_born[first] += static_cast<unsigned int>(added * m);
+        _generation_population[first] += static_cast<unsigned int>(added * m);
+    }
+}
+
+void State::_spawn_from_source(const Source &source, size_t n, uint64_t first_id,
+                               uint64_t first_point)
+{
+    size_t n_blocks = (n + TIC_CHUNK_SIZE - 1) / TIC_CHUNK_SIZE;
+    if (_daughter_blocks.size() < n_blocks) {
+        _daughter_blocks.resize(n_blocks);
+    }
+
+    const Mesh &mesh = *_mesh;
+    auto spawn       = [&](size_t i_block) {
+        std::seed_seq seed{_seed,
+                           _time_step,
+                           static_cast<unsigned int>(i_block),
+                           2u,
+                           static_cast<unsigned int>(first_id),
+                           static_cast<unsigned int>(first_id >> 32)};
+        std::default_random_engine random(seed);
+        size_t begin = i_block * TIC_CHUNK_SIZE;
+        size_t end   = std::min(begin + TIC_CHUNK_SIZE, n);
+
+        auto &block = _daughter_blocks[i_block];
+        block.clear();
+        // Quasi-random numbers for each particle, if they are used
+        float u[N_QMC_DIMENSIONS] = {};
+        for (size_t i = begin; i < end; ++i) {
+            Vec2 location;
+            int e_group;
+            if (_halton) {
+                for (int d = 0; d < N_QMC_DIMENSIONS; ++d) {
+                    u[d] = _halton->sample(static_cast<uint32_t>(first_point + i), d);
+                }
+                source.sample(u, location, e_group);
+            } else {
+                source.sample(random, location, e_group);
+            }
+            if (!_boundary.point_inside(location) ||
+                (_subdomain && !_subdomain->contains(location))) {
+                continue;
+            }
+
+            auto angles = _angle_distribution.param();
+            float angle = angles.a() + u[QMC_ANGLE] * (angles.b() - angles.a());
+            Particle p  = _halton ? _new_particle(location, angle)
+                                  : _new_particle(location, random);
+            p.id        = first_id + i;
+            p.e_group   = e_group;
+            std::optional<float> first_flight;
+            if (_halton) {
+                first_flight = u[QMC_FLIGHT];
+            }
+            mesh.fold(p.location, p.direction);
+            _transport(p, random, first_flight);
+            block.push_back(std::move(p));
+        }
+    };
+
+    ThreadPool *pool = n_blocks > 1 ? _thread_pool() : nullptr;
+    if (pool) {
+        pool->parallel_for(n_blocks, spawn);
+    } else {
+        for (size_t i_block = 0; i_block < n_blocks; ++i_block) {
+            spawn(i_block);
+        }
+    }
+
+    unsigned int m = mesh.multiplicity();
+    for (size_t i_block = 0; i_block < n_blocks; ++i_block) {
+        auto &block = _daughter_blocks[i_block];
+        for (const auto &p : block) {
+            _spectrum[p.e_group] += p.weight * m;
+        }
+        std::move(block.begin(), block.end(), std::back_inserter(_particles));
+    }
+}
+
+void State::_transport(Particle &p, std::default_random_engine &random,
+                       std::optional<float> first_flight) const
+{
+    if (_draw_waypoints) {
+        _mesh->transport_particle<true>(p, random, _tally.get(), first_flight);
+    } else {
+        _mesh->transport_particle<false>(p, random, _tally.get(), first_flight);
+    }
+}
+
+template <BoundaryCondition BC, bool WAYPOINTS, bool GENERATIONS>
+void State::_advance_chunk(size_t begin, size_t end, TicChunk &chunk,
+                           std::default_random_engine &random)
+{
+    const uint8_t COLLIDED = 1;
+    const uint8_t OUTSIDE  = 2;
+    const uint8_t MIRRORED = 4;
+
+    chunk.out.clear();
+    chunk.collided.clear();
+    if constexpr (GENERATIONS) {
+        // Fission can only add one generation past the newest one
+        chunk.born.assign(_generation_born.size() + 1, 0);
+        chunk.population.assign(_generation_born.size() + 1, 0);
+    }
+    chunk.n_capture = 0;
+    chunk.n_fission = 0;
+    chunk.n_scatter = 0;
+    chunk.n_leak    = 0;
+    chunk.spectrum.fill(0.0);
+
+    const Mesh &mesh   = *_mesh;
+    const float width  = mesh.get_width();
+    const float height = mesh.get_height();
+
+    // Move everything first. This has no data-dependent branches, whatever the
+    // options. Taking the particles over, rather than copying them, leaves their
+    // waypoints behind without allocating anything.
+    chunk.moving.assign(std::make_move_iterator(_particles.begin() + begin),
+                        std::make_move_iterator(_particles.begin() + end));
+    const size_t n = chunk.moving.size();
+    chunk.status.resize(n);
+    Particle *moving = chunk.moving.data();
+    uint8_t *status  = chunk.status.data();
+    for (size_t i = 0; i < n; ++i) {
+        Particle &p  = moving[i];
+        bool collide = p.tic(1.0f);
+        bool outside = (p.location.x < 0.0f) | (p.location.x > width) |
+                       (p.location.y < 0.0f) | (p.location.y > height);
+        bool mirrored = !mesh.in_sector(p.location);
+        status[i]     = static_cast<uint8_t>(collide * COLLIDED + outside * OUTSIDE +
+                                         mirrored * MIRRORED);
+    }
+
+    // Then sort out the ones that left the domain, crossed a symmetry plane or
+    // reached a collision site
+    for (size_t i = 0; i < n; ++i) {
+        Particle &p = moving[i];
 
         // Handle the boundary condition
-        if (p.location.x < 0.0f || p.location.x > _mesh.get_width() ||
-            p.location.y < 0.0f || p.location.y > _mesh.get_height()) {
-            if (_bc == BoundaryCondition::VACUUM) {
-                p.alive = false;
-                process = false;
-                _n_leak++;
-                _generation_population[p.generation]--;
+        if (status[i] & OUTSIDE) {
+            if constexpr (BC == BoundaryCondition::VACUUM) {
+                chunk.n_leak += p.weight;
+                chunk.spectrum[p.e_group] -= p.weight;
+                if constexpr (GENERATIONS) {
+                    chunk.population[_generation_index(p.generation)]--;
+                }
+                continue;
             }
-            if (_bc == BoundaryCondition::REFLECTIVE) {
+            if constexpr (BC == BoundaryCondition::REFLECTIVE) {
                 if (p.location.x < 0.0f) {
                     p.direction.x = -p.direction.x;
                     p.location.x  = 0.0f;
                 }
-                if (p.location.x > _mesh.get_width()) {
+                if (p.location.x > width) {
                     p.direction.x = -p.direction.x;
-                    p.location.x  = _mesh.get_width();
+                    p.location.x  = width;
                 }
                 if (p.location.y < 0.0f) {
                     p.direction.y = -p.direction.y;
                     p.location.y  = 0.0f;
                 }
-                if (p.location.y > _mesh.get_height()) {
+                if (p.location.y > height) {
                     p.direction.y = -p.direction.y;
-                    p.location.y  = _mesh.get_height();
+                    p.location.y  = height;
+                }
+            }
+            if constexpr (BC == BoundaryCondition::PERIODIC) {
+                // Particles never move more than a fraction of the domain in a tic
+                if (p.location.x < 0.0f) {
+                    p.location.x += width;
+                }
+                if (p.location.x > width) {
+                    p.location.x -= width;
+                }
+                if (p.location.y < 0.0f) {
+                    p.location.y += height;
+                }
+                if (p.location.y > height) {
+                    p.location.y -= height;
                 }
-                _mesh.transport_particle(p, _random);
+                p.material = mesh.get_material(p.location);
             }
+            mesh.transport_particle<WAYPOINTS>(p, random, _tally.get());
         }
 
-        if (process) {
-            _process_queue.push_back(id);
-        } else if (p.alive) {
-            _back_particles.push_back(p);
-		}
+        // The flight path was sampled through the whole mesh, which looks the
+        // same on both sides of a symmetry plane, so it only needs reflecting.
+        // Wrapping around a periodic boundary can also land outside the sector.
+        if (status[i] & (OUTSIDE | MIRRORED)) {
+            mesh.fold(p);
+        }
+
+        if (status[i] & COLLIDED) {
+            chunk.collided.push_back(std::move(p));
+        } else {
+            chunk.out.push_back(std::move(p));
+        }
+    }
+
+    // Make room in the fission bank for what the collisions are likely to produce
+    float expected_sites = 0.0f;
+    for (const auto &p : chunk.collided) {
+        float xstr = p.material->xstr[p.e_group];
+        if (xstr > 0.0f) {
+            expected_sites += MEAN_NU * p.material->xsf[p.e_group] / xstr;
+        }
+    }
+    chunk.bank->reserve_more(expected_sites);
+
+    for (auto &p : chunk.collided) {
+        _interact<WAYPOINTS, GENERATIONS>(p, chunk, random);
+    }
+}
+
+State::AdvanceKernel State::_select_kernel() const
+{
+    using BC = BoundaryCondition;
+    // Indexed by [boundary condition][waypoints][generations]
+    static const AdvanceKernel kernels[3][2][2] = {
+        {{&State::_advance_chunk<BC::VACUUM, false, false>,
+          &State::_advance_chunk<BC::VACUUM, false, true>},
+         {&State::_advance_chunk<BC::VACUUM, true, false>,
+          &State::_advance_chunk<BC::VACUUM, true, true>}},
+        {{&State::_advance_chunk<BC::REFLECTIVE, false, false>,
+          &State::_advance_chunk<BC::REFLECTIVE, false, true>},
+         {&State::_advance_chunk<BC::REFLECTIVE, true, false>,
+          &State::_advance_chunk<BC::REFLECTIVE, true, true>}},
+        {{&State::_advance_chunk<BC::PERIODIC, false, false>,
+          &State::_advance_chunk<BC::PERIODIC, false, true>},
+         {&State::_advance_chunk<BC::PERIODIC, true, false>,
+          &State::_advance_chunk<BC::PERIODIC, true, true>}}};
+
+    return kernels[static_cast<int>(_bc)][_draw_waypoints][_track_generations];
+}
+
+void State::_merge_chunks(size_t n_chunks)
+{
+    const auto &sites = _fission_bank.collect();
+
+    size_t n_out = sites.size();
+    for (size_t i_chunk = 0; i_chunk < n_chunks; ++i_chunk) {
+        n_out += _chunks[i_chunk].out.size();
+    }
+
+    // Everything that happens in the sector also happens in each of its mirror
+    // images
+    const int m = _mesh->multiplicity();
+
+    _back_particles.clear();
+    _back_particles.reserve(n_out);
+    for (size_t i_chunk = 0; i_chunk < n_chunks; ++i_chunk) {
+        auto &chunk = _chunks[i_chunk];
+        std::move(chunk.out.begin(), chunk.out.end(),
+                  std::back_inserter(_back_particles));
+
+        _n_capture += chunk.n_capture * m;
+        _n_fission += chunk.n_fission * m;
+        _n_scatter += chunk.n_scatter * m;
+        _n_leak += chunk.n_leak * m;
+        for (int g = 0; g < Source::N_GROUPS; ++g) {
+            _spectrum[g] += chunk.spectrum[g] * m;
+        }
 
-        ++id;
+        if (!_track_generations) {
+            continue;
+        }
+        for (size_t gen = 0; gen < chunk.born.size(); ++gen) {
+            if (chunk.born[gen] == 0 && chunk.population[gen] == 0) {
+                continue;
+            }
+            if (gen >= _generation_born.size()) {
+                _generation_born.resize(gen + 1, 0);
+                _generation_population.resize(gen + 1, 0);
+            }
+            _generation_born[gen] += chunk.born[gen] * m;
+            _generation_population[gen] += chunk.population[gen] * m;
+            _born_from_fission += chunk.born[gen] * m;
+        }
     }
 
-    for (const auto id : _process_queue) {
-        interact(id);
+    if (_hold_fission_sites) {
+        // They won't be part of the population until they are added back
+        _held_sites.insert(_held_sites.end(), sites.begin(), sites.end());
+        if (_track_generations) {
+            for (const auto &site : sites) {
+                _generation_population[_generation_index(site.generation)] -= m;
+            }
+        }
+    } else {
+        _spawn_daughters(sites);
     }
 
     _particles.swap(_back_particles);
     _back_particles.clear();
+}
+
+double State::total_weight() const
+{
+    return std::accumulate(_spectrum.begin(), _spectrum.end(), 0.0);
+}
+
+void State::_control_population()
+{
+    if (_population_control == PopulationControl::NONE || _particles.empty()) {
+        return;
+    }
+
+    // The target is for the whole mesh, of which we only simulate a sector
+    const unsigned int m = _mesh->multiplicity();
+    size_t target        = std::max<size_t>(1, (_population_target + m / 2) / m);
+
+    double total = 0.0;
+    for (const auto &p : _particles) {
+        total += p.weight;
+    }
+    // The weight each particle should have
+    const double share = total / target;
+
+    // Done on this thread, in the order of the population, so that the outcome
+    // doesn't depend on the number of threads
+    std::seed_seq seed{_seed, _time_step, 0u, 3u};
+    std::default_random_engine random(seed);
+    std::uniform_real_distribution<double> unit;
 
-    if (_time_step % _history_resolution == 0) {
-        if (_population_history.size() == MAX_POP_HIST) {
-            _resample_population();
+    _back_particles.clear();
+    _back_particles.reserve(target + target / 4);
+    double cumulative = 0.0;
+    double next_tooth = unit(random) * share;
+    for (auto &p : _particles) {
+        size_t n_copies = 0;
+        double weight   = share;
+        if (_population_control == PopulationControl::COMB) {
+            cumulative += p.weight;
+            while (next_tooth < cumulative && _back_particles.size() < target) {
+                n_copies++;
+                next_tooth += share;
+            }
+        } else {
+            double ratio = p.weight / share;
+            if (ratio < 1.0) {
+                n_copies = unit(random) < ratio ? 1 : 0;
+            } else {
+                n_copies = static_cast<size_t>(ratio + unit(random));
+                weight   = p.weight / n_copies;
+            }
         }
-        _population_history.push_back(_particles.size());
+        _keep_copies(p, n_copies, static_cast<float>(weight));
     }
-    assert(_particles.size() == std::accumulate(_generation_population.begin(),
-                                                _generation_population.end(), 0));
+
+    _particles.swap(_back_particles);
+    _back_particles.clear();
 }
 
-void State::resample()
+void State::_apply_weight_windows()
 {
+    if (!_weight_windows) {
+        return;
+    }
+    const WeightWindows &windows = *_weight_windows;
+
+    std::seed_seq seed{_seed, _time_step, 0u, 4u};
+    std::default_random_engine random(seed);
+    std::uniform_real_distribution<float> unit;
+
+    _back_particles.clear();
+    _back_particles.reserve(_particles.size());
     for (auto &p : _particles) {
-        _mesh.transport_particle(p, _random);
+        float lower    = windows.lower(p.location, p.e_group);
+        float survival = lower * WeightWindows::SURVIVAL_RATIO;
+        if (lower <= 0.0f ||
+            (p.weight >= lower && p.weight <= lower * WeightWindows::UPPER_RATIO)) {
+            _back_particles.push_back(std::move(p));
+        } else if (p.weight < lower) {
+            _keep_copies(p, unit(random) * survival < p.weight ? 1 : 0, survival);
+        } else {
+            auto n_copies = static_cast<size_t>(p.weight / survival + unit(random));
+            n_copies      = std::min<size_t>(n_copies, WeightWindows::MAX_SPLIT);
+            _keep_copies(p, n_copies, p.weight / n_copies);
+        }
+    }
+
+    _particles.swap(_back_particles);
+    _back_particles.clear();
+}
+
+void State::_retire_generations()
+{
+    // The newest generation is always kept, as fission adds to the one after it
+    while (_generation_born.size() > 1 &&
+           (_generation_population[0] == 0 ||
+            _generation_born.size() > MAX_GENERATIONS)) {
+        _retired_born.add(_generation_born[0]);
+        // Whatever is left of it carries on in the next one
+        _generation_population[1] += _generation_population[0];
+        _generation_born.erase(_generation_born.begin());
+        _generation_population.erase(_generation_population.begin());
+        _first_generation++;
     }
 }
 
-void State::draw() const
+void State::_keep_copies(Particle &p, size_t n_copies, float weight)
 {
-    glPushMatrix();
+    const unsigned int m = _mesh->multiplicity();
+    if (n_copies == 0) {
+        if (_track_generations) {
+            _generation_population[_generation_index(p.generation)] -= m;
+        }
+        _spectrum[p.e_group] -= p.weight * m;
+        return;
+    }
+    if (_track_generations) {
+        _generation_population[_generation_index(p.generation)] += (n_copies - 1) * m;
+    }
+    _spectrum[p.e_group] += (n_copies * weight - p.weight) * m;
+
+    // Copies go on from the same point in the same direction, and part ways at
+    // their next collision
+    p.weight = weight;
+    for (size_t i = 1; i < n_copies; ++i) {
+        Particle copy = p;
+        copy.id       = _next_id++;
+        _back_particles.push_back(std::move(copy));
+    }
+    _back_particles.push_back(std::move(p));
+}
 
-    _projection_matrix.apply();
+void State::add_fission_sites(const std::vector<FissionSite> &sites)
+{
+    // The new particles go into the back buffer, which is empty between tics
+    _spawn_daughters(sites);
+    _particles.reserve(_particles.size() + _back_particles.size());
+    std::move(_back_particles.begin(), _back_particles.end(),
+              std::back_inserter(_particles));
+    _back_particles.clear();
 
-    _mesh.draw();
+    if (_track_generations) {
+        unsigned int m = _mesh->multiplicity();
+        for (const auto &site : sites) {
+            size_t gen = _generation_index(site.generation);
+            if (gen >= _generation_population.size()) {
+                _generation_born.resize(gen + 1, 0);
+                _generation_population.resize(gen + 1, 0);
+            }
+            _generation_population[gen] += m;
+        }
+    }
+}
 
-    if (_bc == BoundaryCondition::REFLECTIVE) {
-        _boundary.draw();
+void State::take_emigrants(std::vector<Particle> &emigrants)
+{
+    if (!_subdomain) {
+        return;
     }
 
-    glBegin(GL_POINTS);
-    for (auto &p : _particles) {
-        const auto &c = _particle_colors[p.generation % _particle_colors.size()];
-        glColor4f(c.r, c.g, c.b, c.a);
-        glVertex2f(p.location.x, p.location.y);
-        if (_draw_waypoints) {
-            glColor4f(PARTICLE_DEST_COLOR.r, PARTICLE_DEST_COLOR.g,
-                      PARTICLE_DEST_COLOR.b, PARTICLE_DEST_COLOR.a);
-            for (const auto waypoint : p.waypoints) {
-                glVertex2f(waypoint.x, waypoint.y);
+    const Rect &subdomain = _subdomain.value();
+    auto leaving = std::stable_partition(_particles.begin(), _particles.end(),
+                                         [&subdomain](const Particle &p) {
+                                             return subdomain.contains(p.location);
+                                         });
+    for (auto it = leaving; it != _particles.end(); ++it) {
+        if (_track_generations) {
+            _generation_population[_generation_index(it->generation)] -=
+                _mesh->multiplicity();
+        }
+        _spectrum[it->e_group] -= it->weight * _mesh->multiplicity();
+        emigrants.push_back(std::move(*it));
+    }
+    _particles.erase(leaving, _particles.end());
+}
+
+void State::add_immigrants(std::vector<Particle> &immigrants)
+{
+    for (auto &p : immigrants) {
+        if (_track_generations) {
+            size_t gen = _generation_index(p.generation);
+            if (gen >= _generation_population.size()) {
+                _generation_born.resize(gen + 1, 0);
+                _generation_population.resize(gen + 1, 0);
             }
+            _generation_population[gen] += _mesh->multiplicity();
+        }
+        _spectrum[p.e_group] += p.weight * _mesh->multiplicity();
+        _particles.push_back(std::move(p));
+    }
+}
+
+void State::set_population(const std::vector<Particle> &particles)
+{
+    unsigned int m = _mesh->multiplicity();
+    if (_track_generations) {
+        for (const auto &p : _particles) {
+            _generation_population[_generation_index(p.generation)] -= m;
         }
     }
-    glEnd();
+    _particles.clear();
+
+    // Pending edits re-transport the whole population anyway
+    bool resample_pending;
+    {
+        std::lock_guard<std::mutex> lock(_edit_mutex);
+        resample_pending = _resample_pending;
+    }
 
-    if (_labels) {
-        glColor3f(1.0f, 1.0f, 1.0f);
-        for (size_t id = 0; id < _particles.size(); ++id) {
-            glRasterPos2f(_particles[id].location.x, _particles[id].location.y);
-            std::stringstream sstream;
-            sstream << id;
-            auto id_str = sstream.str();
-            glutBitmapString(GLUT_BITMAP_HELVETICA_18,
-                             (const unsigned char *)id_str.c_str());
+    _particles.reserve(particles.size());
+    for (const auto &source : particles) {
+        Particle p   = source;
+        p.id         = _next_id++;
+        p.generation = 0;
+        p.waypoints.clear();
+        if (!resample_pending) {
+            p.material = _mesh->get_material(p.location);
+            _transport(p, _random);
         }
+        _particles.push_back(std::move(p));
+    }
+
+    if (_track_generations) {
+        size_t first   = _generation_index(0);
+        auto n_started = static_cast<unsigned int>(particles.size() * m);
+        _generation_born[first] += n_started;
+        _generation_population[first] += n_started;
+    }
+    _recount_spectrum();
+}
+
+void State::_spawn_daughters(const std::vector<FissionSite> &sites)
+{
+    size_t n_blocks = (sites.size() + TIC_CHUNK_SIZE - 1) / TIC_CHUNK_SIZE;
+    if (_daughter_blocks.size() < n_blocks) {
+        _daughter_blocks.resize(n_blocks);
     }
 
-    // Print statistics, etc
-    std::stringstream sstream;
-    sstream << "Neutron population: " << _particles.size();
-    glColor3f(1.0f, 1.0f, 1.0f);
-    glRasterPos2f(1.0f, 1.0f);
-    auto pop_str  = sstream.str();
-    const char *c = pop_str.c_str();
-    glutBitmapString(GLUT_BITMAP_HELVETICA_18, (const unsigned char *)c);
+    // Sites come in a fixed order, so handing out ids and random numbers by
+    // position makes the daughters the same from run to run
+    uint64_t first_id = _next_id;
+    _next_id += sites.size();
 
-    sstream.str("");
+    auto spawn = [&](size_t i_block) {
+        std::seed_seq seed{_seed, _time_step, static_cast<unsigned int>(i_block), 1u};
+        std::default_random_engine random(seed);
+        size_t begin = i_block * TIC_CHUNK_SIZE;
+        size_t end   = std::min(begin + TIC_CHUNK_SIZE, sites.size());
 
-    sstream << "Mean dist. to collision: " << _mesh.mean_distance_to_collision();
-    auto mdtc_str = sstream.str();
-    glRasterPos2f(1.0f, 1.5f);
-    glutBitmapString(GLUT_BITMAP_HELVETICA_18, (const unsigned char *)mdtc_str.c_str());
+        auto &block = _daughter_blocks[i_block];
+        block.clear();
+        for (size_t i = begin; i < end; ++i) {
+            const FissionSite &site = sites[i];
+            Particle p              = _new_particle(site.location, random);
+            p.id                    = first_id + i;
+            // TODO: Actually sample chi distribution
+            p.e_group    = 0;
+            p.generation = site.generation;
+            p.weight     = site.weight;
+            p.material   = site.material;
+            _transport(p, random);
+            block.push_back(std::move(p));
+        }
+    };
 
-    sstream.str("");
+    if (ThreadPool *pool = _thread_pool()) {
+        pool->parallel_for(n_blocks, spawn);
+    } else {
+        for (size_t i_block = 0; i_block < n_blocks; ++i_block) {
+            spawn(i_block);
+        }
+    }
 
-    sstream << "Time step: " << _time_step;
-    auto ts_str = sstream.str();
-    glRasterPos2f(1.0f, 2.0f);
-    glutBitmapString(GLUT_BITMAP_HELVETICA_18, (const unsigned char *)ts_str.c_str());
+    unsigned int m = _mesh->multiplicity();
+    for (size_t i_block = 0; i_block < n_blocks; ++i_block) {
+        auto &block = _daughter_blocks[i_block];
+        for (const auto &p : block) {
+            _spectrum[p.e_group] += p.weight * m;
+            _n_born += p.weight * m;
+        }
+        std::move(block.begin(), block.end(), std::back_inserter(_back_particles));
+    }
+}
 
-    for (size_t gen = 0; gen < _generation_born.size(); ++gen) {
-        sstream.str("");
-        sstream << "Generation " << gen << ": " << _generation_born[gen] << " ("
-                << _generation_population[gen] << ")";
-        pop_str = sstream.str();
-        glRasterPos2f(_mesh.get_width() + 0.2f, _mesh.get_height() - 0.5f - 0.5f * gen);
-        glutBitmapString(GLUT_BITMAP_HELVETICA_18,
-                         (const unsigned char *)pop_str.c_str());
+void State::_record_history()
+{
+    _histories[static_cast<int>(HistorySeries::POPULATION)].add(total_weight());
+    // The rest follow the population in the same order as the counters
+    std::array<double, 5> counts = {_n_scatter, _n_capture, _n_fission, _n_leak,
+                                    _n_born};
+    for (size_t i = 0; i < counts.size(); ++i) {
+        _histories[static_cast<int>(HistorySeries::SCATTER) + i].add(
+            counts[i] - _recorded_counts[i]);
+    }
+    _recorded_counts = counts;
+}
+
+void State::_summarize()
+{
+    _render_particles.clear();
+    _render_waypoints.clear();
+
+    // Unfold the sector into the whole mesh
+    const Mesh &mesh = *_mesh;
+    unsigned int m   = mesh.multiplicity();
+    for (const auto &p : _particles) {
+        Color color = _particle_colors[p.generation % _particle_colors.size()];
+        for (unsigned int i = 0; i < m; ++i) {
+            _render_particles.push_back({mesh.image_location(p.location, i), color});
+            if (_draw_waypoints) {
+                for (const auto &waypoint : p.waypoints) {
+                    _render_waypoints.push_back(mesh.image_location(waypoint, i));
+                }
+            }
+        }
+    }
+}
+
+void State::resample()
+{
+    size_t n_blocks = (_particles.size() + TIC_CHUNK_SIZE - 1) / TIC_CHUNK_SIZE;
+
+    // The flights being replaced were scored when they were sampled, so the new
+    // ones aren't, or the tally would count the same stretch twice
+    const Mesh &mesh = *_mesh;
+    auto retransport = [&](size_t i_block) {
+        std::seed_seq seed{_seed, _time_step, static_cast<unsigned int>(i_block), 3u};
+        std::default_random_engine random(seed);
+        size_t begin = i_block * TIC_CHUNK_SIZE;
+        size_t end   = std::min(begin + TIC_CHUNK_SIZE, _particles.size());
+        for (size_t i = begin; i < end; ++i) {
+            Particle &p = _particles[i];
+            // The material under the particle may have changed along with the mesh
+            p.material = mesh.get_material(p.location);
+            if (_draw_waypoints) {
+                mesh.transport_particle<true>(p, random);
+            } else {
+                mesh.transport_particle<false>(p, random);
+            }
+        }
+    };
+
+    ThreadPool *pool = n_blocks > 1 ? _thread_pool() : nullptr;
+    if (pool) {
+        pool->parallel_for(n_blocks, retransport);
+    } else {
+        for (size_t i_block = 0; i_block < n_blocks; ++i_block) {
+            retransport(i_block);
+        }
+    }
+}
+
+Mesh &State::_edit_mesh()
+{
+    if (!_next_mesh) {
+        _next_mesh = _mesh->clone();
+    } else if (_next_mesh.use_count() > 1) {
+        // Someone is looking at the pending version; leave it alone
+        _next_mesh = _next_mesh->clone();
+    }
+    return *_next_mesh;
+}
+
+void State::_commit_mesh()
+{
+    std::shared_ptr<Mesh> next;
+    bool resample_needed = false;
+    {
+        std::lock_guard<std::mutex> lock(_edit_mutex);
+        next              = std::move(_next_mesh);
+        _next_mesh        = nullptr;
+        resample_needed   = _resample_pending;
+        _resample_pending = false;
+    }
+
+    if (!next) {
+        return;
     }
 
-    glPopMatrix();
+    auto previous = _mesh;
+    std::atomic_store(&_mesh, std::shared_ptr<const Mesh>(std::move(next)));
+    if (_mesh->symmetry() != previous->symmetry()) {
+        _change_symmetry(*previous);
+    }
+    if (resample_needed) {
+        resample();
+    }
 }
 
-void State::interact(size_t id)
+template <bool WAYPOINTS, bool GENERATIONS>
+void State::_interact(Particle &p, TicChunk &chunk,
+                      std::default_random_engine &random) const
 {
-    Vec2 test_center        = {5.5f, 5.5f};
-    float r                 = _unit_distribution(_random);
-    Particle &p             = _particles[id];
-    Material const *mat     = p.material;
-    Interaction interaction = mat->interaction_cdf[p.e_group].sample(r);
+    std::uniform_real_distribution<float> unit_distribution;
+    std::uniform_real_distribution<float> angle_distribution(
+        _angle_distribution.param());
+
+    float r                   = unit_distribution(random);
+    Material const *mat       = p.material;
+    const InteractionCDF &cdf = mat->interaction_cdf[p.e_group];
+    Interaction interaction   = cdf.sample(r);
+    // Taken out of the spectrum here, and put back if it carries on
+    chunk.spectrum[p.e_group] -= p.weight;
+
+    if (_implicit_capture && cdf.capture_probability() < 1.0f) {
+        // Capture takes its share of the weight, and the rest carries on
+        float captured = p.weight * cdf.capture_probability();
+        chunk.n_capture += captured;
+        p.weight -= captured;
+        interaction = cdf.sample_surviving(r);
+
+        bool controlled =
+            _weight_windows || _population_control != PopulationControl::NONE;
+        if (!controlled && p.weight < WEIGHT_CUTOFF) {
+            if (unit_distribution(random) * WEIGHT_SURVIVAL >= p.weight) {
+                p.alive = false;
+                if constexpr (GENERATIONS) {
+                    chunk.population[_generation_index(p.generation)] -= 1;
+                }
+                return;
+            }
+            p.weight = WEIGHT_SURVIVAL;
+        }
+    }
 
     if (interaction == Interaction::CAPTURE) {
-        _n_capture++;
+        chunk.n_capture += p.weight;
         p.alive = false;
-        _generation_population[p.generation] -= 1;
+        if constexpr (GENERATIONS) {
+            chunk.population[_generation_index(p.generation)] -= 1;
+        }
         return;
     }
     if (interaction == Interaction::SCATTER) {
-        _n_scatter++;
-        float angle  = _angle_distribution(_random);
-        float scat_r = _unit_distribution(_random);
+        chunk.n_scatter += p.weight;
+        float angle  = angle_distribution(random);
+        float scat_r = unit_distribution(random);
         p.e_group    = mat->scatter_cdf[p.e_group].sample(scat_r);
         p.direction  = {std::sin(angle), std::cos(angle)};
-        _mesh.transport_particle(p, _random);
-        _back_particles.push_back(p);
+        _mesh->transport_particle<WAYPOINTS>(p, random, _tally.get());
+        chunk.spectrum[p.e_group] += p.weight;
+        chunk.out.push_back(std::move(p));
         return;
     }
     if (interaction == Interaction::FISSION) {
-        _n_fission++;
+        chunk.n_fission += p.weight;
         p.alive = false;
-        _generation_population[p.generation] -= 1;
-        Particle old_p = p;
-        float new_r    = _unit_distribution(_random);
-        int nu         = new_r > 0.5 ? 3 : 2;
-        for (int i = 0; i < nu; ++i) {
-            Particle p2 = _new_particle(old_p.location);
-            // TODO: Actually sample chi distribution
-            p2.e_group    = 0;
-            p2.generation = old_p.generation + 1;
-            if (p2.generation > _generation_born.size() - 1) {
-                _generation_born.push_back(0);
-                _generation_population.push_back(0);
+        if constexpr (GENERATIONS) {
+            chunk.population[_generation_index(p.generation)] -= 1;
+        }
+        float new_r      = unit_distribution(random);
+        unsigned int nu  = new_r > 0.5 ? 3 : 2;
+        unsigned int gen = p.generation + 1;
+        for (unsigned int i = 0; i < nu; ++i) {
+            chunk.bank->bank(FissionSite{p.location, mat, p.id, gen, i, p.weight});
+            if constexpr (GENERATIONS) {
+                chunk.born[_generation_index(gen)] += 1;
+                chunk.population[_generation_index(gen)] += 1;
             }
-            _generation_born[p2.generation] += 1;
-            _generation_population[p2.generation] += 1;
-            p2.material = mat;
-            _mesh.transport_particle(p2, _random);
-            _back_particles.push_back(p2);
         }
         return;
     }
@@ -330,19 +1189,6 @@ void State::interact(size_t id)
     return;
 }
 
-// Double the history resolution and discard every other population sample.
-// Shift remaining values down and resize the vector
-void State::_resample_population()
-{
-    _history_resolution *= 2;
-    for (size_t i = 0; i < _population_history.size() / 2; ++i) {
-        _population_history[i] = _population_history[i * 2];
-    }
-
-    _population_history.resize(_population_history.size() / 2);
-    return;
-}
-
 void State::toggle_boundary_condition()
 {
     switch (_bc) {
@@ -350,41 +1196,264 @@ void State::toggle_boundary_condition()
         _bc = BoundaryCondition::REFLECTIVE;
         break;
     case BoundaryCondition::REFLECTIVE:
+        _bc = BoundaryCondition::PERIODIC;
+        break;
+    case BoundaryCondition::PERIODIC:
         _bc = BoundaryCondition::VACUUM;
         break;
     }
 }
 
+void State::toggle_generation_tracking()
+{
+    _track_generations = !_track_generations;
+    if (!_track_generations) {
+        return;
+    }
+
+    // The tallies went stale while we weren't tracking
+    _recount_generations();
+}
+
+void State::_recount_generations()
+{
+    // The current population can be recounted, but the number born can only be
+    // bounded from below
+    unsigned int m = _mesh->multiplicity();
+    std::fill(_generation_population.begin(), _generation_population.end(), 0);
+    for (const auto &p : _particles) {
+        size_t gen = _generation_index(p.generation);
+        if (gen >= _generation_population.size()) {
+            _generation_population.resize(gen + 1, 0);
+        }
+        _generation_population[gen] += m;
+    }
+    _generation_born.resize(_generation_population.size(), 0);
+    for (size_t gen = 0; gen < _generation_born.size(); ++gen) {
+        _generation_born[gen] =
+            std::max(_generation_born[gen], _generation_population[gen]);
+    }
+}
+
+void State::_recount_spectrum()
+{
+    unsigned int m = _mesh->multiplicity();
+    _spectrum.fill(0.0);
+    for (const auto &p : _particles) {
+        _spectrum[p.e_group] += p.weight * m;
+    }
+}
+
+bool State::set_symmetry(Symmetry symmetry)
+{
+    std::lock_guard<std::mutex> lock(_edit_mutex);
+    const Mesh &current = _next_mesh ? *_next_mesh : *_mesh;
+    if (current.symmetry() == symmetry) {
+        return true;
+    }
+    if (!current.is_symmetric(symmetry)) {
+        return false;
+    }
+    _edit_mesh().set_symmetry(symmetry);
+    return true;
+}
+
+void State::_change_symmetry(const Mesh &previous)
+{
+    // Unfold the population into the whole mesh, and keep the share of it that
+    // belongs to the new sector
+    const Mesh &mesh = *_mesh;
+    float keep       = 1.0f / mesh.multiplicity();
+    std::uniform_real_distribution<float> unit_distribution;
+
+    _back_particles.clear();
+    for (const auto &p : _particles) {
+        for (unsigned int i = 0; i < previous.multiplicity(); ++i) {
+            if (keep < 1.0f && unit_distribution(_random) >= keep) {
+                continue;
+            }
+            Particle image  = p;
+            image.location  = previous.image_location(p.location, i);
+            image.direction = previous.image_direction(p.direction, i);
+            image.waypoints.clear();
+            if (i > 0) {
+                image.id = _next_id++;
+            }
+            mesh.fold(image);
+            _back_particles.push_back(std::move(image));
+        }
+    }
+    _particles.swap(_back_particles);
+    _back_particles.clear();
+
+    if (_track_generations) {
+        _recount_generations();
+    }
+    _recount_spectrum();
+    _summarize();
+}
+
 void State::set_material_at(Vec2 location, PinType material)
 {
     auto[new_c, new_mat] = _pin_types[material];
 
-    _mesh.set_color_material_at(location, new_c, new_mat);
+    std::lock_guard<std::mutex> lock(_edit_mutex);
+    Mesh &mesh = _edit_mesh();
+    for (unsigned int i = 0; i < mesh.multiplicity(); ++i) {
+        mesh.set_color_material_at(mesh.image_location(location, i), new_c, new_mat);
+    }
+
+    _resample_pending = true;
+}
+
+void State::set_material_in_rect(Rect rect, PinType material)
+{
+    std::lock_guard<std::mutex> lock(_edit_mutex);
+    Mesh &mesh = _edit_mesh();
+    _set_regions(mesh, mesh.regions_in_rect(rect), material);
+}
+
+void State::set_material_in_ring(Vec2 center, float r_inner, float r_outer,
+                                 PinType material)
+{
+    std::lock_guard<std::mutex> lock(_edit_mutex);
+    Mesh &mesh = _edit_mesh();
+    _set_regions(mesh, mesh.regions_in_ring(center, r_inner, r_outer), material);
+}
+
+void State::set_material_at_pins(const std::vector<std::pair<int, int>> &pins,
+                                 PinType material)
+{
+    std::lock_guard<std::mutex> lock(_edit_mutex);
+    Mesh &mesh          = _edit_mesh();
+    const auto &lattice = mesh.lattice();
+    if (!lattice) {
+        return;
+    }
+
+    // Mark the pins on a grid, then pick out the regions in one pass
+    Array2D<uint8_t> wanted(lattice->nx, lattice->ny, 0);
+    for (auto [ix, iy] : pins) {
+        if (ix >= 0 && ix < lattice->nx && iy >= 0 && iy < lattice->ny) {
+            wanted(ix, iy) = 1;
+        }
+    }
+
+    std::vector<size_t> regions;
+    for (size_t i = 0; i < mesh.n_regions(); ++i) {
+        auto pin = lattice->pin_at(mesh.region_centroid(i));
+        if (pin && wanted(pin->first, pin->second)) {
+            regions.push_back(i);
+        }
+    }
+    _set_regions(mesh, regions, material);
+}
+
+void State::set_pin_pattern(const std::vector<std::vector<std::optional<PinType>>> &rows)
+{
+    std::lock_guard<std::mutex> lock(_edit_mutex);
+    Mesh &mesh          = _edit_mesh();
+    const auto &lattice = mesh.lattice();
+    if (!lattice) {
+        return;
+    }
+
+    // Sort the regions by the material they get
+    std::unordered_map<PinType, std::vector<size_t>> regions;
+    for (size_t i = 0; i < mesh.n_regions(); ++i) {
+        auto pin = lattice->pin_at(mesh.region_centroid(i));
+        if (!pin) {
+            continue;
+        }
+        int ix  = pin->first;
+        int row = lattice->ny - 1 - pin->second;
+        if (row >= static_cast<int>(rows.size()) ||
+            ix >= static_cast<int>(rows[row].size())) {
+            continue;
+        }
+        if (rows[row][ix]) {
+            regions[rows[row][ix].value()].push_back(i);
+        }
+    }
+
+    for (const auto &[material, selected] : regions) {
+        _set_regions(mesh, selected, material);
+    }
+}
+
+void State::_set_regions(Mesh &mesh, const std::vector<size_t> &regions,
+                         PinType material)
+{
+    auto [color, mat] = _pin_types[material];
+    mesh.set_color_material(regions, color, mat);
+
+    // Keep a symmetric mesh symmetric
+    for (unsigned int i = 1; i < mesh.multiplicity(); ++i) {
+        for (size_t i_reg : regions) {
+            Vec2 location = mesh.image_location(mesh.region_centroid(i_reg), i);
+            auto image    = mesh.find_region(location);
+            if (image) {
+                mesh.set_color_material(image.value(), color, mat);
+            }
+        }
+    }
+
+    _resample_pending = true;
+}
+
+std::vector<std::vector<std::optional<PinType>>> State::pin_pattern() const
+{
+    auto mesh           = displayed_mesh();
+    const auto &lattice = mesh->lattice();
+    if (!lattice) {
+        return {};
+    }
+
+    std::vector<std::vector<std::optional<PinType>>> rows(
+        lattice->ny, std::vector<std::optional<PinType>>(lattice->nx));
+    for (size_t i = 0; i < mesh->n_regions(); ++i) {
+        auto pin = lattice->pin_at(mesh->region_centroid(i));
+        if (!pin) {
+            continue;
+        }
+        int ix  = pin->first;
+        int row = lattice->ny - 1 - pin->second;
+        for (const auto &[type, properties] : _pin_types) {
+            if (std::get<1>(properties) == mesh->region_material(i)) {
+                rows[row][ix] = type;
+            }
+        }
+    }
+    return rows;
 }
 
 void State::cycle_shape(float x, float y)
 {
     Vec2 location = {x, y};
-    auto result   = _mesh.get_color_material_at(location);
+    std::lock_guard<std::mutex> lock(_edit_mutex);
+    Mesh &mesh  = _edit_mesh();
+    auto result = mesh.get_color_material_at(location);
     if (!result) {
         return;
     }
 
     auto[color, mat] = result.value();
     PinType new_type;
-    if (mat == &_materials.get_by_name("Moderator")) {
+    if (mat == &_materials->get_by_name("Moderator")) {
         new_type = PinType::FUEL;
-    } else if (mat == &_materials.get_by_name("UO2")) {
+    } else if (mat == &_materials->get_by_name("UO2")) {
         new_type = PinType::BLACK;
-    } else if (mat == &_materials.get_by_name("Control2")) {
+    } else if (mat == &_materials->get_by_name("Control2")) {
         new_type = PinType::VOID;
-    } else if (mat == &_materials.get_by_name("Void")) {
+    } else if (mat == &_materials->get_by_name("Void")) {
         new_type = PinType::MODERATOR;
     }
     auto[new_c, new_mat] = _pin_types[new_type];
-    _mesh.set_color_material_at(location, new_c, new_mat);
+    for (unsigned int i = 0; i < mesh.multiplicity(); ++i) {
+        mesh.set_color_material_at(mesh.image_location(location, i), new_c, new_mat);
+    }
 
-    resample();
+    _resample_pending = true;
 
     return;
 }
@@ -402,18 +1471,40 @@ void State::cycle_all()
         new_type = PinType::MODERATOR;
     }
     auto[new_c, new_mat] = _pin_types[new_type];
-    _mesh.set_color_material_all_shapes(new_c, new_mat);
+    std::lock_guard<std::mutex> lock(_edit_mutex);
+    _edit_mesh().set_color_material_all_shapes(new_c, new_mat);
     _current_pin_type = new_type;
 
-    resample();
+    _resample_pending = true;
+}
+
+void State::set_quasi_random(bool quasi_random)
+{
+    _halton         = nullptr;
+    _injected_draws = 0;
+    _source_draws   = 0;
+    if (quasi_random) {
+        _halton = std::make_shared<const HaltonSequence>(N_QMC_DIMENSIONS, _seed);
+    }
 }
 
 Particle State::_new_particle(Vec2 location) const
 {
-    float angle = _angle_distribution(_random);
+    return _new_particle(location, _random);
+}
+
+Particle State::_new_particle(Vec2 location, std::default_random_engine &random) const
+{
+    std::uniform_real_distribution<float> angle_distribution(
+        _angle_distribution.param());
+    return _new_particle(location, angle_distribution(random));
+}
+
+Particle State::_new_particle(Vec2 location, float angle) const
+{
     Vec2 direction{std::sin(angle), std::cos(angle)};
     Particle p(location, direction);
-    p.material = _mesh.get_material(p.location);
+    p.material = _mesh->get_material(p.location);
     p.e_group  = 6;
 
     return p;
@@ -1,28 +1,77 @@
 #pragma once
+#include <array>
 #include <cassert>
 #include <cmath>
 #include <cstdint>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <random>
 #include <tuple>
 #include <unordered_map>
 #include <vector>
 
+#include "fission_bank.h"
+#include "halton.h"
+#include "history.h"
 #include "materials.h"
 #include "mesh.h"
 #include "particle.h"
 #include "pin_types.h"
 #include "playbook.h"
 #include "shapes.h"
+#include "source.h"
+#include "tally.h"
+#include "thread_pool.h"
 #include "view.h"
+#include "weight_windows.h"
+
+enum class BoundaryCondition : uint8_t { VACUUM, REFLECTIVE, PERIODIC };
+
+// Ways of holding the number of particles near a target at the end of each tic,
+// while keeping their total weight.
+//   - COMB: pick exactly the target number of particles, with probability in
+//     proportion to their weights, and give them all the same weight. The total
+//     weight is kept exactly.
+//   - ROULETTE: particles lighter than the weight each should have play Russian
+//     roulette for it, and heavier ones are split into that many lighter ones.
+//     The number of particles and the total weight are only kept on average, but
+//     particles already at the right weight are left alone.
+enum class PopulationControl : uint8_t { NONE, COMB, ROULETTE };
+
+// What a State keeps a history of, tic by tic: the weight of the population at the
+// end of the tic, the weight that scattered, was captured, caused fission and
+// leaked during the tic, and the weight born from fission
+enum class HistorySeries : uint8_t {
+    POPULATION,
+    SCATTER,
+    CAPTURE,
+    FISSION,
+    LEAK,
+    BORN,
+    N_SERIES
+};
 
-enum class BoundaryCondition : uint8_t { VACUUM, REFLECTIVE };
-
+// A particle as it should be drawn
+struct ParticleVertex {
+    Vec2 location;
+    Color color;
+};
 
 class State {
 public:
     State();
 
+    // Set up a State using shared, read-only materials and geometry. The mesh
+    // must refer to materials from the same library; without one, the default
+    // lattice is built. Edits made to this State never affect the mesh that was
+    // passed in.
+    State(std::shared_ptr<const MaterialLibrary> materials,
+          std::shared_ptr<const Mesh> mesh = nullptr);
+
+    // Build the default lattice of fuel pins
+    static std::shared_ptr<const Mesh> make_lattice(const MaterialLibrary &materials);
+
     // Wipe out any existing particles and spawn a new batch.
     // A "soft" reset is performed by automated controls, and doesnt reset the parts of
     // the
@@ -30,24 +79,203 @@ public:
     // beginning to get things going and by the user.
     void reset(bool hard = true);
 
-    // Re-transport all particles; we do this when the system changes
+    // Re-transport all particles; we do this when the system changes. The work is
+    // split into chunks on the pool, each with its own random numbers, and the
+    // new flights aren't scored into the tally.
     void resample();
 
+    // The version of the mesh currently used for transport. Edits never touch a
+    // snapshot once it has been handed out; they go to a new version, which is
+    // swapped in at the start of the next tic.
+    std::shared_ptr<const Mesh> mesh_snapshot() const
+    {
+        return std::atomic_load(&_mesh);
+    }
+
     // Simulate the motion of particles for a frame/time step.
     // Handle collisions that occur
+    //
+    // A step runs as a small pipeline. Advancing and colliding the particles is
+    // split into chunks that run on the thread pool, while the render buffers for
+    // the population coming into the step are prepared at the same time. What
+    // gets drawn after a tic is therefore the state at the start of that tic,
+    // except when stepping manually. The histories are sampled once the tic is
+    // over.
     void tic(bool force = false);
 
-    void draw() const;
+    // Jump to the point where a number of tics have passed since the last hard
+    // reset. Going forward runs the simulation as fast as possible, without
+    // preparing anything for display until it gets there. Going back restores the
+    // closest keyframe before that point and runs forward from there. If there is
+    // none that early, it starts over with a hard reset and the seed, and runs
+    // forward from the start instead.
+    //
+    // Keyframes are saved every so often, both while seeking and while running
+    // normally, once they are turned on. They hold everything needed to carry on
+    // from that point, except for particle waypoints. Seeking turns them on if
+    // they aren't already, starting with one for the point it seeks from.
+    void seek(unsigned int elapsed);
+
+    // Whether to save keyframes. They are off to start with, since each one holds
+    // a copy of the population, and only something that seeks back needs them.
+    void set_keyframes(bool keyframes);
+
+    size_t n_keyframes() const
+    {
+        return _keyframes.size();
+    }
 
-    void add_particles(Vec2 location, int n)
+    // Run n_tics as fast as possible, without preparing anything for display
+    void advance(unsigned int n_tics);
+
+    // Number of tics since the last hard reset. Unlike time_step(), this is not
+    // reset by a playbook.
+    unsigned int elapsed() const
+    {
+        return _elapsed;
+    }
+
+    // The most recent version of the mesh, including edits that have not reached
+    // the transport yet. This is what should be shown to the user.
+    std::shared_ptr<const Mesh> displayed_mesh() const
     {
-        for (int i = 0; i < n; ++i) {
-            Particle p = _new_particle(location);
-            _mesh.transport_particle(p, _random);
-            _particles.push_back(p);
-            _generation_born[0]++;
-            _generation_population[0]++;
+        std::lock_guard<std::mutex> lock(_edit_mutex);
+        if (_next_mesh) {
+            return _next_mesh;
         }
+        return _mesh;
+    }
+
+    // Everything needed to draw the particles, as of the start of the last tic
+    const std::vector<ParticleVertex> &render_particles() const
+    {
+        return _render_particles;
+    }
+
+    const std::vector<Vec2> &render_waypoints() const
+    {
+        return _render_waypoints;
+    }
+
+    const Box &boundary() const
+    {
+        return _boundary;
+    }
+
+    std::shared_ptr<const MaterialLibrary> materials() const
+    {
+        return _materials;
+    }
+
+    BoundaryCondition boundary_condition() const
+    {
+        return _bc;
+    }
+
+    bool draw_waypoints() const
+    {
+        return _draw_waypoints;
+    }
+
+    bool draw_labels() const
+    {
+        return _labels;
+    }
+
+    const Ortho2D &view() const
+    {
+        return _projection_matrix;
+    }
+
+    unsigned int time_step() const
+    {
+        return _time_step;
+    }
+
+    // Number of particles in the whole mesh, including the mirror images of the
+    // simulated sector
+    size_t population() const
+    {
+        return _particles.size() * _mesh->multiplicity();
+    }
+
+    // Total weight of the particles in the whole mesh, which is the number of
+    // neutrons they stand for
+    double total_weight() const;
+
+    bool tracks_generations() const
+    {
+        return _track_generations;
+    }
+
+    static constexpr size_t MAX_GENERATIONS = 32;
+
+    // Particles born into each generation, and still left in it, from
+    // first_generation() on. The oldest generations are retired to
+    // retired_generations() once they have died out, or once there are more than
+    // MAX_GENERATIONS, so that a long run keeps a bounded number of them. The
+    // first entry also counts whatever is still going on in the retired ones.
+    const std::vector<unsigned int> &generation_born() const
+    {
+        return _generation_born;
+    }
+
+    const std::vector<unsigned int> &generation_population() const
+    {
+        return _generation_population;
+    }
+
+    unsigned int first_generation() const
+    {
+        return _first_generation;
+    }
+
+    // Particles born into each generation before first_generation(), oldest first
+    const History &retired_generations() const
+    {
+        return _retired_born;
+    }
+
+    // Particles born from fission since the last reset, in all generations
+    double n_born_from_fission() const
+    {
+        return _born_from_fission;
+    }
+
+    // Start the random number streams over from a new seed
+    void set_seed(unsigned int seed)
+    {
+        _seed = seed;
+        _random.seed(seed);
+        if (_halton) {
+            set_quasi_random(true);
+        }
+    }
+
+    // Quasi-Monte Carlo sampling of particles added from a source: the location,
+    // direction and first distance to collision of each one come from a Halton
+    // point rather than from the random number stream. Each source takes the
+    // points in order, counting its own draws, so that what it adds covers them
+    // evenly however many other particles there are. The points are scrambled by
+    // the seed, so runs with different seeds make independent replicates to take
+    // error bars over.
+    void set_quasi_random(bool quasi_random);
+
+    bool quasi_random() const
+    {
+        return _halton != nullptr;
+    }
+
+    // Add n particles drawn from a source. The whole batch is sampled and
+    // transported at once, spread over the thread pool. With a symmetry, the
+    // particles are spread over the mirror images of the source, so only a share
+    // of them end up in the simulated sector.
+    void add_particles(const Source &source, size_t n);
+
+    // Add n particles at a location
+    void add_particles(Vec2 location, int n)
+    {
+        add_particles(Source::point(location), n > 0 ? n : 0);
     }
 
     // Associate a playbook to automate controls
@@ -60,9 +288,67 @@ public:
     // Switch to the next boundary condition type
     void toggle_boundary_condition();
 
+    void set_boundary_condition(BoundaryCondition bc)
+    {
+        _bc = bc;
+    }
+
+    // Hold the number of particles in the whole mesh near a target from the end of
+    // the next tic on, so that a tic costs about the same however reactive the
+    // lattice is
+    void set_population_control(PopulationControl control, size_t target)
+    {
+        _population_control = control;
+        _population_target  = target;
+    }
+
+    PopulationControl population_control() const
+    {
+        return _population_control;
+    }
+
+    // Survival biasing: rather than being captured, particles carry on after every
+    // collision with the part of their weight that wasn't. Unless something else
+    // is keeping weights in check, particles that get too light play Russian
+    // roulette.
+    void set_implicit_capture(bool implicit)
+    {
+        _implicit_capture = implicit;
+    }
+
+    bool implicit_capture() const
+    {
+        return _implicit_capture;
+    }
+
+    // Keep particle weights within windows at the end of every tic, or stop with
+    // nullptr. This comes before population control, if both are on.
+    void set_weight_windows(std::shared_ptr<const WeightWindows> windows)
+    {
+        _weight_windows = std::move(windows);
+    }
+
+    size_t population_target() const
+    {
+        return _population_target;
+    }
+
+    // Only simulate the fundamental sector of a symmetric mesh. Counters, spectra,
+    // histories and the particles to draw are unfolded to the whole mesh. Edits
+    // are applied to every mirror image, to keep the mesh symmetric. Returns
+    // false, leaving things as they were, if the mesh doesn't have the symmetry.
+    // Like other edits, this takes effect at the start of the next tic.
+    bool set_symmetry(Symmetry symmetry);
+
+    Symmetry symmetry() const
+    {
+        return displayed_mesh()->symmetry();
+    }
+
     void toggle_waypoints()
     {
         _draw_waypoints = !_draw_waypoints;
+        _summarize();
     }
 
     void toggle_pause()
@@ -71,6 +357,15 @@ public:
         std::cout << "Pause: " << _paused << "\n";
     }
 
+    bool paused() const
+    {
+        return _paused;
+    }
+
+    // Turn the per-generation tallies on or off. Tics are a bit cheaper without
+    // them.
+    void toggle_generation_tracking();
+
     void toggle_labels()
     {
         _labels = !_labels;
@@ -78,7 +373,8 @@ public:
 
     void set_source(float x, float y)
     {
-        _source = Vec2{x, y};
+        _source       = Vec2{x, y};
+        _source_draws = 0;
     }
 
     void unset_source()
@@ -98,44 +394,296 @@ public:
 
 	void set_material_at(Vec2 location, PinType material);
 
+    // Edit many regions at once. Regions are picked out by their centroids. All
+    // of the edits made before a tic are taken up together, with one pass over
+    // the population.
+    void set_material_in_rect(Rect rect, PinType material);
+    void set_material_in_ring(Vec2 center, float r_inner, float r_outer,
+                              PinType material);
+    // Pins given by their (x, y) index in the lattice of the mesh, from the lower
+    // left. Neither this nor set_pin_pattern() does anything to a mesh that isn't
+    // laid out as a lattice.
+    void set_material_at_pins(const std::vector<std::pair<int, int>> &pins,
+                              PinType material);
+    // Rows of the lattice, top row first, starting from the left. Pins without a
+    // value are left alone, as are pins past the end of the rows.
+    void set_pin_pattern(const std::vector<std::vector<std::optional<PinType>>> &rows);
+
+    // The type of every pin, in the same layout as set_pin_pattern(), including
+    // edits that haven't been taken up yet. Pins made of something else are left
+    // empty, as is the whole pattern for a mesh without a lattice.
+    std::vector<std::vector<std::optional<PinType>>> pin_pattern() const;
+
     // Cycle the shape in the mesh from one to the next in a collection
     void cycle_shape(float x, float y);
 
     void cycle_all();
 
-    // Sample a particle interaction. Return whether the particle survived.
-    void interact(size_t id);
+    // Use a different pool for the work within a tic. Passing nullptr runs
+    // everything on the calling thread. Without a call to this, a pool with a
+    // thread per core is started the first time there is work for it.
+    void set_thread_pool(std::shared_ptr<ThreadPool> pool)
+    {
+        _pool        = std::move(pool);
+        _pool_chosen = true;
+    }
 
-    std::vector<unsigned int> get_interaction_counts() const
+    // Restrict this State to part of the domain, for domain decomposition.
+    // Particles are only added inside the subdomain, and the ones that move out of
+    // it are handed over by take_emigrants(). Ids start at first_id, so that they
+    // stay unique across subdomains.
+    void set_subdomain(Rect subdomain, uint64_t first_id)
+    {
+        _subdomain = subdomain;
+        _first_id  = first_id;
+        _next_id   = first_id;
+    }
+
+    // Move the particles that are outside of the subdomain to the end of
+    // emigrants, in population order
+    void take_emigrants(std::vector<Particle> &emigrants);
+
+    // Take in particles that moved here from another subdomain
+    void add_immigrants(std::vector<Particle> &immigrants);
+
+    // Keep fission sites in the bank rather than turning them into particles
+    // straight away, so that a generation can be run out before the next one
+    // starts. The sites pile up until they are taken.
+    void hold_fission_sites(bool hold)
+    {
+        _hold_fission_sites = hold;
+    }
+
+    // Take the fission sites held since the last call, in the order they were
+    // banked
+    std::vector<FissionSite> take_fission_sites()
+    {
+        return std::move(_held_sites);
+    }
+
+    // Turn fission sites into particles, in the same way as sites from the bank
+    void add_fission_sites(const std::vector<FissionSite> &sites);
+
+    // Score every flight from now on into a tally, or stop scoring with nullptr.
+    // The tally is not part of the history, so seeking doesn't rewind it.
+    void set_tally(std::shared_ptr<MeshTally> tally)
+    {
+        _tally = std::move(tally);
+    }
+
+    // The particles currently being simulated
+    const std::vector<Particle> &particles() const
+    {
+        return _particles;
+    }
+
+    // Replace the population with copies of some particles, such as the ones left
+    // at the end of another run, to start from a source that has already settled.
+    // The copies become generation 0, with new ids, and are tracked to their next
+    // collision through the current mesh.
+    void set_population(const std::vector<Particle> &particles);
+
+    // Total weight of the particles that scattered, were captured, caused fission
+    // and leaked. Without population control every particle weighs one, so these
+    // are plain counts.
+    std::vector<double> get_interaction_counts() const
     {
         return {_n_scatter, _n_capture, _n_fission, _n_leak};
     }
 
-    std::vector<unsigned int> get_spectrum() const
+    // Weight of the population in each energy group
+    std::vector<double> get_spectrum() const
     {
-        std::vector<unsigned int> spectrum(7, 0);
-        for (const auto &p : _particles) {
-            spectrum[p.e_group]++;
-        }
-        return spectrum;
+        return std::vector<double>(_spectrum.begin(), _spectrum.end());
     }
 
-    const std::vector<unsigned int> &get_population_history() const
+    // The spectrum and the interaction counts, for the whole mesh. Both are kept
+    // up to date as particles are born, collide and die, so this costs the same
+    // whatever the size of the population, and it doesn't allocate.
+    struct Statistics {
+        std::array<double, Source::N_GROUPS> spectrum;
+        // Scatter, capture, fission and leak, as in get_interaction_counts()
+        std::array<double, 4> interactions;
+    };
+
+    Statistics statistics() const
     {
-        return _population_history;
+        return {_spectrum, {_n_scatter, _n_capture, _n_fission, _n_leak}};
+    }
+
+    const History &history(HistorySeries series) const
+    {
+        return _histories[static_cast<int>(series)];
+    }
+
+    const History &get_population_history() const
+    {
+        return history(HistorySeries::POPULATION);
     }
 
 private:
+    using Histories = std::array<History, static_cast<size_t>(HistorySeries::N_SERIES)>;
+
+    // Everything needed to pick up the simulation from a given point
+    struct Keyframe {
+        unsigned int elapsed;
+        unsigned int time_step;
+        std::vector<Particle> particles;
+        uint64_t next_id;
+        std::vector<unsigned int> generation_born;
+        std::vector<unsigned int> generation_population;
+        unsigned int first_generation;
+        History retired_born;
+        double born_from_fission;
+        Histories histories;
+        size_t since_last_command;
+        size_t next_command;
+        size_t playbook_cursor;
+        std::shared_ptr<const Mesh> mesh;
+        // Shared with the State, so that it gets cloned before any further edits
+        std::shared_ptr<Mesh> next_mesh;
+        bool resample_pending;
+        BoundaryCondition bc;
+        std::default_random_engine random;
+        std::optional<Vec2> source;
+        uint64_t injected_draws;
+        uint64_t source_draws;
+        std::vector<FissionSite> held_sites;
+        PinType current_pin_type;
+        double n_capture;
+        double n_fission;
+        double n_scatter;
+        double n_leak;
+        double n_born;
+        std::array<double, Source::N_GROUPS> spectrum;
+    };
+
+    // Output of advancing one chunk of the population through a tic
+    struct TicChunk {
+        // Particles that move on to the next tic, in order
+        std::vector<Particle> out;
+        // Particles that reached their collision site this tic
+        std::vector<Particle> collided;
+        // The chunk's particles, moved out of the population, and what happened
+        // to each of them
+        std::vector<Particle> moving;
+        std::vector<uint8_t> status;
+        // Where fission sites produced by the chunk go
+        FissionBank::SubBank *bank = nullptr;
+        // Changes to the per-generation tallies
+        std::vector<int> born;
+        std::vector<int> population;
+        // Change in the weight of each energy group
+        std::array<double, Source::N_GROUPS> spectrum;
+
+        double n_capture = 0.0;
+        double n_fission = 0.0;
+        double n_scatter = 0.0;
+        double n_leak    = 0.0;
+    };
+
     Particle _new_particle(Vec2 location) const;
+    Particle _new_particle(Vec2 location, std::default_random_engine &random) const;
+    Particle _new_particle(Vec2 location, float angle) const;
+
+    // Everything tic() does, short of preparing the results for display
+    void _step();
+
+    // The pool to spread work over, starting the default one if need be, or null
+    // to do it all on this thread
+    ThreadPool *_thread_pool();
+
+    void _save_keyframe();
+    void _restore_keyframe(const Keyframe &keyframe);
+
+    // Transport a particle, recording waypoints if they are being drawn
+    void _transport(Particle &p, std::default_random_engine &random,
+                    std::optional<float> first_flight = std::nullopt) const;
+
+    // Advance particles [begin, end) of the current population through a tic.
+    // There is one of these for each combination of boundary condition and
+    // bookkeeping options, so that none of them has to check the options for
+    // every particle; _select_kernel() picks one once per tic. The particles are
+    // moved out of the population, leaving it without its waypoints.
+    template <BoundaryCondition BC, bool WAYPOINTS, bool GENERATIONS>
+    void _advance_chunk(size_t begin, size_t end, TicChunk &chunk,
+                        std::default_random_engine &random);
+
+    using AdvanceKernel = void (State::*)(size_t, size_t, TicChunk &,
+                                          std::default_random_engine &);
+    AdvanceKernel _select_kernel() const;
+
+    // Sample a particle interaction, putting whatever comes out of it into the
+    // chunk
+    template <bool WAYPOINTS, bool GENERATIONS>
+    void _interact(Particle &p, TicChunk &chunk,
+                   std::default_random_engine &random) const;
+
+    // Collect the output of all chunks into the next population
+    void _merge_chunks(size_t n_chunks);
+
+    // Make n particles from a source, in blocks of TIC_CHUNK_SIZE, and append
+    // them to _particles. Ids start at first_id, and Halton points at
+    // first_point. Particles that would start outside of the mesh or the
+    // subdomain are dropped.
+    void _spawn_from_source(const Source &source, size_t n, uint64_t first_id,
+                            uint64_t first_point);
+
+    // Add n particles drawn from a source, counting them in its draws
+    void _add_particles(const Source &source, size_t n, uint64_t &draws);
+
+    // Turn banked fission sites into particles, appending them to
+    // _back_particles
+    void _spawn_daughters(const std::vector<FissionSite> &sites);
+
+    // Bring the number of particles back to the target, if there is one
+    void _control_population();
+
+    // Where the counts of a generation are kept. Those of retired generations
+    // count in the oldest one still kept.
+    size_t _generation_index(unsigned int generation) const
+    {
+        return generation < _first_generation ? 0 : generation - _first_generation;
+    }
 
-    const Color PARTICLE_DEST_COLOR{0.0f, 0.0f, 1.0f, 1.0f};
-    const Color PIN_COLOR{0.3f, 0.0f, 0.0f, 1.0f};
-    const Color MODERATOR_COLOR{0.0f, 0.1f, 0.3f, 1.0f};
-    const int NPINS_X         = 17;
-    const int NPINS_Y         = 17;
-    const float PIN_RADIUS    = 0.4f;
-    const float PIN_PITCH     = 1.0f;
-    const size_t MAX_POP_HIST = 1000;
+    // Move the generations that can no longer change out of the counts
+    void _retire_generations();
+
+    // Roulette and split particles whose weights are out of their windows
+    void _apply_weight_windows();
+
+    // Put n_copies of a particle, each of the given weight, in _back_particles.
+    // All but one of them get new ids. Keeps the generation tallies up to date.
+    void _keep_copies(Particle &p, size_t n_copies, float weight);
+
+    // Log the tic that has just ended to the histories
+    void _record_history();
+
+    // Fill the spectrum and render buffers from the current population. This only
+    // reads the population, so it may run alongside _advance_chunk(), as long as
+    // the waypoints aren't being drawn.
+    void _summarize();
+
+    static constexpr Color FUEL_COLOR{0.4f, 0.0f, 0.0f, 1.0f};
+    static constexpr Color MODERATOR_COLOR{0.0f, 0.1f, 0.3f, 1.0f};
+    static constexpr int NPINS_X      = 17;
+    static constexpr int NPINS_Y      = 17;
+    static constexpr float PIN_RADIUS = 0.4f;
+    static constexpr float PIN_PITCH  = 1.0f;
+    // Number of particles handled together by a worker during a tic. This is
+    // fixed, rather than derived from the number of threads, so that results
+    // don't depend on how many threads there are.
+    const size_t TIC_CHUNK_SIZE = 512;
+    // Without anything else to control weights, survival biased particles lighter
+    // than the cutoff play roulette for the survival weight
+    const float WEIGHT_CUTOFF   = 0.25f;
+    const float WEIGHT_SURVIVAL = 1.0f;
+    // Fission yields either two or three neutrons, with equal probability
+    const float MEAN_NU = 2.5f;
+    // Tics between keyframes, to start with, and how many keyframes to keep. Once
+    // there are too many, every other one is dropped and the interval doubles.
+    const unsigned int KEYFRAME_INTERVAL = 500;
+    const size_t MAX_KEYFRAMES           = 64;
 
     const std::vector<Color> _particle_colors;
 
@@ -145,56 +693,139 @@ private:
 	// "Back" set of particles. Fission neutrons are born in here, surviving particles stashed here as well. swap at end of tic()
     std::vector<Particle> _back_particles;
 
-	// Collection of indices into _particles which need to process a collision
-    // this time step.
+    // Per-chunk output of the current tic.
     // Kept as object state to prevent reallocation.
-    std::vector<size_t> _process_queue;
+    std::vector<TicChunk> _chunks;
+
+    // Fission sites banked during the current tic, and the particles made from
+    // them
+    FissionBank _fission_bank;
+    std::vector<std::vector<Particle>> _daughter_blocks;
+    // Sites kept back from the population, if they are being held
+    bool _hold_fission_sites = false;
+    std::vector<FissionSite> _held_sites;
+    std::shared_ptr<MeshTally> _tally;
+    uint64_t _first_id = 0;
+    uint64_t _next_id  = 0;
+
+    // Part of the domain owned by this State, if it is one of several
+    std::optional<Rect> _subdomain = std::nullopt;
 
     // Total number of particles born into each generation
     std::vector<unsigned int> _generation_born;
     // Total number of particles remaining in each generation
     std::vector<unsigned int> _generation_population;
-    // Population history by time step. Only store a certain number of time steps
-    std::vector<unsigned int> _population_history;
-    // Log history every n time steps. This will grow to keep the number of history
-    // values bounded
-    unsigned int _history_resolution = 1;
-    unsigned int _time_step          = 0;
-    size_t _since_last_command       = 0;
-    size_t _next_command             = 0;
-
-    MaterialLibrary _materials;
-    Mesh _mesh;
+    // Generation of the first entry of the two above, and the number born into
+    // each of the ones before it
+    unsigned int _first_generation = 0;
+    History _retired_born;
+    double _born_from_fission = 0.0;
+    // History of each series, by time step
+    Histories _histories;
+    unsigned int _time_step    = 0;
+    unsigned int _elapsed      = 0;
+    size_t _since_last_command = 0;
+    size_t _next_command       = 0;
+
+    std::shared_ptr<const MaterialLibrary> _materials;
+    // Mesh used by the transport. Only replaced as a whole, at tic boundaries
+    std::shared_ptr<const Mesh> _mesh;
+    // Pending version of the mesh, collecting edits made since the last tic
+    std::shared_ptr<Mesh> _next_mesh;
+    // Whether the pending edits require re-transporting the population
+    bool _resample_pending = false;
+    mutable std::mutex _edit_mutex;
     Box _boundary;
     BoundaryCondition _bc = BoundaryCondition::VACUUM;
-
-    // RNG stuff
+    PopulationControl _population_control = PopulationControl::NONE;
+    size_t _population_target             = 0;
+    bool _implicit_capture                = false;
+    std::shared_ptr<const WeightWindows> _weight_windows;
+
+    // RNG stuff. _random is used for work done outside of tic(); each chunk of a
+    // tic gets its own engine, seeded from _seed, the time step and the chunk.
+    unsigned int _seed = 0;
     mutable std::default_random_engine _random;
-    mutable std::uniform_real_distribution<float> _angle_distribution;
-    std::uniform_real_distribution<float> _unit_distribution;
+    std::uniform_real_distribution<float> _angle_distribution;
+    // Points for quasi-random sampling, if it's on. The source takes the first
+    // dimensions, followed by the direction and the first flight.
+    std::shared_ptr<const HaltonSequence> _halton;
+    static constexpr int QMC_ANGLE        = Source::N_SAMPLE_DIMENSIONS;
+    static constexpr int QMC_FLIGHT       = QMC_ANGLE + 1;
+    static constexpr int N_QMC_DIMENSIONS = QMC_FLIGHT + 1;
+
+    // Saved points to seek back to, in order
+    std::vector<Keyframe> _keyframes;
+    unsigned int _keyframe_interval = KEYFRAME_INTERVAL;
+    bool _keyframing                = false;
+    // Set while seeking, to skip preparing the render buffers every tic
+    bool _headless = false;
 
     // Drawing settings
-    Ortho2D projection_matrix;
     bool _draw_waypoints = false;
     bool _paused         = true;
     bool _labels         = false;
 
+    bool _track_generations = true;
+
     // Optional playbook
     std::unique_ptr<Playbook> _playbook;
 
     std::unordered_map<PinType, std::tuple<Color, const Material *>> _pin_types;
 
     std::optional<Vec2> _source = std::nullopt;
+    // Halton points taken so far by particles added from outside, and by the
+    // source that adds one every tic
+    uint64_t _injected_draws = 0;
+    uint64_t _source_draws   = 0;
+
+    std::shared_ptr<ThreadPool> _pool;
+    // Whether _pool has been set, or made, so that a null one means no pool
+    bool _pool_chosen = false;
+
+    // Weight of the population in each energy group, kept up to date by
+    // everything that adds, removes or reweights particles
+    std::array<double, Source::N_GROUPS> _spectrum = {};
+
+    // Render buffers, as prepared by _summarize()
+    std::vector<ParticleVertex> _render_particles;
+    std::vector<Vec2> _render_waypoints;
 
     Ortho2D _projection_matrix;
 
     // Interaction histories
-    unsigned int _n_capture = 0;
-    unsigned int _n_fission = 0;
-    unsigned int _n_scatter = 0;
-    unsigned int _n_leak    = 0;
+    double _n_capture = 0.0;
+    double _n_fission = 0.0;
+    double _n_scatter = 0.0;
+    double _n_leak    = 0.0;
+    // Weight born from fission
+    double _n_born = 0.0;
+    // The counters, from scatter to born, as they were when the histories last
+    // took a sample, to tell how much they changed over the tic
+    std::array<double, 5> _recorded_counts = {};
 
     PinType _current_pin_type = PinType::FUEL;
 
-    void _resample_population();
+
+    // Work out how many of the particles in each generation are still around,
+    // in whole-mesh terms
+    void _recount_generations();
+    // Count the spectrum over again, after the population changes as a whole
+    void _recount_spectrum();
+
+    // Move the population over to a new symmetry, after a mesh with a different
+    // symmetry has been swapped in
+    void _change_symmetry(const Mesh &previous);
+
+    // Return the pending version of the mesh, creating it if necessary. Must be
+    // called with _edit_mutex held.
+    Mesh &_edit_mesh();
+
+    // Set the material of a list of regions, and of their mirror images. Must be
+    // called with _edit_mutex held.
+    void _set_regions(Mesh &mesh, const std::vector<size_t> &regions,
+                      PinType material);
+
+    // Swap in the pending version of the mesh, re-transporting if needed
+    void _commit_mesh();
 };
@@ -0,0 +1,120 @@
+#include "sweep.h"
+
+#include <algorithm>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+
+#include "state.h"
+
+Sweep::Sweep(const std::string &grid_fname, std::shared_ptr<const Playbook> base)
+    : _base(std::move(base))
+{
+    std::ifstream in_file(grid_fname);
+    if (!in_file.good()) {
+        std::stringstream msg;
+        msg << "Failed to open sweep grid file: " << grid_fname;
+        throw msg.str();
+    }
+
+    while (in_file.good()) {
+        std::string line_src;
+        std::getline(in_file, line_src);
+
+        std::stringstream line(line_src);
+        std::string axis_name;
+        line >> axis_name;
+        if (axis_name.empty() || axis_name[0] == '#') {
+            continue;
+        }
+
+        Option option;
+        line >> option.label;
+        if (option.label.empty()) {
+            std::stringstream msg;
+            msg << "Missing option label for sweep axis: " << axis_name;
+            throw msg.str();
+        }
+
+        // Turn the commands into a playbook that runs them all at once
+        std::stringstream commands;
+        std::string command;
+        while (std::getline(line, command, ';')) {
+            commands << "0 " << command << "\n";
+        }
+        option.setup = std::make_shared<const Playbook>(commands);
+
+        auto axis = std::find_if(_axes.begin(), _axes.end(),
+                                 [&](const Axis &a) { return a.name == axis_name; });
+        if (axis == _axes.end()) {
+            _axes.push_back(Axis{axis_name, {}});
+            axis = _axes.end() - 1;
+        }
+        axis->options.push_back(std::move(option));
+    }
+
+    _materials = std::make_shared<const MaterialLibrary>(C5G7());
+    _mesh      = State::make_lattice(*_materials);
+    return;
+}
+
+size_t Sweep::size() const
+{
+    size_t n = 1;
+    for (const auto &axis : _axes) {
+        n *= axis.options.size();
+    }
+    return n;
+}
+
+std::vector<size_t> Sweep::_options(size_t variant) const
+{
+    // The last axis varies fastest, like nested loops in the order of the file
+    std::vector<size_t> options(_axes.size());
+    for (size_t i = _axes.size(); i-- > 0;) {
+        size_t n_options = _axes[i].options.size();
+        options[i]       = variant % n_options;
+        variant /= n_options;
+    }
+    return options;
+}
+
+std::vector<std::string> Sweep::labels(size_t variant) const
+{
+    auto options = _options(variant);
+    std::vector<std::string> labels;
+    labels.reserve(_axes.size());
+    for (size_t i = 0; i < _axes.size(); ++i) {
+        labels.push_back(_axes[i].options[options[i]].label);
+    }
+    return labels;
+}
+
+void Sweep::run(size_t n_tics, unsigned int seed, ThreadPool &pool,
+                const ResultCallback &on_result) const
+{
+    std::mutex result_mutex;
+
+    pool.parallel_for(size(), [&](size_t variant) {
+        State state(_materials, _mesh);
+        // Variants already run in parallel with each other
+        state.set_thread_pool(nullptr);
+        // Every variant sees the same random numbers, so that differences
+        // between them come from the parameters rather than from the noise
+        state.set_seed(seed);
+        state.set_playbook(std::make_unique<Playbook>(*_base));
+
+        auto options = _options(variant);
+        for (size_t i = 0; i < _axes.size(); ++i) {
+            _axes[i].options[options[i]].setup->apply_all(&state);
+        }
+
+        state.advance(static_cast<unsigned int>(n_tics));
+
+        Result result{variant, labels(variant), state.population(),
+                      state.get_interaction_counts()};
+
+        std::lock_guard<std::mutex> lock(result_mutex);
+        on_result(result);
+    });
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "materials.h"
+#include "mesh.h"
+#include "playbook.h"
+#include "thread_pool.h"
+
+// A parameter sweep over variants of one problem. The grid file lists the
+// options along each axis, one per line:
+//
+//   <axis> <label> [<command> [; <command> ...]]
+//
+// where the commands use the playbook syntax, without the number of tics. Lines
+// naming the same axis add options to it, and the variants are every
+// combination of one option from each axis. A variant starts from the shared
+// lattice, gets the base playbook, then has the commands of its options applied
+// once before the first tic. For example:
+//
+//   boundary vacuum
+//   boundary reflective toggle_boundary
+//   center   fuel
+//   center   control set_material 8.5 8.5 control
+//
+// gives four variants. The variants share the materials and the shapes of the
+// geometry. A variant whose commands edit the mesh gets its own copy of the
+// color and material of every region, which is small next to the shapes.
+class Sweep {
+public:
+    struct Option {
+        std::string label;
+        std::shared_ptr<const Playbook> setup;
+    };
+
+    struct Axis {
+        std::string name;
+        std::vector<Option> options;
+    };
+
+    struct Result {
+        size_t variant;
+        std::vector<std::string> labels;
+        size_t population;
+        // In the same order as State::get_interaction_counts()
+        std::vector<double> interaction_counts;
+    };
+
+    using ResultCallback = std::function<void(const Result &)>;
+
+    Sweep(const std::string &grid_fname, std::shared_ptr<const Playbook> base);
+
+    const std::vector<Axis> &axes() const
+    {
+        return _axes;
+    }
+
+    // Number of variants in the grid
+    size_t size() const;
+
+    // Labels of the option taken along each axis by a variant
+    std::vector<std::string> labels(size_t variant) const;
+
+    // Run every variant for n_tics with the given seed, spread across the pool.
+    // on_result is called once per variant, as soon as it finishes, and never
+    // from two threads at once.
+    void run(size_t n_tics, unsigned int seed, ThreadPool &pool,
+             const ResultCallback &on_result) const;
+
+private:
+    // Index of the option taken along each axis by a variant
+    std::vector<size_t> _options(size_t variant) const;
+
+    std::vector<Axis> _axes;
+    std::shared_ptr<const Playbook> _base;
+    std::shared_ptr<const MaterialLibrary> _materials;
+    std::shared_ptr<const Mesh> _mesh;
+};
@@ -0,0 +1,224 @@
+#include "tally.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <utility>
+
+#include "mesh.h"
+
+MeshTally::MeshTally(Rect bounds, size_t nx, size_t ny, int n_groups)
+    : _bounds(bounds),
+      _nx(nx),
+      _ny(ny),
+      _n_groups(n_groups),
+      _cell_size(n_groups * N_SCORES)
+{
+    if (nx == 0 || ny == 0 || n_groups <= 0) {
+        throw std::string("A mesh tally needs cells and energy groups");
+    }
+    _batch.resize(_nx * _ny * _cell_size);
+    _stats.resize(_nx * _ny * (_n_groups + 1) * N_SCORES);
+    return;
+}
+
+void MeshTally::score(Vec2 start, Vec2 direction, float length,
+                      const Material &material, int e_group, float weight)
+{
+    // Clip the flight to the mesh, as a range of distances along it
+    float t_in  = 0.0f;
+    float t_out = length;
+    auto clip   = [&](float p, float d, float lo, float hi) {
+        if (d == 0.0f) {
+            return p >= lo && p <= hi;
+        }
+        float t0 = (lo - p) / d;
+        float t1 = (hi - p) / d;
+        t_in     = std::max(t_in, std::min(t0, t1));
+        t_out    = std::min(t_out, std::max(t0, t1));
+        return true;
+    };
+    if (!clip(start.x, direction.x, _bounds.lo.x, _bounds.hi.x) ||
+        !clip(start.y, direction.y, _bounds.lo.y, _bounds.hi.y) || t_in >= t_out) {
+        return;
+    }
+
+    float cell_w = (_bounds.hi.x - _bounds.lo.x) / _nx;
+    float cell_h = (_bounds.hi.y - _bounds.lo.y) / _ny;
+
+    // Walk the cells along the flight, one boundary crossing at a time
+    Vec2 entry   = start + direction * t_in;
+    auto ix      = static_cast<long>((entry.x - _bounds.lo.x) / cell_w);
+    auto iy      = static_cast<long>((entry.y - _bounds.lo.y) / cell_h);
+    ix           = std::clamp<long>(ix, 0, _nx - 1);
+    iy           = std::clamp<long>(iy, 0, _ny - 1);
+    long step_x  = direction.x > 0.0f ? 1 : -1;
+    long step_y  = direction.y > 0.0f ? 1 : -1;
+    auto next_at = [&](long i, long step, float lo, float size, float p, float d) {
+        if (d == 0.0f) {
+            return std::numeric_limits<float>::max();
+        }
+        float edge = lo + (i + (step > 0 ? 1 : 0)) * size;
+        return (edge - p) / d;
+    };
+    float next_x = next_at(ix, step_x, _bounds.lo.x, cell_w, start.x, direction.x);
+    float next_y = next_at(iy, step_y, _bounds.lo.y, cell_h, start.y, direction.y);
+    float dt_x   = direction.x != 0.0f ? cell_w / std::abs(direction.x)
+                                       : std::numeric_limits<float>::max();
+    float dt_y   = direction.y != 0.0f ? cell_h / std::abs(direction.y)
+                                       : std::numeric_limits<float>::max();
+
+    double *buffer = _local_buffer();
+    float xsa      = material.xsab[e_group];
+    float xsf      = material.xsf[e_group];
+    float xst      = material.xstr[e_group];
+    float t        = t_in;
+    while (t < t_out) {
+        float t_next = std::min({next_x, next_y, t_out});
+        float track  = weight * std::max(0.0f, t_next - t);
+
+        double *bin = buffer + (iy * _nx + ix) * _cell_size + e_group * N_SCORES;
+        bin[static_cast<int>(Score::FLUX)] += track;
+        bin[static_cast<int>(Score::ABSORPTION)] += track * xsa;
+        bin[static_cast<int>(Score::FISSION)] += track * xsf;
+        bin[static_cast<int>(Score::TOTAL)] += track * xst;
+
+        t = t_next;
+        if (t >= t_out) {
+            break;
+        }
+
+        // Into the next cell, through a face that belongs to the cell on its left
+        // or below it
+        long face_x = ix;
+        long face_y = iy;
+        int current = static_cast<int>(Score::CURRENT_X);
+        long step   = step_x;
+        if (next_x <= next_y) {
+            face_x = step_x > 0 ? ix : ix - 1;
+            ix += step_x;
+            next_x += dt_x;
+        } else {
+            face_y  = step_y > 0 ? iy : iy - 1;
+            current = static_cast<int>(Score::CURRENT_Y);
+            step    = step_y;
+            iy += step_y;
+            next_y += dt_y;
+        }
+        if (ix < 0 || iy < 0 || ix >= long(_nx) || iy >= long(_ny)) {
+            break;
+        }
+        double *face = buffer + (face_y * _nx + face_x) * _cell_size;
+        face[e_group * N_SCORES + current] += step * weight;
+    }
+}
+
+void MeshTally::end_batch(double source, const Mesh &mesh)
+{
+    std::fill(_batch.begin(), _batch.end(), 0.0);
+    _buffers.for_each([this](std::vector<double> &buffer) {
+        for (size_t i = 0; i < _batch.size(); ++i) {
+            _batch[i] += buffer[i];
+            buffer[i] = 0.0;
+        }
+    });
+
+    // A flight in a sector stands for one in each of its mirror images, which
+    // land in the mirror images of the cells it crossed
+    const double *batch = _batch.data();
+    unsigned int m      = mesh.multiplicity();
+    if (m > 1) {
+        _unfolded.assign(_batch.size(), 0.0);
+        float cell_w = (_bounds.hi.x - _bounds.lo.x) / _nx;
+        float cell_h = (_bounds.hi.y - _bounds.lo.y) / _ny;
+        auto cell_of = [&](Vec2 p) {
+            float x = std::max(0.0f, (p.x - _bounds.lo.x) / cell_w);
+            float y = std::max(0.0f, (p.y - _bounds.lo.y) / cell_h);
+            return std::min(_ny - 1, size_t(y)) * _nx + std::min(_nx - 1, size_t(x));
+        };
+        for (size_t iy = 0; iy < _ny; ++iy) {
+            for (size_t ix = 0; ix < _nx; ++ix) {
+                Vec2 center{_bounds.lo.x + (ix + 0.5f) * cell_w,
+                            _bounds.lo.y + (iy + 0.5f) * cell_h};
+                double *cell = &_unfolded[(iy * _nx + ix) * _cell_size];
+                for (unsigned int i = 0; i < m; ++i) {
+                    size_t image       = cell_of(mesh.image_location(center, i));
+                    const double *from = &_batch[image * _cell_size];
+                    for (size_t k = 0; k < _cell_size; ++k) {
+                        if (k % N_SCORES < size_t(Score::CURRENT_X)) {
+                            cell[k] += from[k];
+                        }
+                    }
+                }
+            }
+        }
+        batch = _unfolded.data();
+    }
+
+    for (size_t cell = 0; cell < _nx * _ny; ++cell) {
+        const double *values    = batch + cell * _cell_size;
+        RunningStat *stats      = &_stats[cell * (_n_groups + 1) * N_SCORES];
+        double totals[N_SCORES] = {};
+        for (int g = 0; g < _n_groups; ++g) {
+            for (int s = 0; s < N_SCORES; ++s) {
+                double value = values[g * N_SCORES + s] / source;
+                stats[g * N_SCORES + s].add(value);
+                totals[s] += value;
+            }
+        }
+        for (int s = 0; s < N_SCORES; ++s) {
+            stats[_n_groups * N_SCORES + s].add(totals[s]);
+        }
+    }
+    _n_batches++;
+}
+
+void MeshTally::reset()
+{
+    std::fill(_stats.begin(), _stats.end(), RunningStat());
+    _n_batches = 0;
+}
+
+double MeshTally::relative_error(size_t ix, size_t iy, Score score, int group) const
+{
+    const RunningStat &stat = bin(ix, iy, score, group);
+    if (stat.count() < 2 || stat.mean() <= 0.0) {
+        return std::numeric_limits<double>::infinity();
+    }
+    return stat.std_error() / stat.mean();
+}
+
+double MeshTally::max_relative_error(Score score, int group) const
+{
+    if (_n_batches < 2) {
+        return std::numeric_limits<double>::infinity();
+    }
+
+    bool scored  = false;
+    double worst = 0.0;
+    for (size_t iy = 0; iy < _ny; ++iy) {
+        for (size_t ix = 0; ix < _nx; ++ix) {
+            if (bin(ix, iy, score, group).mean() <= 0.0) {
+                continue;
+            }
+            scored = true;
+            worst  = std::max(worst, relative_error(ix, iy, score, group));
+        }
+    }
+    return scored ? worst : std::numeric_limits<double>::infinity();
+}
+
+double MeshTally::max_relative_error(const std::vector<size_t> &cells, Score score,
+                                     int group) const
+{
+    if (_n_batches < 2 || cells.empty()) {
+        return std::numeric_limits<double>::infinity();
+    }
+
+    double worst = 0.0;
+    for (size_t cell : cells) {
+        worst = std::max(worst, relative_error(cell % _nx, cell / _nx, score, group));
+    }
+    return worst;
+}
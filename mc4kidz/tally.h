@@ -0,0 +1,136 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "materials.h"
+#include "per_thread.h"
+#include "running_stats.h"
+#include "simple_structs.h"
+
+class Mesh;
+
+// Track-length estimates of the flux and reaction rates on a regular mesh of
+// cells, in each energy group.
+//
+// Every straight flight a particle takes through the geometry is scored into the
+// cells it crosses, in proportion to the length it spends in each. Scoring is
+// done into a buffer that belongs to the scoring thread, so that the transport
+// doesn't contend over the tally. The buffers are added up at the end of each
+// batch, which gives one sample of every bin, and the bins are reported as the
+// mean over the batches along with its relative error.
+//
+// Besides reaction rates in the cells, the tally keeps the net current through
+// the right and top faces of each cell, that is the weight crossing them to the
+// right or up less the weight crossing them the other way. Faces on the edge of
+// the mesh aren't scored. Currents can't be unfolded from a sector, so they stay
+// at zero for a mesh that only simulates one.
+//
+// Flights are scored as soon as they are sampled, so a tally should only be fed
+// by a simulation that is left to run its flights out, without edits, resampling
+// or seeking in between.
+class MeshTally {
+public:
+    enum class Score : uint8_t {
+        FLUX,
+        ABSORPTION,
+        FISSION,
+        // Collision rate
+        TOTAL,
+        CURRENT_X,
+        CURRENT_Y
+    };
+    static constexpr int N_SCORES = 6;
+    // Group to ask for to get a sum over all of the groups
+    static constexpr int ALL_GROUPS = -1;
+
+    MeshTally(Rect bounds, size_t nx, size_t ny, int n_groups);
+
+    MeshTally(const MeshTally &) = delete;
+    MeshTally &operator=(const MeshTally &) = delete;
+
+    // Score a flight of a particle of some weight in energy group e_group through
+    // a material. Parts of the flight outside of the mesh are ignored. Safe to call
+    // from several threads at once.
+    void score(Vec2 start, Vec2 direction, float length, const Material &material,
+               int e_group, float weight);
+
+    // Close a batch, adding up what the threads scored since the last one. The
+    // batch is normalized per particle of source. If the mesh only simulates a
+    // sector, the cells are unfolded to the whole mesh. Must not be called while
+    // anything is being scored.
+    void end_batch(double source, const Mesh &mesh);
+
+    // Forget every batch so far
+    void reset();
+
+    size_t n_batches() const
+    {
+        return _n_batches;
+    }
+
+    Rect bounds() const
+    {
+        return _bounds;
+    }
+
+    size_t nx() const
+    {
+        return _nx;
+    }
+
+    size_t ny() const
+    {
+        return _ny;
+    }
+
+    int n_groups() const
+    {
+        return _n_groups;
+    }
+
+    // Statistics of a bin over the batches
+    const RunningStat &bin(size_t ix, size_t iy, Score score,
+                           int group = ALL_GROUPS) const
+    {
+        size_t g = group == ALL_GROUPS ? _n_groups : group;
+        return _stats[((iy * _nx + ix) * (_n_groups + 1) + g) * N_SCORES +
+                      static_cast<int>(score)];
+    }
+
+    // Standard error of a bin's mean over the mean itself. Infinite for bins with
+    // fewer than two batches or nothing scored.
+    double relative_error(size_t ix, size_t iy, Score score,
+                          int group = ALL_GROUPS) const;
+
+    // The largest relative error of the bins that have scored anything, which is
+    // how far the tally is from being converged
+    double max_relative_error(Score score, int group = ALL_GROUPS) const;
+
+    // The largest relative error of some of the cells, each given as iy * nx() + ix
+    double max_relative_error(const std::vector<size_t> &cells, Score score,
+                              int group = ALL_GROUPS) const;
+
+private:
+    // The calling thread's buffer, set up on first use
+    double *_local_buffer()
+    {
+        return _buffers.local([this]() { return std::vector<double>(_batch.size()); })
+            .data();
+    }
+
+    Rect _bounds;
+    size_t _nx;
+    size_t _ny;
+    int _n_groups;
+    // Values in the buffers of each cell, one per group and score
+    size_t _cell_size;
+
+    PerThread<std::vector<double>> _buffers;
+    // Scratch space for adding up a batch
+    std::vector<double> _batch;
+    std::vector<double> _unfolded;
+
+    size_t _n_batches = 0;
+    // Per cell, per group and then the sum over groups, per score
+    std::vector<RunningStat> _stats;
+};
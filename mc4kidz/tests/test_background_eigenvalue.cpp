@@ -0,0 +1,64 @@
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include "background_eigenvalue.h"
+#include "particle.h"
+#include "state.h"
+
+// Wait for the estimate to have some active generations behind it
+static BackgroundEigenvalue::Estimate wait_for(const BackgroundEigenvalue &estimator,
+                                               size_t n_active)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+    while (std::chrono::steady_clock::now() < deadline) {
+        auto estimate = estimator.estimate();
+        if (estimate.n_active >= n_active || estimate.failed) {
+            return estimate;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    assert(false && "no estimate in time");
+    return {};
+}
+
+int main()
+{
+    // How far particles get in a tic makes next to no difference to where they
+    // collide, so they are sped up to get through a generation in fewer tics
+    Particle::base_speed = 0.25f;
+
+    State state;
+    state.set_thread_pool(nullptr);
+
+    auto settings           = BackgroundEigenvalue::small_batches();
+    settings.n_particles    = 100;
+    settings.min_inactive   = 2;
+    settings.entropy_window = 2;
+    BackgroundEigenvalue estimator(settings);
+    estimator.follow(state);
+    auto leaky = wait_for(estimator, 2);
+    assert(!leaky.failed);
+    assert(leaky.k > 0.0 && leaky.std_error > 0.0);
+
+    // Following the same geometry again keeps what has been learned
+    estimator.follow(state);
+    assert(estimator.estimate().n_active >= 2);
+
+    // Reflecting the neutrons back in starts over, and gives a higher k
+    state.set_boundary_condition(BoundaryCondition::REFLECTIVE);
+    estimator.follow(state);
+    assert(estimator.estimate().n_active == 0);
+    auto reflected = wait_for(estimator, 2);
+    assert(reflected.k > leaky.k);
+
+    // So does an edit, as soon as it is shown, before any tic takes it up
+    state.set_material_in_rect(Rect{Vec2{0.0f, 0.0f}, Vec2{8.0f, 8.0f}}, PinType::VOID);
+    estimator.follow(state);
+    assert(estimator.estimate().n_active == 0);
+    assert(!wait_for(estimator, 1).failed);
+
+    std::cout << "background eigenvalue ok\n";
+    return 0;
+}
@@ -0,0 +1,86 @@
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "cmfd.h"
+#include "materials.h"
+#include "mesh.h"
+
+static bool close(double a, double b)
+{
+    return std::abs(a - b) < 1e-5 * std::max(1.0, std::abs(b));
+}
+
+static FissionSite site_at(Vec2 location, const Material *material, float weight)
+{
+    FissionSite site;
+    site.location = location;
+    site.material = material;
+    site.parent   = 0;
+    site.weight   = weight;
+    return site;
+}
+
+int main()
+{
+    MaterialLibrary materials = C5G7();
+    const Material &fuel      = materials.get_by_name("UO2");
+    Mesh mesh(3.0f, 3.0f, &fuel, Color{0.0f, 0.0f, 0.0f, 1.0f});
+    Rect bounds{Vec2{0.0f, 0.0f}, Vec2{3.0f, 3.0f}};
+
+    // Every cell of a uniform infinite medium sees the same: a flight that stays
+    // inside of it, as much weight starting as is absorbed, and the neutrons from
+    // the fissions banked. There are no currents, so k is that of the medium.
+    Cmfd cmfd(bounds, 3, 3, 1);
+    double absorption = 0.5 * fuel.xsab[0];
+    double production = 2.5 * 0.5 * fuel.xsf[0];
+    float quarter     = static_cast<float>(production / 4);
+    std::vector<Particle> particles;
+    std::vector<FissionSite> banked;
+    for (int iy = 0; iy < 3; ++iy) {
+        for (int ix = 0; ix < 3; ++ix) {
+            Vec2 center{ix + 0.5f, iy + 0.5f};
+            particles.emplace_back(center, Vec2{1.0f, 0.0f});
+            particles.back().weight = static_cast<float>(absorption);
+            // Split over a couple of sites, to show it is their total that counts
+            banked.push_back(site_at(center, &fuel, quarter));
+            banked.push_back(site_at(center, &fuel, 3 * quarter));
+        }
+    }
+    cmfd.start_generation(particles);
+    for (const auto &p : particles) {
+        Vec2 start = p.location - Vec2{0.25f, 0.0f};
+        cmfd.tally()->score(start, p.direction, 0.5f, fuel, 0, 1.0f);
+    }
+    double k = cmfd.end_generation(banked, mesh);
+    assert(close(k, production / absorption));
+
+    // Reweighting moves the weight to where the solution has it, here the same in
+    // every cell with sites, and keeps the total
+    std::vector<FissionSite> sites;
+    sites.push_back(site_at(Vec2{0.5f, 0.5f}, &fuel, 1.0f));
+    sites.push_back(site_at(Vec2{0.6f, 0.4f}, &fuel, 1.0f));
+    sites.push_back(site_at(Vec2{0.4f, 0.6f}, &fuel, 2.0f));
+    sites.push_back(site_at(Vec2{1.5f, 0.5f}, &fuel, 0.5f));
+    sites.push_back(site_at(Vec2{2.5f, 2.5f}, &fuel, 0.25f));
+    double before = 0.0;
+    for (const auto &site : sites) {
+        before += site.weight;
+    }
+    cmfd.reweight(sites);
+    double after = 0.0;
+    for (const auto &site : sites) {
+        after += site.weight;
+    }
+    assert(close(after, before));
+    double first_cell = sites[0].weight + sites[1].weight + sites[2].weight;
+    assert(close(first_cell, before / 3));
+    assert(close(sites[3].weight, before / 3));
+    assert(close(sites[4].weight, before / 3));
+    // Sites in the same cell keep their weights relative to each other
+    assert(close(sites[2].weight, 2.0 * sites[0].weight));
+
+    std::cout << "cmfd ok\n";
+    return 0;
+}
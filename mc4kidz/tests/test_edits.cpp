@@ -0,0 +1,168 @@
+#include <cassert>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "materials.h"
+#include "mesh.h"
+#include "pin_types.h"
+#include "playbook.h"
+#include "shapes.h"
+#include "source.h"
+#include "state.h"
+#include "tally.h"
+#include "thread_pool.h"
+
+using Pattern = std::vector<std::vector<std::optional<PinType>>>;
+
+// The material of every region of what the state shows, then the background
+static std::vector<const Material *> materials_of(const State &state)
+{
+    auto mesh = state.displayed_mesh();
+    std::vector<const Material *> materials;
+    for (size_t i = 0; i < mesh->n_regions(); ++i) {
+        materials.push_back(mesh->region_material(i));
+    }
+    materials.push_back(mesh->get_material(Vec2{0.0f, 0.0f}));
+    return materials;
+}
+
+static size_t count(const Pattern &pattern, PinType type)
+{
+    size_t n = 0;
+    for (const auto &row : pattern) {
+        for (const auto &pin : row) {
+            n += pin == type;
+        }
+    }
+    return n;
+}
+
+int main()
+{
+    auto materials = std::make_shared<const MaterialLibrary>(C5G7());
+
+    // Pins are given by their index from the lower left, and ones off the
+    // lattice are ignored
+    {
+        State state(materials);
+        state.set_thread_pool(nullptr);
+        state.set_material_at_pins({{0, 0}, {16, 16}, {17, 3}, {-1, 0}},
+                                   PinType::BLACK);
+        Pattern pattern = state.pin_pattern();
+        assert(pattern.size() == 17 && pattern[0].size() == 17);
+        assert(pattern[16][0] == PinType::BLACK);
+        assert(pattern[0][16] == PinType::BLACK);
+        assert(count(pattern, PinType::BLACK) == 2);
+    }
+
+    // Patterns go from the top row down, leaving alone the pins without a value
+    // and those past the end of the rows
+    {
+        State state(materials);
+        state.set_thread_pool(nullptr);
+        Pattern before = state.pin_pattern();
+        state.set_pin_pattern(
+            {{PinType::MODERATOR, std::nullopt, PinType::VOID}, {}, {PinType::BLACK}});
+        Pattern after = state.pin_pattern();
+        assert(after[0][0] == PinType::MODERATOR);
+        assert(after[0][1] == before[0][1]);
+        assert(after[0][2] == PinType::VOID);
+        assert(after[1] == before[1]);
+        assert(after[2][0] == PinType::BLACK);
+        assert(after[2][1] == before[2][1]);
+        assert(count(after, PinType::BLACK) == count(before, PinType::BLACK) + 1);
+
+        // Setting the pattern a state shows gives back the same mesh
+        auto shown = materials_of(state);
+        state.set_pin_pattern(after);
+        assert(materials_of(state) == shown);
+    }
+
+    // The lattice comes from the mesh, whatever its size
+    {
+        Color black           = {0.0f, 0.0f, 0.0f, 1.0f};
+        const Material *water = &materials->get_by_name("Moderator");
+        const Material *fuel  = &materials->get_by_name("UO2");
+        auto mesh             = std::make_shared<Mesh>(6.0f, 4.0f, water, black);
+        for (int ix = 0; ix < 3; ++ix) {
+            for (int iy = 0; iy < 2; ++iy) {
+                Vec2 center{1.0f + 2.0f * ix, 1.0f + 2.0f * iy};
+                mesh->add_shape(std::make_unique<Circle>(black, center, 0.8f), fuel);
+            }
+        }
+        mesh->set_lattice(Mesh::Lattice{Vec2{0.0f, 0.0f}, 3, 2, 2.0f});
+
+        State state(materials, mesh);
+        state.set_thread_pool(nullptr);
+        state.set_material_at_pins({{2, 1}}, PinType::BLACK);
+        state.set_pin_pattern({{}, {PinType::VOID}});
+        Pattern pattern = state.pin_pattern();
+        assert(pattern.size() == 2 && pattern[0].size() == 3);
+        assert(pattern[0][2] == PinType::BLACK);
+        assert(pattern[1][0] == PinType::VOID);
+        assert(pattern[0][0] == PinType::FUEL);
+
+        // Without a lattice there are no pins to edit
+        auto loose = std::make_shared<Mesh>(6.0f, 4.0f, water, black);
+        loose->add_shape(std::make_unique<Circle>(black, Vec2{1.0f, 1.0f}, 0.8f), fuel);
+        State no_pins(materials, loose);
+        no_pins.set_thread_pool(nullptr);
+        no_pins.set_material_at_pins({{0, 0}}, PinType::BLACK);
+        assert(no_pins.pin_pattern().empty());
+        assert(no_pins.displayed_mesh()->region_material(0) == fuel);
+    }
+
+    // The demo written with bulk edits leaves the lattice the same as the one that
+    // sets pins one at a time, every time the demo waits
+    {
+        Playbook per_pin(std::string(TEST_DATA_DIR) + "/psc_demo.txt");
+        Playbook bulk(std::string(TEST_DATA_DIR) + "/psc_demo_bulk.txt");
+        State per_pin_state(materials);
+        State bulk_state(materials);
+        per_pin_state.set_thread_pool(nullptr);
+        bulk_state.set_thread_pool(nullptr);
+        for (int i = 0; i < 8; ++i) {
+            size_t wait = per_pin.execute_next(&per_pin_state);
+            assert(bulk.execute_next(&bulk_state) == wait);
+            assert(materials_of(per_pin_state) == materials_of(bulk_state));
+            assert(per_pin_state.boundary_condition() ==
+                   bulk_state.boundary_condition());
+        }
+    }
+
+    // Particles are sent on again after an edit the same way however many threads
+    // share the work, and the flights they are sent on aren't scored twice
+    {
+        auto edit = [&materials](std::shared_ptr<ThreadPool> pool) {
+            State state(materials);
+            state.set_thread_pool(pool);
+            state.set_seed(9);
+            state.add_particles(Source::box(Rect{Vec2{1.0f, 1.0f}, Vec2{16.0f, 16.0f}}),
+                                3000);
+            state.advance(5);
+            state.set_material_at_pins({{8, 8}, {4, 4}}, PinType::BLACK);
+            state.advance(5);
+            return state.get_interaction_counts();
+        };
+        assert(edit(nullptr) == edit(std::make_shared<ThreadPool>(4)));
+
+        State state(materials);
+        state.set_thread_pool(nullptr);
+        state.add_particles(Source::box(Rect{Vec2{1.0f, 1.0f}, Vec2{16.0f, 16.0f}}),
+                            500);
+        auto mesh  = state.displayed_mesh();
+        auto tally = std::make_shared<MeshTally>(
+            Rect{Vec2{0.0f, 0.0f}, Vec2{mesh->get_width(), mesh->get_height()}}, 1, 1,
+            Source::N_GROUPS);
+        state.set_tally(tally);
+        state.resample();
+        tally->end_batch(1.0, *mesh);
+        assert(tally->bin(0, 0, MeshTally::Score::FLUX).mean() == 0.0);
+    }
+
+    std::cout << "edits ok\n";
+    return 0;
+}
@@ -0,0 +1,116 @@
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "eigenvalue.h"
+#include "materials.h"
+#include "mesh.h"
+#include "particle.h"
+
+// k of an infinite medium of one material, as the simulation models it: every
+// fission gives 2.5 neutrons on average, all born in the first group. With f[g]
+// the chance that a neutron in group g goes on to cause a fission,
+//   f[g] = xsf[g] / xstr[g] + sum over g' of xssc(g', g) / xstr[g] * f[g'],
+// which is solved by iterating to a fixed point.
+static double infinite_medium_k(const Material &material)
+{
+    std::vector<double> f(material.ng, 0.0);
+    for (int iteration = 0; iteration < 10000; ++iteration) {
+        for (int g = 0; g < material.ng; ++g) {
+            double value = material.xsf[g];
+            for (int to = 0; to < material.ng; ++to) {
+                value += material.xssc(to, g) * f[to];
+            }
+            f[g] = value / material.xstr[g];
+        }
+    }
+    return 2.5 * f[0];
+}
+
+int main()
+{
+    // Combing gives exactly the size of a generation, all of unit weight, and
+    // each site gets its share of the total weight to within one tooth
+    {
+        std::default_random_engine random(7);
+        std::uniform_real_distribution<float> weight(0.1f, 3.0f);
+        std::vector<FissionSite> sites(1000);
+        double total = 0.0;
+        for (size_t i = 0; i < sites.size(); ++i) {
+            sites[i].weight = weight(random);
+            sites[i].parent = i;
+            total += sites[i].weight;
+        }
+        double spacing = total / 700;
+        for (double offset : {0.0, 0.5, 0.999}) {
+            auto combed = PowerIteration::comb(sites, 700, offset);
+            assert(combed.size() == 700);
+            std::vector<int> picks(sites.size(), 0);
+            for (const auto &site : combed) {
+                assert(site.weight == 1.0f);
+                picks[site.parent]++;
+            }
+            for (size_t i = 0; i < sites.size(); ++i) {
+                assert(std::abs(picks[i] - sites[i].weight / spacing) < 1.0 + 1e-6);
+            }
+        }
+
+        std::vector<FissionSite> few(4);
+        float weights[] = {0.5f, 1.5f, 2.0f, 4.0f};
+        for (size_t i = 0; i < few.size(); ++i) {
+            few[i].weight = weights[i];
+            few[i].parent = i;
+        }
+        auto combed = PowerIteration::comb(few, 4, 0.5);
+        std::vector<uint64_t> ids;
+        for (const auto &site : combed) {
+            ids.push_back(site.parent);
+        }
+        assert((ids == std::vector<uint64_t>{1, 2, 3, 3}));
+    }
+
+    // In an infinite medium of fuel, the source settles at once, and k comes out
+    // where it should be
+    {
+        auto materials       = std::make_shared<const MaterialLibrary>(C5G7());
+        const Material &fuel = materials->get_by_name("UO2");
+        Color red            = {0.4f, 0.0f, 0.0f, 1.0f};
+        auto mesh            = std::make_shared<Mesh>(4.0f, 4.0f, &fuel, red);
+
+        // Flights in a uniform medium are the same whatever the speed, so the
+        // particles are sped up to get through a generation in fewer tics
+        Particle::base_speed = 0.5f;
+
+        PowerIteration::Settings settings;
+        settings.n_particles    = 300;
+        settings.n_active       = 15;
+        settings.min_inactive   = 4;
+        settings.max_inactive   = 50;
+        settings.entropy_window = 2;
+        settings.seed           = 3;
+        PowerIteration iteration(materials, mesh, BoundaryCondition::REFLECTIVE,
+                                 settings);
+        size_t n_active = 0;
+        iteration.run(nullptr, [&](size_t, const PowerIteration::Generation &gen) {
+            n_active += gen.active;
+        });
+
+        // The convergence check let the active generations start well before it
+        // would have been forced to
+        assert(iteration.n_inactive() >= settings.min_inactive);
+        assert(iteration.n_inactive() < settings.max_inactive);
+        assert(n_active == settings.n_active);
+        assert(iteration.k().count() == settings.n_active);
+
+        double expected = infinite_medium_k(fuel);
+        const RunningStat &k = iteration.k();
+        assert(std::abs(k.mean() - expected) < 4.0 * k.std_error() + 0.005);
+    }
+
+    std::cout << "eigenvalue ok\n";
+    return 0;
+}
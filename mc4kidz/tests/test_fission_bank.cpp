@@ -0,0 +1,60 @@
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+#include "fission_bank.h"
+#include "materials.h"
+
+// Bank the same sites spread over the sub-banks in two different ways, and
+// return what comes out
+std::vector<FissionSite> bank_sites(const Material *mat, bool reversed)
+{
+    FissionBank bank(16);
+    bank.resize(3);
+
+    for (unsigned int parent = 0; parent < 100; ++parent) {
+        unsigned int sub = reversed ? 2 - parent % 3 : parent % 3;
+        for (unsigned int i = 0; i < 3; ++i) {
+            Vec2 location{static_cast<float>(parent), static_cast<float>(i)};
+            bank.sub_bank(sub).bank(FissionSite{location, mat, 99 - parent, 1, i});
+        }
+    }
+    assert(bank.size() == 300);
+
+    return bank.collect();
+}
+
+int main()
+{
+    MaterialLibrary materials = C5G7();
+    const Material *uo2       = &materials.get_by_name("UO2");
+
+    auto forward  = bank_sites(uo2, false);
+    auto backward = bank_sites(uo2, true);
+
+    assert(forward.size() == 300);
+    assert(backward.size() == 300);
+    for (size_t i = 0; i < forward.size(); ++i) {
+        // Ordered by parent, then by daughter
+        assert(forward[i].parent == i / 3);
+        assert(forward[i].index == i % 3);
+        assert(forward[i].location == backward[i].location);
+    }
+
+    // Sub-banks grow in whole steps and keep their storage after collecting
+    FissionBank bank(16);
+    bank.resize(1);
+    auto &sub_bank = bank.sub_bank(0);
+    sub_bank.reserve_more(20.0f);
+    assert(sub_bank.capacity() == 32);
+    for (unsigned int i = 0; i < 20; ++i) {
+        sub_bank.bank(FissionSite{Vec2{0.0f, 0.0f}, uo2, i, 1, 0});
+    }
+    assert(sub_bank.capacity() == 32);
+    bank.collect();
+    assert(sub_bank.size() == 0);
+    assert(sub_bank.capacity() == 32);
+
+    std::cout << "fission bank ok\n";
+    return 0;
+}
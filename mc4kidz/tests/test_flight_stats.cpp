@@ -0,0 +1,82 @@
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+
+#include "flight_stats.h"
+#include "materials.h"
+#include "per_thread.h"
+#include "quantile_sketch.h"
+#include "thread_pool.h"
+
+int main()
+{
+    // Quantiles of a shuffled stream are close to the true ones, in a bounded
+    // amount of memory
+    const uint32_t n = 100000;
+    QuantileSketch whole;
+    QuantileSketch halves[2];
+    for (uint32_t i = 0; i < n; ++i) {
+        // A permutation of 0 .. n - 1, since the multiplier is odd and n divides
+        // into powers of two and five only
+        float x = static_cast<float>((i * 7919u) % n);
+        whole.add(x);
+        halves[i % 2].add(x);
+    }
+    assert(whole.count() == n);
+    assert(whole.min() == 0.0f && whole.max() == n - 1);
+    for (double q : {0.01, 0.25, 0.5, 0.75, 0.99}) {
+        assert(std::abs(whole.quantile(q) - q * n) < 0.03 * n);
+    }
+    assert(whole.quantile(0.0) == 0.0f && whole.quantile(1.0) == n - 1);
+
+    // Sketches of two parts of a stream merge into one of the whole
+    halves[0].merge(halves[1]);
+    assert(halves[0].count() == n);
+    for (double q : {0.1, 0.5, 0.9}) {
+        assert(std::abs(halves[0].quantile(q) - q * n) < 0.03 * n);
+    }
+
+    // Flights recorded from many threads at once all count, by material and group
+    MaterialLibrary materials = C5G7();
+    const Material &fuel      = materials.get_by_name("UO2");
+    const Material &water     = materials.get_by_name("Moderator");
+    FlightStats stats;
+    {
+        ThreadPool pool(4);
+        pool.parallel_for(1000, [&](size_t i) {
+            if (i % 4 == 0) {
+                stats.record(water, 6, 2.0f, 3);
+            } else {
+                stats.record(fuel, 0, 1.0f, 1);
+            }
+        });
+    }
+    auto merged = stats.merged();
+    assert(merged.size() == 2);
+    const FlightStats::Entry &in_fuel  = merged.at({fuel.id, 0});
+    const FlightStats::Entry &in_water = merged.at({water.id, 6});
+    assert(in_fuel.length.stat.count() == 750);
+    assert(in_fuel.length.stat.mean() == 1.0);
+    assert(in_water.crossings.stat.mean() == 3.0);
+    assert(in_water.crossings.sketch.quantile(0.5) == 3.0f);
+    assert(std::abs(stats.lengths().mean() - 1.25) < 1e-9);
+
+    // A copy starts over
+    FlightStats copy(stats);
+    assert(copy.merged().empty());
+    assert(copy.lengths().count() == 0);
+
+    // A thread forgets the accumulators of instances that are gone, rather than
+    // keeping an entry for every one it has ever recorded into
+    size_t n_copies = PerThreadBase::n_thread_copies();
+    for (int i = 0; i < 100; ++i) {
+        FlightStats gone;
+        gone.record(fuel, 0, 1.0f, 1);
+    }
+    copy.record(fuel, 0, 1.0f, 1);
+    assert(PerThreadBase::n_thread_copies() <= n_copies + 1);
+
+    std::cout << "flight stats ok\n";
+    return 0;
+}
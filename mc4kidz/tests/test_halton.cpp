@@ -0,0 +1,88 @@
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+#include "halton.h"
+#include "source.h"
+#include "state.h"
+
+// Where the last n particles of a state start from
+static std::vector<Vec2> last_locations(const State &state, size_t n)
+{
+    const auto &particles = state.particles();
+    std::vector<Vec2> locations;
+    for (size_t i = particles.size() - n; i < particles.size(); ++i) {
+        locations.push_back(particles[i].location);
+    }
+    return locations;
+}
+
+int main()
+{
+    // Scrambled Halton points still put exactly one of the first b^k points in
+    // each interval of width b^-k, and different seeds scramble differently
+    HaltonSequence halton(5, 7);
+    for (int d = 0; d < 2; ++d) {
+        int n_bins = d == 0 ? 64 : 81;
+        std::vector<int> hits(n_bins, 0);
+        for (int i = 0; i < n_bins; ++i) {
+            float x = halton.sample(i, d);
+            assert(x >= 0.0f && x < 1.0f);
+            hits[static_cast<int>(x * n_bins)]++;
+        }
+        for (int count : hits) {
+            assert(count == 1);
+        }
+    }
+    HaltonSequence other(5, 8);
+    assert(halton.sample(1, 0) != other.sample(1, 0) ||
+           halton.sample(1, 1) != other.sample(1, 1));
+
+    // Quasi-random injection is as reproducible as the random kind
+    Rect box{Vec2{1.0f, 1.0f}, Vec2{16.0f, 16.0f}};
+    auto inject = [&box](unsigned int seed) {
+        State state;
+        state.set_thread_pool(nullptr);
+        state.set_seed(seed);
+        state.set_quasi_random(true);
+        state.add_particles(Source::box(box), 1000);
+        return state.particles().back().location.x;
+    };
+    assert(inject(1) == inject(1));
+    assert(inject(1) != inject(2));
+
+    // Particles added in two goes take the same points as when they are added in
+    // one, however many particles fission made in between
+    State whole;
+    whole.set_thread_pool(nullptr);
+    whole.set_seed(4);
+    whole.set_quasi_random(true);
+    whole.add_particles(Source::box(box), 128);
+    std::vector<Vec2> first = last_locations(whole, 128);
+    std::vector<Vec2> second(first.begin() + 64, first.end());
+    first.resize(64);
+
+    State split;
+    split.set_thread_pool(nullptr);
+    split.set_seed(4);
+    split.set_quasi_random(true);
+    split.add_particles(Source::box(box), 64);
+    split.advance(30);
+    assert(split.get_interaction_counts()[2] > 0);
+    split.add_particles(Source::box(box), 64);
+    assert(last_locations(split, 64) == second);
+
+    // A source that adds a particle every tic counts its own points, apart from
+    // those of particles added from outside
+    State with_source;
+    with_source.set_thread_pool(nullptr);
+    with_source.set_seed(4);
+    with_source.set_quasi_random(true);
+    with_source.set_source(8.5f, 8.5f);
+    with_source.advance(10);
+    with_source.add_particles(Source::box(box), 64);
+    assert(last_locations(with_source, 64) == first);
+
+    std::cout << "halton ok\n";
+    return 0;
+}
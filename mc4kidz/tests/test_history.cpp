@@ -0,0 +1,157 @@
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+#include "eigenvalue.h"
+#include "history.h"
+#include "materials.h"
+#include "source.h"
+#include "state.h"
+
+int main()
+{
+    std::vector<History::Bucket> buckets;
+
+    // A short history is kept sample by sample
+    {
+        History history;
+        for (int i = 0; i < 10; ++i) {
+            history.add(i);
+        }
+        history.buckets(buckets);
+        assert(buckets.size() == 10);
+        for (int i = 0; i < 10; ++i) {
+            assert(buckets[i].n == 1 && buckets[i].mean == i);
+        }
+    }
+
+    // A long one goes back to the first sample in a bounded number of buckets,
+    // newest at full resolution, in order, and keeps its spikes
+    {
+        History history;
+        const uint64_t n     = 3000000;
+        const uint64_t spike = 12345;
+        for (uint64_t i = 0; i < n; ++i) {
+            history.add(i == spike ? -1.0e6 : static_cast<double>(i % 1000));
+        }
+        assert(history.count() == n);
+        history.buckets(buckets);
+        assert(buckets.size() <= History::N_LEVELS * History::BUCKETS_PER_LEVEL);
+
+        uint64_t total = 0;
+        double sum     = 0.0;
+        bool kept      = false;
+        for (const auto &bucket : buckets) {
+            if (total <= spike && spike < total + bucket.n) {
+                kept = bucket.min == -1.0e6f;
+            }
+            total += bucket.n;
+            sum += static_cast<double>(bucket.mean) * bucket.n;
+        }
+        assert(total == n);
+        assert(kept);
+        double expected = (n * 499.5 - 1.0e6 - spike % 1000) / n;
+        assert(std::abs(sum / n - expected) < 1e-3 * expected);
+        for (size_t i = buckets.size() - History::BUCKETS_PER_LEVEL; i < buckets.size();
+             ++i) {
+            assert(buckets[i].n == 1);
+        }
+        assert(buckets.back().mean == (n - 1) % 1000);
+    }
+
+    // A state samples every series once per tic, and seeking back takes the
+    // histories back too
+    {
+        State state;
+        state.set_seed(3);
+        state.set_keyframes(true);
+        state.add_particles(Source::box(Rect{Vec2{1.0f, 1.0f}, Vec2{16.0f, 16.0f}}),
+                            2000);
+        state.advance(40);
+        for (int series = 0; series < static_cast<int>(HistorySeries::N_SERIES);
+             ++series) {
+            assert(state.history(static_cast<HistorySeries>(series)).count() == 40);
+        }
+
+        const History &scatter = state.history(HistorySeries::SCATTER);
+        scatter.buckets(buckets);
+        double scattered = 0.0;
+        for (const auto &bucket : buckets) {
+            scattered += bucket.mean;
+        }
+        // Every tic is sampled once it is over, so the samples add up to the count,
+        double count = state.get_interaction_counts()[0];
+        assert(scattered > 0.0 && std::abs(scattered - count) < 1e-4 * count);
+        // and the last population is the one the tic left
+        state.get_population_history().buckets(buckets);
+        double population = state.total_weight();
+        assert(std::abs(buckets.back().mean - population) < 1e-4 * population);
+
+        state.seek(20);
+        assert(state.get_population_history().count() == 20);
+    }
+
+    // Generations that are done with, or too old to keep, are retired, and the
+    // counts still add up to everything that was ever born
+    {
+        State state;
+        state.set_thread_pool(nullptr);
+        state.set_seed(5);
+        state.toggle_boundary_condition();
+        state.hold_fission_sites(true);
+        state.add_particles(Source::box(Rect{Vec2{1.0f, 1.0f}, Vec2{16.0f, 16.0f}}),
+                            50);
+        for (size_t gen = 0; gen < State::MAX_GENERATIONS + 8; ++gen) {
+            while (!state.particles().empty()) {
+                state.advance(1);
+            }
+            state.add_fission_sites(
+                PowerIteration::comb(state.take_fission_sites(), 50, 0.5));
+        }
+        const auto &born = state.generation_born();
+        assert(state.first_generation() > 0);
+        assert(born.size() <= State::MAX_GENERATIONS);
+        assert(state.retired_generations().count() == state.first_generation());
+
+        state.retired_generations().buckets(buckets);
+        double total = 0.0;
+        for (const auto &bucket : buckets) {
+            total += static_cast<double>(bucket.mean) * bucket.n;
+        }
+        for (unsigned int n : born) {
+            total += n;
+        }
+        assert(std::abs(total - (50.0 + state.n_born_from_fission())) < 1e-3);
+    }
+
+    // With more generations going at once than are kept, the oldest are retired
+    // all the same, and what is left of them counts in the oldest one kept
+    {
+        auto materials = std::make_shared<const MaterialLibrary>(C5G7());
+        State from(materials);
+        from.set_thread_pool(nullptr);
+        from.add_particles(Source::box(Rect{Vec2{1.0f, 1.0f}, Vec2{16.0f, 16.0f}}),
+                           40);
+        std::vector<Particle> particles = from.particles();
+        for (size_t i = 0; i < particles.size(); ++i) {
+            particles[i].generation = static_cast<unsigned int>(i);
+        }
+
+        State state(materials);
+        state.set_thread_pool(nullptr);
+        state.add_immigrants(particles);
+        state.advance(1);
+        const auto &population = state.generation_population();
+        assert(population.size() <= State::MAX_GENERATIONS);
+        assert(state.first_generation() >= 40 - State::MAX_GENERATIONS);
+        assert(std::accumulate(population.begin(), population.end(), 0u) ==
+               state.population());
+    }
+
+    std::cout << "history ok\n";
+    return 0;
+}
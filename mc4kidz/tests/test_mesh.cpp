@@ -1,6 +1,8 @@
 #include <cassert>
 #include <cmath>
 #include <iostream>
+#include <utility>
+#include <vector>
 
 #include "materials.h"
 #include "mesh.h"
@@ -37,5 +39,60 @@ int main()
     float norm = v3.norm();
     assert(std::abs((v1 - v2).norm() - 0.4333766f) < 1.0e-5);
 
+    // Symmetry planes through the middle of a 2x2 lattice
+    Mesh lattice(4.0f, 4.0f, &materials.get_by_name("Moderator"), black);
+    for (float x : {1.0f, 3.0f}) {
+        for (float y : {1.0f, 3.0f}) {
+            lattice.add_shape(std::make_unique<Circle>(black, Vec2{x, y}, 0.4f),
+                              &materials.get_by_name("UO2"));
+        }
+    }
+    assert(lattice.is_symmetric(Symmetry::EIGHTH));
+    lattice.set_color_material_at(Vec2{1.0f, 1.0f}, black,
+                                  &materials.get_by_name("Control2"));
+    assert(!lattice.is_symmetric(Symmetry::QUARTER));
+
+    lattice.set_symmetry(Symmetry::EIGHTH);
+    assert(lattice.multiplicity() == 8);
+    assert(lattice.in_sector(Vec2{3.0f, 2.5f}));
+    assert(!lattice.in_sector(Vec2{2.5f, 3.0f}));
+    assert(!lattice.in_sector(Vec2{1.0f, 3.0f}));
+
+    // Folding a point back into the sector, then taking its images, gets back to
+    // where it started
+    Vec2 location{0.5f, 3.0f};
+    Vec2 direction{-1.0f, 0.0f};
+    lattice.fold(location, direction);
+    assert(lattice.in_sector(location));
+    assert(location.x == 3.5f && location.y == 3.0f && direction.x == 1.0f);
+    bool found = false;
+    for (unsigned int i = 0; i < lattice.multiplicity(); ++i) {
+        found |= lattice.image_location(location, i) == Vec2{0.5f, 3.0f};
+    }
+    assert(found);
+
+    // Bulk edits pick regions by their centroids, edges included
+    using Regions = std::vector<size_t>;
+    assert(lattice.regions_in_rect(Rect{Vec2{0.0f, 0.0f}, Vec2{2.0f, 4.0f}}) ==
+           (Regions{0, 1}));
+    assert(lattice.regions_in_rect(Rect{Vec2{1.0f, 1.0f}, Vec2{3.0f, 1.0f}}) ==
+           (Regions{0, 2}));
+    assert(lattice.regions_in_rect(Rect{Vec2{1.5f, 1.5f}, Vec2{2.5f, 2.5f}}).empty());
+    assert(lattice.regions_in_ring(Vec2{2.0f, 2.0f}, 1.0f, 2.0f) ==
+           (Regions{0, 1, 2, 3}));
+    assert(lattice.regions_in_ring(Vec2{2.0f, 2.0f}, 0.0f, 1.0f).empty());
+    assert(lattice.regions_in_ring(Vec2{1.0f, 1.0f}, 0.0f, 0.0f) == (Regions{0}));
+    assert(lattice.regions_in_ring(Vec2{1.0f, 1.0f}, 2.0f, 2.0f) == (Regions{1, 2}));
+
+    // Pins are found by their index in the lattice, which new versions keep
+    assert(!lattice.lattice());
+    lattice.set_lattice(Mesh::Lattice{Vec2{0.0f, 0.0f}, 2, 2, 2.0f});
+    auto pins = lattice.clone()->lattice();
+    assert(pins && pins->nx == 2 && pins->ny == 2);
+    assert(pins->pin_at(Vec2{3.0f, 1.0f}) == std::make_pair(1, 0));
+    assert(pins->pin_at(Vec2{1.0f, 3.9f}) == std::make_pair(0, 1));
+    assert(!pins->pin_at(Vec2{4.5f, 1.0f}));
+    assert(!pins->pin_at(Vec2{-0.1f, 1.0f}));
+
     return 0;
 }
\ No newline at end of file
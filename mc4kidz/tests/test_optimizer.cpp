@@ -0,0 +1,68 @@
+#include <cassert>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#include "optimizer.h"
+#include "playbook.h"
+#include "thread_pool.h"
+
+// A short search of a lattice with a few moderator pins to move around
+static std::unique_ptr<Optimizer> search(std::shared_ptr<ThreadPool> pool,
+                                         size_t n_steps, std::vector<double> &best_k)
+{
+    std::stringstream setup("0 set_pins moderator 8,8 4,4 12,12 4,12 12,4\n");
+    Optimizer::Settings settings;
+    settings.n_steps     = n_steps;
+    settings.batch_size  = 3;
+    settings.n_tics      = 30;
+    settings.n_settle    = 10;
+    settings.n_particles = 300;
+    settings.seed        = 5;
+
+    auto optimizer = std::make_unique<Optimizer>(std::make_shared<Playbook>(setup),
+                                                 settings);
+    best_k.clear();
+    optimizer->run(pool, [&best_k](size_t, const Optimizer::Candidate &current,
+                                   const Optimizer::Candidate &best) {
+        assert(best.k >= current.k);
+        best_k.push_back(best.k);
+    });
+    return optimizer;
+}
+
+int main()
+{
+    // Without any steps, all there is to go on is the starting pattern
+    std::vector<double> serial_k;
+    double start_k = search(nullptr, 0, serial_k)->best().front().k;
+    assert(serial_k.empty() && start_k > 0.0);
+
+    // The best k only ever goes up, from the starting pattern on
+    auto serial = search(nullptr, 4, serial_k);
+    assert(serial_k.size() == 4);
+    assert(serial_k.front() >= start_k);
+    for (size_t i = 1; i < serial_k.size(); ++i) {
+        assert(serial_k[i] >= serial_k[i - 1]);
+    }
+    const auto &best = serial->best();
+    assert(!best.empty());
+    for (const auto &candidate : best) {
+        assert(best.front().k >= candidate.k);
+    }
+    assert(serial->n_evaluations() == 1 + 4 * 3);
+
+    // The same seed finds the same patterns, however many threads share the work
+    std::vector<double> pooled_k;
+    auto pooled = search(std::make_shared<ThreadPool>(4), 4, pooled_k);
+    assert(pooled_k == serial_k);
+    assert(pooled->best().size() == best.size());
+    for (size_t i = 0; i < best.size(); ++i) {
+        assert(pooled->best()[i].pattern == best[i].pattern);
+        assert(pooled->best()[i].k == best[i].k);
+    }
+
+    std::cout << "optimizer ok\n";
+    return 0;
+}
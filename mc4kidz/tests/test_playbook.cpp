@@ -0,0 +1,109 @@
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "playbook.h"
+
+const char *source = "# A comment\n"
+                     "0 toggle_boundary\n"
+                     "\n"
+                     "0 set_material 2.5 5.5 moderator\n"
+                     "10 set_rect 0.5 0.25 4 4 control\n"
+                     "0 set_ring 8.5 8.5 1.5 3 void\n"
+                     "5 set_pins fuel 3,3 \\\n"
+                     "    5,7\n"
+                     "0 set_pattern f.m \\\n"
+                     "              .cv\n"
+                     "0 add_particles 8.5 8.5 200\n"
+                     "100 halt\n"
+                     "0 reset\n";
+
+// Compile a playbook, overwrite its last arguments with the given bytes, and see
+// whether it still loads
+template <typename T> bool loads_with_last_args(const char *text, T value)
+{
+    std::stringstream in(text);
+    std::string fname = "test_playbook_bad.pbc";
+    Playbook(in).save(fname);
+
+    std::fstream file(fname, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(-static_cast<std::streamoff>(sizeof(T)), std::ios::end);
+    file.write(reinterpret_cast<const char *>(&value), sizeof(T));
+    file.close();
+
+    bool loaded = true;
+    try {
+        Playbook playbook(fname);
+    } catch (const std::string &) {
+        loaded = false;
+    }
+    std::remove(fname.c_str());
+    return loaded;
+}
+
+std::string print(const Playbook &playbook)
+{
+    std::stringstream out;
+    playbook.print(out);
+    return out.str();
+}
+
+int main()
+{
+    std::stringstream in(source);
+    Playbook playbook(in);
+    assert(playbook.size() == 9);
+
+    std::string text = print(playbook);
+    assert(text == "0 toggle_boundary\n"
+                   "0 set_material 2.5 5.5 moderator\n"
+                   "10 set_rect 0.5 0.25 4 4 control\n"
+                   "0 set_ring 8.5 8.5 1.5 3 void\n"
+                   "5 set_pins fuel 3,3 5,7\n"
+                   "0 set_pattern f.m .cv\n"
+                   "0 add_particles 8.5 8.5 200\n"
+                   "100 halt\n"
+                   "0 reset\n");
+
+    // The printed form reads back as the same playbook
+    std::stringstream reprinted(text);
+    assert(print(Playbook(reprinted)) == text);
+
+    // So does the compiled form
+    std::string fname = "test_playbook.pbc";
+    playbook.save(fname);
+    Playbook compiled(fname);
+    std::remove(fname.c_str());
+    assert(print(compiled) == text);
+
+    // Compiled playbooks that would hand the state nonsense are turned away
+    assert(loads_with_last_args("0 set_pattern f\n", int32_t(3)));
+    assert(!loads_with_last_args("0 set_pattern f\n", int32_t(7)));
+    assert(!loads_with_last_args("0 set_pattern f\n", int32_t(-1)));
+    struct Row {
+        int32_t n;
+        int32_t code;
+    };
+    assert(!loads_with_last_args("0 set_pattern f\n", Row{5, 0}));
+    assert(!loads_with_last_args("0 set_material 1 1 fuel\n", std::nanf("")));
+    assert(!loads_with_last_args("0 set_ring 1 1 1 1 fuel\n", INFINITY));
+    assert(!loads_with_last_args("0 add_particles 1 1 10\n", int32_t(-10)));
+
+    // Errors point at the offending line
+    std::stringstream bad("0 toggle_boundary\n0 set_material 1 x fuel\n");
+    try {
+        Playbook failed(bad);
+        assert(false);
+    } catch (const std::string &msg) {
+        assert(msg.find("line 2") != std::string::npos);
+    }
+
+    std::cout << "playbook ok\n";
+    return 0;
+}
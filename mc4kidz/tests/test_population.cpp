@@ -0,0 +1,108 @@
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "source.h"
+#include "state.h"
+
+// A reflected lattice, started from a box of particles, with population control
+std::unique_ptr<State> make_state(PopulationControl control,
+                                  std::shared_ptr<ThreadPool> pool = nullptr)
+{
+    auto state = std::make_unique<State>();
+    state->set_thread_pool(pool);
+    state->set_seed(11);
+    state->toggle_boundary_condition();
+    state->set_population_control(control, 1000);
+    state->add_particles(Source::box(Rect{Vec2{1.0f, 1.0f}, Vec2{16.0f, 16.0f}}), 3000);
+    return state;
+}
+
+int main()
+{
+    // Combing gives exactly the target, all of the same weight, and keeps the
+    // weight the tic left
+    {
+        auto state = make_state(PopulationControl::COMB);
+        for (int i = 0; i < 50; ++i) {
+            state->tic(true);
+            assert(state->population() == 1000);
+            float weight = state->particles().front().weight;
+            for (const auto &p : state->particles()) {
+                assert(p.weight == weight);
+            }
+        }
+        assert(std::abs(state->total_weight() / 3000.0 - 1.0) < 0.2);
+    }
+
+    // Roulette and splitting hold the population near the target
+    {
+        auto state = make_state(PopulationControl::ROULETTE);
+        for (int i = 0; i < 50; ++i) {
+            state->tic(true);
+            assert(state->population() > 800 && state->population() < 1200);
+        }
+    }
+
+    // Neither depends on the number of threads
+    for (auto control : {PopulationControl::COMB, PopulationControl::ROULETTE}) {
+        auto run = [control](std::shared_ptr<ThreadPool> pool) {
+            auto state = make_state(control, pool);
+            for (int i = 0; i < 30; ++i) {
+                state->tic(true);
+            }
+            auto counts = state->get_interaction_counts();
+            counts.push_back(state->total_weight());
+            return counts;
+        };
+        assert(run(nullptr) == run(std::make_shared<ThreadPool>(4)));
+    }
+
+    // Survival biasing keeps particles through capture, just lighter, and
+    // weight windows keep them within bounds
+    {
+        auto state = make_state(PopulationControl::NONE);
+        state->set_implicit_capture(true);
+        for (int i = 0; i < 20; ++i) {
+            state->tic(true);
+        }
+        for (const auto &p : state->particles()) {
+            assert(p.weight > 0.0f && p.weight <= 1.0f);
+        }
+
+        auto mesh = state->mesh_snapshot();
+        Rect bounds{Vec2{0.0f, 0.0f}, Vec2{mesh->get_width(), mesh->get_height()}};
+        std::vector<float> lower(Source::N_GROUPS, 0.2f);
+        state->set_weight_windows(
+            std::make_shared<WeightWindows>(bounds, 1, 1, Source::N_GROUPS, lower));
+        state->tic(true);
+        for (const auto &p : state->particles()) {
+            assert(p.weight >= 0.2f * 0.99f && p.weight <= 0.2f * 5.01f);
+        }
+    }
+
+    // The spectrum is kept up to date through splitting and roulette, without
+    // being drawn, and matches the population as it stands
+    {
+        auto state = make_state(PopulationControl::ROULETTE);
+        state->set_implicit_capture(true);
+        state->advance(30);
+        std::vector<double> spectrum(Source::N_GROUPS, 0.0);
+        for (const auto &p : state->particles()) {
+            spectrum[p.e_group] += p.weight;
+        }
+        State::Statistics statistics = state->statistics();
+        for (int g = 0; g < Source::N_GROUPS; ++g) {
+            assert(std::abs(statistics.spectrum[g] - spectrum[g]) < 1e-6 * 3000.0);
+        }
+        auto counts = state->get_interaction_counts();
+        for (size_t i = 0; i < counts.size(); ++i) {
+            assert(statistics.interactions[i] == counts[i]);
+        }
+    }
+
+    std::cout << "population ok\n";
+    return 0;
+}
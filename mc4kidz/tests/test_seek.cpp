@@ -0,0 +1,80 @@
+#include <cassert>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "playbook.h"
+#include "state.h"
+
+struct Snapshot {
+    size_t population;
+    std::vector<double> counts;
+    std::vector<double> spectrum;
+
+    bool operator==(const Snapshot &other) const
+    {
+        return population == other.population && counts == other.counts &&
+               spectrum == other.spectrum;
+    }
+};
+
+Snapshot snapshot(const State &state)
+{
+    return {state.population(), state.get_interaction_counts(), state.get_spectrum()};
+}
+
+std::unique_ptr<State> make_state()
+{
+    auto state = std::make_unique<State>();
+    state->set_thread_pool(nullptr);
+    state->set_seed(7);
+    state->set_playbook(std::make_unique<Playbook>());
+    state->set_keyframes(true);
+    return state;
+}
+
+int main()
+{
+    // Step through a run by hand, noting where it was along the way
+    auto state = make_state();
+    Snapshot at_700;
+    for (unsigned int i = 0; i < 1300; ++i) {
+        state->tic(true);
+        if (state->elapsed() == 700) {
+            at_700 = snapshot(*state);
+        }
+    }
+    Snapshot at_1300 = snapshot(*state);
+    std::cout << "population at 700: " << at_700.population
+              << ", at 1300: " << at_1300.population << "\n";
+
+    // Seeking back restores a keyframe and replays up to the right point
+    state->seek(700);
+    assert(state->elapsed() == 700);
+    assert(snapshot(*state) == at_700);
+
+    state->seek(1300);
+    assert(snapshot(*state) == at_1300);
+
+    // Seeking forward from the start gets to the same place
+    auto fresh = make_state();
+    fresh->seek(1300);
+    assert(snapshot(*fresh) == at_1300);
+
+    // Running headless saves nothing unless asked to, and still gets to the same
+    // place
+    auto headless = std::make_unique<State>();
+    headless->set_thread_pool(nullptr);
+    headless->set_seed(7);
+    headless->set_playbook(std::make_unique<Playbook>());
+    headless->advance(1300);
+    assert(headless->n_keyframes() == 0);
+    assert(snapshot(*headless) == at_1300);
+
+    // Seeking back without any keyframes from before runs over from the start
+    headless->seek(700);
+    assert(headless->elapsed() == 700);
+    assert(snapshot(*headless) == at_700);
+
+    return 0;
+}
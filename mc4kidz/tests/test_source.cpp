@@ -0,0 +1,72 @@
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "source.h"
+#include "state.h"
+
+int main()
+{
+    // Sites are picked in proportion to their weights, and read back from a file
+    // the same as they were written
+    std::vector<SourceSite> sites = {{1.0f, 1.0f, 0, 1.0f},
+                                     {2.0f, 2.0f, 3, 3.0f},
+                                     {3.0f, 3.0f, 5, 0.0f},
+                                     {4.0f, 4.0f, 6, 4.0f}};
+    std::string fname = "test_source.bin";
+    Source::save_sites(fname, sites);
+    Source source = Source::from_file(fname);
+    assert(source.n_sites() == 4);
+
+    std::default_random_engine random(3);
+    std::vector<int> counts(4, 0);
+    const int n = 80000;
+    for (int i = 0; i < n; ++i) {
+        Vec2 location{};
+        int e_group = 0;
+        source.sample(random, location, e_group);
+        int site = static_cast<int>(location.x) - 1;
+        assert(e_group == sites[site].e_group);
+        counts[site]++;
+    }
+    std::remove(fname.c_str());
+    assert(counts[2] == 0);
+    assert(std::abs(counts[0] / double(n) - 0.125) < 0.01);
+    assert(std::abs(counts[1] / double(n) - 0.375) < 0.01);
+    assert(std::abs(counts[3] / double(n) - 0.5) < 0.01);
+
+    // Energy distributions only give groups with some weight
+    Source disc = Source::disc(Vec2{8.5f, 8.5f}, 2.0f);
+    disc.set_group_weights({0.0f, 1.0f, 0.0f, 1.0f});
+    for (int i = 0; i < 1000; ++i) {
+        Vec2 location{};
+        int e_group = 0;
+        disc.sample(random, location, e_group);
+        assert(e_group == 1 || e_group == 3);
+        assert((location - Vec2{8.5f, 8.5f}).norm() <= 2.0f);
+    }
+
+    // A bulk injection comes out the same no matter how many threads there are
+    auto inject = [](std::shared_ptr<ThreadPool> pool) {
+        State state;
+        state.set_thread_pool(pool);
+        state.set_seed(5);
+        state.add_particles(Source::box(Rect{Vec2{1.0f, 1.0f}, Vec2{16.0f, 16.0f}}),
+                            5000);
+        assert(state.population() == 5000);
+        for (int i = 0; i < 20; ++i) {
+            state.tic(true);
+        }
+        auto counts = state.get_interaction_counts();
+        counts.push_back(static_cast<unsigned int>(state.population()));
+        return counts;
+    };
+    assert(inject(nullptr) == inject(std::make_shared<ThreadPool>(4)));
+
+    std::cout << "source ok\n";
+    return 0;
+}
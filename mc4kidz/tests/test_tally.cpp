@@ -0,0 +1,115 @@
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <memory>
+
+#include "materials.h"
+#include "mesh.h"
+#include "tally.h"
+#include "thread_pool.h"
+
+static bool close(double a, double b)
+{
+    return std::abs(a - b) < 1e-5 * std::max(1.0, std::abs(b));
+}
+
+int main()
+{
+    MaterialLibrary materials = C5G7();
+    const Material &fuel      = materials.get_by_name("UO2");
+    Mesh mesh(4.0f, 4.0f, &fuel, Color{0.0f, 0.0f, 0.0f, 1.0f});
+    using Score = MeshTally::Score;
+
+    // A diagonal flight spends the same length in every cell it crosses, and the
+    // part of it outside of the mesh isn't scored
+    {
+        MeshTally tally(Rect{Vec2{0.0f, 0.0f}, Vec2{4.0f, 4.0f}}, 4, 4, 7);
+        Vec2 direction{std::sqrt(0.5f), std::sqrt(0.5f)};
+        tally.score(Vec2{-1.0f, -1.0f}, direction, 10.0f, fuel, 2, 1.0f);
+        tally.end_batch(1.0, mesh);
+        for (size_t i = 0; i < 4; ++i) {
+            assert(close(tally.bin(i, i, Score::FLUX, 2).mean(), std::sqrt(2.0)));
+            assert(close(tally.bin(i, i, Score::FISSION).mean(),
+                         std::sqrt(2.0) * fuel.xsf[2]));
+        }
+        assert(tally.bin(1, 0, Score::FLUX).mean() == 0.0);
+        assert(tally.bin(0, 0, Score::FLUX, 3).mean() == 0.0);
+    }
+
+    // Flights scored from many threads at once all count, and a batch starts from
+    // nothing
+    {
+        MeshTally tally(Rect{Vec2{0.0f, 0.0f}, Vec2{4.0f, 4.0f}}, 2, 2, 7);
+        ThreadPool pool(4);
+        for (int batch = 0; batch < 3; ++batch) {
+            pool.parallel_for(1000, [&](size_t) {
+                tally.score(Vec2{0.5f, 0.5f}, Vec2{1.0f, 0.0f}, 3.0f, fuel, 0, 1.0f);
+            });
+            tally.end_batch(1000.0, mesh);
+        }
+        assert(tally.n_batches() == 3);
+        assert(close(tally.bin(0, 0, Score::FLUX).mean(), 1.5));
+        assert(close(tally.bin(1, 0, Score::FLUX).mean(), 1.5));
+        assert(tally.relative_error(0, 0, Score::FLUX) < 1e-6);
+        assert(std::isinf(tally.relative_error(0, 1, Score::FLUX)));
+    }
+
+    // Only the cells asked about count towards the error
+    {
+        MeshTally tally(Rect{Vec2{0.0f, 0.0f}, Vec2{4.0f, 4.0f}}, 2, 2, 7);
+        for (int batch = 0; batch < 3; ++batch) {
+            float weight = batch + 1.0f;
+            tally.score(Vec2{0.5f, 0.5f}, Vec2{0.0f, 1.0f}, 1.0f, fuel, 0, 1.0f);
+            tally.score(Vec2{2.5f, 0.5f}, Vec2{0.0f, 1.0f}, 1.0f, fuel, 0, weight);
+            tally.end_batch(1.0, mesh);
+        }
+        assert(tally.max_relative_error(Score::FLUX) > 0.1);
+        assert(tally.max_relative_error({0}, Score::FLUX) < 1e-6);
+        assert(close(tally.max_relative_error({0, 1}, Score::FLUX),
+                     tally.max_relative_error(Score::FLUX)));
+        assert(std::isinf(tally.max_relative_error({}, Score::FLUX)));
+    }
+
+    // A thread forgets the buffers of tallies that are gone, rather than keeping
+    // an entry for every tally it has ever scored into
+    {
+        for (int i = 0; i < 100; ++i) {
+            MeshTally tally(Rect{Vec2{0.0f, 0.0f}, Vec2{4.0f, 4.0f}}, 2, 2, 7);
+            tally.score(Vec2{0.5f, 0.5f}, Vec2{1.0f, 0.0f}, 1.0f, fuel, 0, 1.0f);
+        }
+        MeshTally tally(Rect{Vec2{0.0f, 0.0f}, Vec2{4.0f, 4.0f}}, 2, 2, 7);
+        tally.score(Vec2{0.5f, 0.5f}, Vec2{1.0f, 0.0f}, 1.0f, fuel, 0, 1.0f);
+        assert(PerThreadBase::n_thread_copies() == 1);
+    }
+
+    // Currents through a face count the weight crossing it, less what crosses it
+    // back, and the edge of the mesh isn't a face
+    {
+        MeshTally tally(Rect{Vec2{0.0f, 0.0f}, Vec2{4.0f, 4.0f}}, 2, 2, 7);
+        tally.score(Vec2{0.5f, 0.5f}, Vec2{1.0f, 0.0f}, 5.0f, fuel, 0, 2.0f);
+        tally.score(Vec2{3.5f, 0.5f}, Vec2{-1.0f, 0.0f}, 2.0f, fuel, 0, 0.5f);
+        tally.score(Vec2{1.0f, 1.0f}, Vec2{0.0f, 1.0f}, 2.0f, fuel, 0, 1.0f);
+        tally.end_batch(1.0, mesh);
+        assert(close(tally.bin(0, 0, Score::CURRENT_X).mean(), 1.5));
+        assert(tally.bin(1, 0, Score::CURRENT_X).mean() == 0.0);
+        assert(close(tally.bin(0, 0, Score::CURRENT_Y).mean(), 1.0));
+        assert(close(tally.bin(0, 0, Score::TOTAL).mean(),
+                     (2.0 * 1.5 + 0.5 * 0.5 + 1.0) * fuel.xstr[0]));
+    }
+
+    // With a symmetry, what is scored in the sector shows up in its mirror images
+    {
+        mesh.set_symmetry(Symmetry::QUARTER);
+        MeshTally tally(Rect{Vec2{0.0f, 0.0f}, Vec2{4.0f, 4.0f}}, 4, 4, 7);
+        tally.score(Vec2{3.0f, 3.5f}, Vec2{1.0f, 0.0f}, 0.5f, fuel, 0, 1.0f);
+        tally.end_batch(1.0, mesh);
+        assert(close(tally.bin(3, 3, Score::FLUX).mean(), 0.5));
+        assert(close(tally.bin(0, 3, Score::FLUX).mean(), 0.5));
+        assert(close(tally.bin(3, 0, Score::FLUX).mean(), 0.5));
+        assert(close(tally.bin(0, 0, Score::FLUX).mean(), 0.5));
+        assert(tally.bin(2, 3, Score::FLUX).mean() == 0.0);
+    }
+
+    std::cout << "tally ok\n";
+    return 0;
+}
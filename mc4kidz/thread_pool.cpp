@@ -0,0 +1,99 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int n_threads)
+{
+    if (n_threads == 0) {
+        n_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    _workers.reserve(n_threads);
+    for (unsigned int i = 0; i < n_threads; ++i) {
+        _workers.emplace_back([this]() { _work(); });
+    }
+    return;
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _wake.notify_all();
+    for (auto &worker : _workers) {
+        worker.join();
+    }
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> task)
+{
+    std::packaged_task<void()> packaged(std::move(task));
+    auto future = packaged.get_future();
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _tasks.push(std::move(packaged));
+    }
+    _wake.notify_one();
+    return future;
+}
+
+void ThreadPool::parallel_for(size_t n, const std::function<void(size_t)> &f)
+{
+    if (n == 0) {
+        return;
+    }
+
+    // Work is handed out one index at a time. Helpers that only get to run after
+    // everything has been claimed find nothing left to do, so we never wait on
+    // them; we only wait for the indices that were actually claimed to finish.
+    struct Shared {
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+        const std::function<void(size_t)> *f;
+        size_t n;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    auto shared = std::make_shared<Shared>();
+    shared->f   = &f;
+    shared->n   = n;
+
+    auto work = [shared]() {
+        size_t i;
+        while ((i = shared->next.fetch_add(1)) < shared->n) {
+            (*shared->f)(i);
+            if (shared->done.fetch_add(1) + 1 == shared->n) {
+                std::lock_guard<std::mutex> lock(shared->mutex);
+                shared->finished.notify_all();
+            }
+        }
+    };
+
+    size_t n_helpers = std::min(n - 1, _workers.size());
+    for (size_t i = 0; i < n_helpers; ++i) {
+        submit(work);
+    }
+    work();
+
+    std::unique_lock<std::mutex> lock(shared->mutex);
+    shared->finished.wait(lock, [&shared]() { return shared->done == shared->n; });
+}
+
+void ThreadPool::_work()
+{
+    while (true) {
+        std::packaged_task<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wake.wait(lock, [this]() { return _stop || !_tasks.empty(); });
+            if (_stop && _tasks.empty()) {
+                return;
+            }
+            task = std::move(_tasks.front());
+            _tasks.pop();
+        }
+        task();
+    }
+}
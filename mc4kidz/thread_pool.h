@@ -0,0 +1,43 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// A plain fixed-size pool of worker threads
+class ThreadPool {
+public:
+    // Start n_threads workers. Zero means one per hardware thread.
+    ThreadPool(unsigned int n_threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // Queue a task, returning a future that becomes ready once it has run
+    std::future<void> submit(std::function<void()> task);
+
+    // Call f(i) for every i in [0, n), spreading the calls over the pool, and wait
+    // for all of them to finish. The calling thread takes part in the work, so
+    // this is also safe to call from inside one of the pool's own tasks.
+    void parallel_for(size_t n, const std::function<void(size_t)> &f);
+
+    size_t size() const
+    {
+        return _workers.size();
+    }
+
+private:
+    void _work();
+
+    std::vector<std::thread> _workers;
+    std::queue<std::packaged_task<void()>> _tasks;
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    bool _stop = false;
+};
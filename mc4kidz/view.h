@@ -1,11 +1,6 @@
 #pragma once
-#ifdef WIN32
-#define NOMINMAX
-#include <windows.h>
-#endif
-#include "GL/gl.h"
-#include "GL/glut.h"
 
+// An orthographic 2-D projection, as passed to gluOrtho2D()
 struct Ortho2D {
     float left;
     float right;
@@ -22,10 +17,4 @@ struct Ortho2D {
     {
         return;
     }
-
-    void apply() const
-    {
-        glLoadIdentity();
-        gluOrtho2D(left, right, top, bottom);
-    }
 };
\ No newline at end of file
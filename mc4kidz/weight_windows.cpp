@@ -0,0 +1,63 @@
+#include "weight_windows.h"
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <utility>
+
+WeightWindows::WeightWindows(Rect bounds, size_t nx, size_t ny, int n_groups,
+                             std::vector<float> lower)
+    : _bounds(bounds),
+      _nx(nx),
+      _ny(ny),
+      _n_groups(n_groups),
+      _cell_w((bounds.hi.x - bounds.lo.x) / nx),
+      _cell_h((bounds.hi.y - bounds.lo.y) / ny),
+      _lower(std::move(lower))
+{
+    if (_lower.size() != _nx * _ny * _n_groups) {
+        throw std::string("Weight windows need a lower bound for every cell and group");
+    }
+    return;
+}
+
+WeightWindows WeightWindows::from_flux(const MeshTally &tally)
+{
+    size_t n_cells = tally.nx() * tally.ny();
+    int n_groups   = tally.n_groups();
+    std::vector<float> lower(n_cells * n_groups, 0.0f);
+    for (int g = 0; g < n_groups; ++g) {
+        auto flux = [&](size_t cell) {
+            size_t ix = cell % tally.nx();
+            size_t iy = cell / tally.nx();
+            return tally.bin(ix, iy, MeshTally::Score::FLUX, g).mean();
+        };
+
+        double max_flux = 0.0;
+        for (size_t cell = 0; cell < n_cells; ++cell) {
+            max_flux = std::max(max_flux, flux(cell));
+        }
+        if (max_flux <= 0.0) {
+            // Nothing in this group to go by, so leave it alone
+            continue;
+        }
+
+        float lowest = std::numeric_limits<float>::max();
+        for (size_t cell = 0; cell < n_cells; ++cell) {
+            size_t i        = cell * n_groups + g;
+            double survival = flux(cell) / max_flux;
+            if (survival > 0.0) {
+                lower[i] = static_cast<float>(survival / SURVIVAL_RATIO);
+                lowest   = std::min(lowest, lower[i]);
+            }
+        }
+        for (size_t cell = 0; cell < n_cells; ++cell) {
+            if (lower[cell * n_groups + g] == 0.0f) {
+                lower[cell * n_groups + g] = lowest;
+            }
+        }
+    }
+
+    return WeightWindows(tally.bounds(), tally.nx(), tally.ny(), n_groups,
+                         std::move(lower));
+}
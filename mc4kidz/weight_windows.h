@@ -0,0 +1,54 @@
+#pragma once
+#include <algorithm>
+#include <vector>
+
+#include "simple_structs.h"
+#include "tally.h"
+
+// Bounds on the weight particles should have, on a regular mesh of cells, per
+// energy group.
+//
+// A particle lighter than the lower bound of its cell plays Russian roulette for
+// the survival weight, and one heavier than the upper bound is split into copies
+// of about the survival weight. Setting the bounds in proportion to the flux puts
+// heavy particles where there are plenty of neutrons and splits them up where
+// there are few, which spreads the particles more evenly over the mesh than the
+// neutrons themselves are, and so keeps the statistics up in the regions that are
+// hard to get to.
+class WeightWindows {
+public:
+    // The upper bound and the survival weight, relative to the lower bound
+    static constexpr float UPPER_RATIO    = 5.0f;
+    static constexpr float SURVIVAL_RATIO = 2.5f;
+    // Most copies a particle is split into at once
+    static constexpr int MAX_SPLIT = 10;
+
+    // Lower bounds per cell and group, cells in rows from the bottom, then groups.
+    // Zero means no window.
+    WeightWindows(Rect bounds, size_t nx, size_t ny, int n_groups,
+                  std::vector<float> lower);
+
+    // Windows from the flux of a forward pre-run. In each group, the cell with the
+    // most flux gets a survival weight of one, which is what source particles start
+    // with, and the others get less in proportion to their flux. Cells the pre-run
+    // never reached get the lowest window of those it did.
+    static WeightWindows from_flux(const MeshTally &tally);
+
+    float lower(Vec2 location, int e_group) const
+    {
+        float x   = std::max(0.0f, (location.x - _bounds.lo.x) / _cell_w);
+        float y   = std::max(0.0f, (location.y - _bounds.lo.y) / _cell_h);
+        size_t ix = std::min(_nx - 1, static_cast<size_t>(x));
+        size_t iy = std::min(_ny - 1, static_cast<size_t>(y));
+        return _lower[(iy * _nx + ix) * _n_groups + e_group];
+    }
+
+private:
+    Rect _bounds;
+    size_t _nx;
+    size_t _ny;
+    int _n_groups;
+    float _cell_w;
+    float _cell_h;
+    std::vector<float> _lower;
+};